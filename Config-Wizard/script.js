@@ -19,13 +19,24 @@ document.getElementById("config-form").addEventListener("submit", function (e) {
     const config = {
         serialMonitorBaud: formData.get("serialBaud") || "115200",
         screenBaud: formData.get("screenBaud") || "9600",
+        screenMaxBaud: formData.get("screenMaxBaud") || "0",
         motorPulsesPerRevolution: formData.get("motorPulses") || "1000",
         motorShaftVelocity: (formData.get("motorShaftVel")) || 1000,
         motorShaftAcceleration: (formData.get("motorShaftAccel")) || 10000,
+        motorShaftJerk: (formData.get("motorShaftJerk")) || 0,
+        positionStreamRate: formData.get("positionStreamRate") || "0",
         defaultUnit: formData.get("defaultUnit"),
         screenType: formData.get("screenType"),
         mechanism: formData.get("mechanism"),
-        mechanismParameters: {}
+        mechanismParameters: {},
+        homingParameters: {
+            fastVelocity: formData.get("homingFastVel") || "60",
+            slowVelocity: formData.get("homingSlowVel") || "10",
+            torqueLimit: formData.get("homingTorqueLimit") || "40",
+            backoff: formData.get("homingBackoff") || "0.25",
+            backoffUnit: formData.get("homingBackoffUnit"),
+            timeout: formData.get("homingTimeout") || "20000"
+        }
     };
 
 
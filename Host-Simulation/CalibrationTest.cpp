@@ -0,0 +1,155 @@
+// Host check of the ClearCore's CalibrationTable (MechanismClasses.h) against a double precision interpolation of the
+// same points. Fills the table to its 1024 points with a stretched belt and a wavy pitch error, then walks every step
+// of the travel plus a stretch past both ends through Correct(), Measured() and ApproachTarget(), the backlash
+// overshoot a move toward home takes. Prints the worst error and the time per lookup, exits non-zero on a mismatch.
+//
+//   ./calibration-test                 1024 points, 10000000 timed lookups
+//   ./calibration-test 200 1000000     points, lookups
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "MechanismClasses.h"
+
+static const int32_t TRAVEL_STEPS = 200000;  // about 60" on a 1.5" pulley at 1600 steps/rev
+static const int32_t PAST_END_STEPS = 5000;
+static const int32_t APPROACH_STEPS = 40;
+
+struct Point {
+  int32_t commanded;
+  int32_t measured;
+};
+
+// Piecewise linear through the points from one column to the other, the nearest end offset outside them
+static double Interpolate(const std::vector<Point> &points, double x, bool fromMeasured) {
+  auto in = [&](const Point &p) { return fromMeasured ? p.measured : p.commanded; };
+  auto out = [&](const Point &p) { return fromMeasured ? p.commanded : p.measured; };
+
+  if (x <= in(points.front())) {
+    return x + (out(points.front()) - in(points.front()));
+  }
+  if (x >= in(points.back())) {
+    return x + (out(points.back()) - in(points.back()));
+  }
+  size_t i = 1;
+  while (in(points[i]) < x) {
+    i++;
+  }
+  const Point &a = points[i - 1];
+  const Point &b = points[i];
+  return out(a) + (x - in(a)) * (double)(out(b) - out(a)) / (double)(in(b) - in(a));
+}
+
+struct Worst {
+  double tolerance = 0;
+  double error = 0;
+  int32_t at = 0;
+  int failures = 0;
+
+  void Check(double error_, int32_t at_) {
+    if (fabs(error_) > fabs(error)) {
+      error = error_;
+      at = at_;
+    }
+    if (fabs(error_) > tolerance) {
+      failures++;
+    }
+  }
+};
+
+int main(int argc, char **argv) {
+  int pointCount = (argc > 1) ? atoi(argv[1]) : CalibrationTable::MAX_POINTS;
+  long lookups = (argc > 2) ? atol(argv[2]) : 10000000;
+  if (pointCount < 2 || pointCount > CalibrationTable::MAX_POINTS || lookups <= 0) {
+    fprintf(stderr, "usage: %s [points (2-%u) lookups]\n", argv[0], CalibrationTable::MAX_POINTS);
+    return 2;
+  }
+
+  // 0.3% belt stretch plus a +-12 step ripple, the ripple is small enough that both columns stay increasing
+  std::vector<Point> points;
+  srand(1);
+  for (int i = 0; i < pointCount; i++) {
+    int32_t commanded = (int32_t)((int64_t)TRAVEL_STEPS * i / (pointCount - 1));
+    double error = commanded * 0.003 + 12.0 * sin(commanded / 3000.0) + (rand() % 3 - 1);
+    points.push_back({commanded, commanded - (int32_t)lround(error)});
+  }
+
+  static CalibrationTable table;  // 12 KB of arrays, same as the firmware keeps it out of the stack
+  bool ok = true;
+  for (const Point &p : points) {
+    if (!table.AddPoint(p.commanded, p.measured)) {
+      printf("AddPoint refused (%d, %d)\n", p.commanded, p.measured);
+      ok = false;
+    }
+  }
+  table.SetApproachSteps(APPROACH_STEPS);
+
+  // Points out of order or past the end are refused and leave the table as it was
+  if (table.AddPoint(points.back().commanded, points.back().measured + 1)
+      || (pointCount == CalibrationTable::MAX_POINTS && table.AddPoint(TRAVEL_STEPS + 100, TRAVEL_STEPS + 100))
+      || table.GetPointCount() != pointCount) {
+    printf("AddPoint took a point it should have refused\n");
+    ok = false;
+  }
+
+  // A step of rounding on each side, plus the Q15.16 slope's resolution over the widest segment for Correct()
+  int32_t widestSegment = 0;
+  for (size_t i = 1; i < points.size(); i++) {
+    widestSegment = std::max(widestSegment, points[i].measured - points[i - 1].measured);
+  }
+  Worst correct, measured, approach;
+  correct.tolerance = 1.0 + widestSegment / (double)(1L << CalibrationTable::SLOPE_FRAC_BITS);
+  measured.tolerance = 1.0;
+  approach.tolerance = correct.tolerance;
+  int32_t first = points.front().measured - PAST_END_STEPS;
+  int32_t last = points.back().measured + PAST_END_STEPS;
+  for (int32_t target = first; target <= last; target++) {
+    int32_t corrected = table.Correct(target);
+    correct.Check(corrected - Interpolate(points, target, true), target);
+    measured.Check(table.Measured(target) - Interpolate(points, target, false), target);
+
+    // Toward home from the far end: the overshoot stays under the final target and a whole approach below it unless
+    // home is in the way
+    int32_t from = points.back().commanded;
+    int32_t overshoot = table.ApproachTarget(corrected, from);
+    double expected = std::max(Interpolate(points, target, true) - APPROACH_STEPS, 0.0);
+    if (corrected < from) {
+      approach.Check(overshoot - expected, target);
+      if (corrected >= 0 && overshoot > corrected) {  // below home the clamp to 0 is the whole point
+        approach.failures++;
+      }
+    }
+  }
+
+  printf("%d points over %d steps, targets %d to %d, tolerance %.3f steps\n", pointCount, TRAVEL_STEPS, first, last,
+         correct.tolerance);
+  printf("  Correct()   worst %+.3f steps at %d, %d over tolerance\n", correct.error, correct.at, correct.failures);
+  printf("  Measured()  worst %+.3f steps at %d, %d over tolerance\n", measured.error, measured.at, measured.failures);
+  printf("  approach    worst %+.3f steps at %d, %d over tolerance\n", approach.error, approach.at, approach.failures);
+  ok = ok && correct.failures == 0 && measured.failures == 0 && approach.failures == 0;
+
+  // Random targets so the branch predictor can't learn the search path
+  std::vector<int32_t> targets(4096);
+  for (int32_t &target : targets) {
+    target = first + (int32_t)(((int64_t)rand() * (last - first)) / RAND_MAX);
+  }
+  volatile int64_t sink = 0;
+  int64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < lookups; i++) {
+    sum += table.Correct(targets[i & (targets.size() - 1)]);
+  }
+  auto end = std::chrono::steady_clock::now();
+  sink = sum;
+  (void)sink;
+
+  printf("  Correct()   %.1f ns per lookup over %ld lookups\n",
+         std::chrono::duration<double, std::nano>(end - start).count() / lookups, lookups);
+  printf("%s\n", ok ? "OK" : "MISMATCH");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,363 @@
+// Host fuzz and benchmark of the ClearCore's text protocol parser (ScreenGiga::ReadTextLines/HandleLine in
+// ScreenClasses.cpp), the path a Giga without binary frames uses. Bytes go in through Serial1 from the shims and every
+// line is run through one ScreenPeriodic(), the same as the screen task does on the board.
+//
+//   ./parser-bench                          fuzz 200000 lines, replay the built in session 2000 times
+//   ./parser-bench --lines 1000000 --seed 7
+//   ./parser-bench --capture giga.log       replay raw bytes recorded off the Giga's TX pin instead
+//
+// The fuzz feeds random bytes, mangled commands, lines over the 64 byte buffer and truncated prefixes of the
+// commands, and checks the events that come out against a plain reading of the protocol. The replay times the parse
+// of each message, the Serial1 shim's reads included (they cost more than the UART ring does on the board). Either
+// fails if the parser touches the heap. Exits non-zero on any mismatch.
+// For bounds checking build with CXXFLAGS="-O1 -g -fsanitize=address,undefined".
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <HeapHooks.h>
+#include "ScreenClasses.h"
+
+// --- The protocol as the Giga documents it ---
+
+static const size_t LINE_LIMIT = 64;       // ScreenGiga::LINE_BUFFER_SIZE
+static const size_t ENTERED_TEXT_MAX = 23; // Screen::ENTERED_TEXT_SIZE less the terminator
+
+struct Expected {
+  SCREEN_OBJECT object = NONE;
+  std::string text;  // KEYBOARD_VALUE_ENTER only
+};
+
+static SCREEN_OBJECT ButtonObject(int index) {
+  switch (index) {
+    case 2: return MEASURE_BUTTON;
+    case 3: return EDIT_TARGET_BUTTON;
+    case 4: return HOME_BUTTON;
+    case 5: return RESET_SERVO_BUTTON;
+    case 6: return SETTINGS_BUTTON;
+    case 7: return EDIT_MAX_TRAVEL_BUTTON;
+    case 10: return EXIT_SETTINGS_BUTTON;
+    case 11: return INCHES_UNIT_BUTTON;
+    case 12: return MILLIMETERS_UNIT_BUTTON;
+    case 13: return NEXT_CUT_BUTTON;
+    default: return NONE;
+  }
+}
+
+static bool IsMotion(SCREEN_OBJECT object) {
+  return object == MEASURE_BUTTON || object == HOME_BUTTON || object == NEXT_CUT_BUTTON;
+}
+
+// One line without its terminator. Unprintable bytes never reach the parser, a line with more than LINE_LIMIT
+// printable ones is dropped whole, then BUTTON:<0-255> or ENTER:<text> after trimming spaces.
+static Expected ParseReference(const std::string &raw) {
+  Expected expected;
+  std::string line;
+  for (char c : raw) {
+    if (isprint((unsigned char)c)) {
+      line += c;
+    }
+  }
+  if (line.size() > LINE_LIMIT) {
+    return expected;
+  }
+
+  size_t begin = line.find_first_not_of(' ');
+  if (begin == std::string::npos) {
+    return expected;
+  }
+  line = line.substr(begin, line.find_last_not_of(' ') - begin + 1);
+
+  if (line.compare(0, 6, "ENTER:") == 0) {
+    expected.object = KEYBOARD_VALUE_ENTER;
+    expected.text = line.substr(6, ENTERED_TEXT_MAX);
+  } else if (line.compare(0, 7, "BUTTON:") == 0) {
+    std::string digits = line.substr(7);
+    digits.erase(0, digits.find_first_not_of(' '));
+    if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos) {
+      return expected;
+    }
+    digits.erase(0, min(digits.find_first_not_of('0'), digits.size() - 1));  // leading zeros, any number of them
+    if (digits.size() > 3) {
+      return expected;
+    }
+    int index = atoi(digits.c_str());
+    if (index <= 255) {
+      expected.object = ButtonObject(index);
+    }
+  }
+  return expected;
+}
+
+// --- Harness ---
+
+static std::vector<SCREEN_OBJECT> dispatched;
+
+static void OnEvent(SCREEN_OBJECT object) {
+  dispatched.push_back(object);
+}
+
+struct ParseStats {
+  std::vector<double> ns;  // per message
+  uint64_t allocations = 0;
+  size_t heapPeak = 0;
+
+  void Reserve(size_t count) { ns.reserve(count); }
+};
+
+// Feeds one message and runs one screen tick over it, timed and with the heap watched
+static void Feed(ScreenGiga &screen, const std::string &bytes, ParseStats &stats) {
+  Serial1.PeerWrite((const uint8_t *)bytes.data(), bytes.size());
+
+  uint64_t allocsBefore = heapAllocCount;
+  size_t heapBefore = heapCurrent;
+  heapPeak = heapCurrent;
+  auto start = std::chrono::steady_clock::now();
+  screen.ScreenPeriodic();
+  auto end = std::chrono::steady_clock::now();
+
+  stats.ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+  stats.allocations += heapAllocCount - allocsBefore;
+  stats.heapPeak = max(stats.heapPeak, heapPeak - heapBefore);
+}
+
+static std::string Printable(const std::string &line) {
+  std::string out;
+  for (char c : line.substr(0, 80)) {
+    if (isprint((unsigned char)c)) {
+      out += c;
+    } else {
+      char hex[8];
+      snprintf(hex, sizeof(hex), "\\x%02X", (uint8_t)c);
+      out += hex;
+    }
+  }
+  return line.size() > 80 ? out + "..." : out;
+}
+
+static uint32_t rng = 1;
+static uint32_t Random(uint32_t range) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng % range;
+}
+
+static const char *const VALID_LINES[] = {
+  "BUTTON:3", "BUTTON:5", "BUTTON:6", "BUTTON:7", "BUTTON:10", "BUTTON:11", "BUTTON:12",
+  "ENTER:12.5", "ENTER:0.03125", "ENTER:1000", "ENTER:", "ENTER:-3.25",
+};
+static const size_t VALID_LINE_COUNT = sizeof(VALID_LINES) / sizeof(VALID_LINES[0]);
+
+static std::string FuzzLine(uint64_t i) {
+  std::string line;
+  switch (i % 5) {
+    case 0:  // random bytes, anything but a terminator
+      for (uint32_t n = Random(100); n > 0; n--) {
+        char c = (char)Random(256);
+        line += (c == '\n' || c == '\r') ? 'x' : c;
+      }
+      break;
+    case 1: {  // a real command with a byte changed, dropped or added
+      line = VALID_LINES[Random(VALID_LINE_COUNT)];
+      size_t at = Random(line.size() + 1);
+      char c = (char)(Random(2) ? ' ' + Random(95) : Random(256));
+      if (c == '\n' || c == '\r') {
+        c = ' ';
+      }
+      switch (Random(3)) {
+        case 0: if (at < line.size()) line[at] = c; break;
+        case 1: if (at < line.size()) line.erase(at, 1); break;
+        default: line.insert(at, 1, c); break;
+      }
+      break;
+    }
+    case 2: {  // around and over the 64 byte buffer, padded with spaces or junk
+      line = VALID_LINES[Random(VALID_LINE_COUNT)];
+      size_t length = LINE_LIMIT - 8 + Random(300);
+      while (line.size() < length) {
+        line += Random(2) ? ' ' : (char)('A' + Random(26));
+      }
+      if (Random(2)) {
+        std::string padded(Random(8), ' ');
+        line = padded + line;
+      }
+      break;
+    }
+    case 3: {  // a truncated prefix of a command
+      std::string whole = VALID_LINES[Random(VALID_LINE_COUNT)];
+      line = whole.substr(0, Random(whole.size() + 1));
+      break;
+    }
+    default:  // well formed, with the spacing a sloppy sender might use
+      line = std::string(Random(3), ' ') + VALID_LINES[Random(VALID_LINE_COUNT)] + std::string(Random(3), ' ');
+      if (line.find("BUTTON:") != std::string::npos && Random(2)) {
+        line.insert(line.find(':') + 1, std::string(1 + Random(2), Random(2) ? ' ' : '0'));
+      }
+      break;
+  }
+  return line;
+}
+
+// Returns the number of mismatches
+static int Fuzz(uint64_t lines, ParseStats &stats) {
+  ScreenGiga screen(9600);
+  screen.RegisterEventCallback(OnEvent);
+  SCREEN_OBJECT lastDispatched = NONE;
+  int failures = 0;
+  uint64_t skippedMotion = 0;
+  uint64_t events = 0;
+
+  for (uint64_t i = 0; i < lines; i++) {
+    std::string line = FuzzLine(i);
+    Expected expected = ParseReference(line);
+    // Moves are held back for 400 ms of real time, which would stall everything queued behind them
+    if (IsMotion(expected.object)) {
+      skippedMotion++;
+      continue;
+    }
+
+    dispatched.clear();
+    Feed(screen, line + (Random(2) ? "\r\n" : "\n"), stats);
+
+    // A straight repeat of the last event may be debounced, depending on how long ago that was in real time
+    bool ok;
+    if (expected.object == NONE) {
+      ok = dispatched.empty();
+    } else if (expected.object == lastDispatched) {
+      ok = dispatched.empty() || (dispatched.size() == 1 && dispatched[0] == expected.object);
+    } else {
+      ok = dispatched.size() == 1 && dispatched[0] == expected.object;
+    }
+    if (ok && !dispatched.empty() && expected.object == KEYBOARD_VALUE_ENTER) {
+      ok = screen.GetParameterInputValue() == String(expected.text.c_str());
+    }
+
+    if (!dispatched.empty()) {
+      lastDispatched = dispatched.back();
+      events += dispatched.size();
+    }
+    if (!ok && ++failures <= 10) {
+      printf("  MISMATCH on \"%s\": expected object %d, got", Printable(line).c_str(), expected.object);
+      for (SCREEN_OBJECT object : dispatched) {
+        printf(" %d", object);
+      }
+      printf(dispatched.empty() ? " nothing\n" : "\n");
+    }
+  }
+
+  printf("Fuzz: %llu lines, %llu events, %llu motion lines skipped, %d mismatches\n", (unsigned long long)lines,
+         (unsigned long long)events, (unsigned long long)skippedMotion, failures);
+  return failures;
+}
+
+// A normal session off the touch screen: home, set a target, measure, change units and max travel in the settings
+static const char *const SESSION[] = {
+  "BUTTON:4", "BUTTON:3", "ENTER:12.5", "BUTTON:2", "BUTTON:3", "ENTER:24.75", "BUTTON:2", "BUTTON:13", "BUTTON:6",
+  "BUTTON:12", "BUTTON:11", "BUTTON:7", "ENTER:96", "BUTTON:10", "BUTTON:3", "ENTER:0.5", "BUTTON:2", "BUTTON:5",
+};
+
+static std::vector<std::string> LoadCapture(const char *path) {
+  std::vector<std::string> messages;
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr) {
+    return messages;
+  }
+  std::string message;
+  int c;
+  while ((c = fgetc(file)) != EOF) {
+    message += (char)c;
+    if (c == '\n') {
+      messages.push_back(message);
+      message.clear();
+    }
+  }
+  if (!message.empty()) {
+    messages.push_back(message);
+  }
+  fclose(file);
+  return messages;
+}
+
+static void Replay(const std::vector<std::string> &messages, int passes, ParseStats &stats) {
+  ScreenGiga screen(9600);
+  screen.RegisterEventCallback(OnEvent);
+  for (int pass = 0; pass < passes; pass++) {
+    for (const std::string &message : messages) {
+      dispatched.clear();
+      Feed(screen, message, stats);
+    }
+  }
+}
+
+static void PrintTimes(const char *name, ParseStats &stats) {
+  if (stats.ns.empty()) {
+    return;
+  }
+  std::vector<double> &ns = stats.ns;
+  double total = 0;
+  for (double t : ns) {
+    total += t;
+  }
+  std::sort(ns.begin(), ns.end());
+  printf("%s: %zu messages, per message avg %.0f  p50 %.0f  p99 %.0f  max %.0f ns\n", name, ns.size(),
+         total / ns.size(), ns[ns.size() / 2], ns[ns.size() * 99 / 100], ns.back());
+  printf("  heap: %llu allocations while parsing, peak %zu bytes over the %zu bytes held before\n",
+         (unsigned long long)stats.allocations, stats.heapPeak, heapCurrent);
+}
+
+int main(int argc, char **argv) {
+  uint64_t lines = 200000;
+  int passes = 2000;
+  const char *capturePath = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+      lines = strtoull(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      rng = (uint32_t)strtoul(argv[++i], nullptr, 10) | 1;
+    } else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+      passes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+      capturePath = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--lines n] [--seed n] [--passes n] [--capture file]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("ScreenGiga is %zu bytes, line buffer %zu\n", sizeof(ScreenGiga), LINE_LIMIT);
+  dispatched.reserve(32);  // the callback runs inside the measured tick, it must not grow this there
+
+  ParseStats fuzzStats;
+  fuzzStats.Reserve(lines);
+  int failures = Fuzz(lines, fuzzStats);
+  PrintTimes("Fuzz", fuzzStats);
+
+  std::vector<std::string> messages;
+  if (capturePath != nullptr) {
+    messages = LoadCapture(capturePath);
+    if (messages.empty()) {
+      fprintf(stderr, "Nothing to replay in %s\n", capturePath);
+      return 2;
+    }
+  } else {
+    for (const char *line : SESSION) {
+      messages.push_back(std::string(line) + "\r\n");  // println on the Giga
+    }
+  }
+  ParseStats replayStats;
+  replayStats.Reserve(messages.size() * passes);
+  Replay(messages, passes, replayStats);
+  PrintTimes(capturePath != nullptr ? "Capture replay" : "Session replay", replayStats);
+
+  bool ok = failures == 0 && fuzzStats.allocations == 0 && replayStats.allocations == 0;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
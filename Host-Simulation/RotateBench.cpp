@@ -0,0 +1,74 @@
+// Host benchmark of the RGB565 rotate kernels the Giga's display flush uses (rotate.cpp in the Arduino_H7_Video
+// replacement lib). Rotates one LVGL draw strip, 800x48 by default, with the tiled kernels and the one pixel at a time
+// reference, checks they agree and prints the time per strip.
+//
+//   ./rotate-bench                 800x48, 2000 strips per kernel
+//   ./rotate-bench 800 96 500      width, height, strips
+//
+// Host caches are far bigger than the M7's 16 KB D-cache, so the gap to the reference is smaller here than on the
+// board. Treat the numbers as relative.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "rotate.h"
+
+typedef void (*RotateFn)(const uint16_t *, uint32_t, uint16_t *, uint32_t, uint32_t, uint32_t, rotate_angle_t);
+
+static const char *AngleName(rotate_angle_t angle) {
+  switch (angle) {
+    case ROTATE_90_CW: return "90 cw ";
+    case ROTATE_180: return "180   ";
+    default: return "90 ccw";
+  }
+}
+
+// Nanoseconds per strip
+static double TimeKernel(RotateFn fn, const std::vector<uint16_t> &src, std::vector<uint16_t> &dst, uint32_t w, uint32_t h,
+                         rotate_angle_t angle, int strips) {
+  uint32_t dstStride = (angle == ROTATE_180) ? w : h;
+  fn(src.data(), w, dst.data(), dstStride, w, h, angle);  // warm up
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < strips; i++) {
+    fn(src.data(), w, dst.data(), dstStride, w, h, angle);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / strips;
+}
+
+int main(int argc, char **argv) {
+  uint32_t w = (argc > 1) ? atoi(argv[1]) : 800;
+  uint32_t h = (argc > 2) ? atoi(argv[2]) : 48;
+  int strips = (argc > 3) ? atoi(argv[3]) : 2000;
+  if (w == 0 || h == 0 || strips <= 0) {
+    fprintf(stderr, "usage: %s [width height strips]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<uint16_t> src(w * h);
+  std::vector<uint16_t> reference(w * h);
+  std::vector<uint16_t> tiled(w * h);
+  srand(1);
+  for (uint16_t &pixel : src) {
+    pixel = rand() & 0xFFFF;
+  }
+
+  printf("%ux%u RGB565 strip, %d strips per kernel, %u px tiles\n", w, h, strips, ROTATE_TILE);
+  bool ok = true;
+  const rotate_angle_t angles[] = {ROTATE_90_CW, ROTATE_90_CCW, ROTATE_180};
+  for (rotate_angle_t angle : angles) {
+    double referenceNs = TimeKernel(rotate_rgb565_reference, src, reference, w, h, angle, strips);
+    double tiledNs = TimeKernel(rotate_rgb565, src, tiled, w, h, angle, strips);
+    bool match = memcmp(reference.data(), tiled.data(), w * h * sizeof(uint16_t)) == 0;
+    ok = ok && match;
+
+    printf("  %s  reference %8.1f us  tiled %8.1f us  (%.2fx, %.0f Mpx/s)%s\n", AngleName(angle), referenceNs / 1000,
+           tiledNs / 1000, referenceNs / tiledNs, w * h / tiledNs * 1000, match ? "" : "  MISMATCH");
+  }
+  return ok ? 0 : 1;
+}
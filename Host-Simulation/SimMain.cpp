@@ -0,0 +1,565 @@
+// Host simulation of the ClearCore fence firmware.
+// Runs the real setup()/loop() against the shims in shims/, plays a stand-in Giga on the other end of Serial1 and
+// reports boot time, loop cycle time, move latency and heap use at the end of the run.
+//
+//   ./fence-sim [--scenario scenarios/home-and-measure.txt] [--duration 5000] [--text] [--giga-boot-ms 800] [--quiet]
+//               [--serial-log file]   raw copy of the serial monitor output, for trace-decode
+//               [--giga-max-baud n]   link echoes get corrupted above this rate, like a marginal cable
+//               [--giga-lose-committed n]   the first n COMMITTED answers never reach the ClearCore
+
+#include <algorithm>
+#include <Arduino.h>
+#include <ClearCore.h>
+#include <HeapHooks.h>
+#include "FrameProtocol.h"
+#include "LoopTrace.h"
+
+void setup();
+void loop();
+
+// --- Simulated Giga ---
+// Answers the handshake after gigaBootMs, then decodes whatever the ClearCore sends and can press buttons.
+
+static bool gigaTextOnly = false;
+static bool gigaQuiet = false;
+static unsigned long gigaBootMs = 800;
+
+static bool gigaBinary = false;
+
+// Link speed. Bytes only get through while both ends are on the same rate, anything else arrives as garbage.
+static const unsigned long GIGA_BASE_BAUD = 9600;  // LINK_BASE_BAUD in the Giga sketch
+static const uint16_t GIGA_GARBAGE_LIMIT = 96;      // LINK_GARBAGE_LIMIT in the Giga sketch
+static unsigned long gigaMaxBaud = 0;
+static unsigned long gigaLoseCommitted = 0;
+static uint16_t gigaGarbageBytes = 0;
+static unsigned long gigaBaud = GIGA_BASE_BAUD;
+static unsigned long gigaTrialPrevBaud = GIGA_BASE_BAUD;
+static unsigned long gigaTrialStartMs = 0;
+static bool gigaTrialPending = false;
+static char gigaLine[96];
+static uint8_t gigaLineLength = 0;
+static FrameParser gigaParser;
+static FrameWriter gigaWriter;
+
+// The Giga's end of Serial1, so FrameWriter can send into it
+class GigaPort : public Stream {
+public:
+  size_t write(uint8_t b) override {
+    if (gigaBaud != Serial1.GetBaud()) {
+      b = 0x00;  // what a receiver on the wrong rate mostly makes of it
+    }
+    Serial1.PeerWrite(&b, 1);
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    for (size_t i = 0; i < size; i++) {
+      write(buffer[i]);
+    }
+    return size;
+  }
+  using Print::write;
+  int available() override { return Serial1.PeerAvailable(); }
+  int read() override { return Serial1.PeerRead(); }
+  int peek() override { return -1; }
+};
+static GigaPort gigaPort;
+
+static uint32_t gigaLabelUpdates = 0;
+static uint32_t gigaScreenUpdates = 0;
+
+// Position stream, per POSITION_KIND, plus the busiest one second window to check the rate limit against the baud
+static uint32_t gigaPositionFrames[POSITION_END + 1] = {};
+static uint64_t gigaPositionBytes = 0;
+static unsigned long positionWindowStartMs = 0;
+static uint32_t positionWindowBytes = 0;
+static uint32_t positionPeakWindowBytes = 0;
+
+static void GigaLog(const char *what, int index, const char *text) {
+  if (gigaQuiet) {
+    return;
+  }
+  if (text != nullptr) {
+    printf("[giga %6lu ms] %s %d \"%s\"\n", millis(), what, index, text);
+  } else {
+    printf("[giga %6lu ms] %s %d\n", millis(), what, index);
+  }
+}
+
+static void GigaWriteText(const char *line) {
+  gigaPort.write((const uint8_t *)line, strlen(line));
+  gigaPort.write((const uint8_t *)"\r\n", 2);
+}
+
+static void GigaHandleLine(char *line) {
+  if (strcmp(line, FRAME_HELLO_TEXT) == 0 || strcmp(line, "HELLO") == 0) {
+    if (millis() < gigaBootMs) {
+      return;  // still "booting", the ClearCore keeps retrying
+    }
+    if (!gigaTextOnly && strcmp(line, FRAME_HELLO_TEXT) == 0) {
+      GigaWriteText(FRAME_ACK_TEXT);
+      gigaBinary = true;
+    } else {
+      GigaWriteText("ACK");
+    }
+    GigaLog(gigaBinary ? "handshake binary" : "handshake text", 0, nullptr);
+    return;
+  }
+
+  char *separator = strrchr(line, ':');
+  if (separator == nullptr) {
+    return;
+  }
+  *separator = '\0';
+  const char *value = separator + 1;
+
+  if (strcmp(line, "SETSCREEN") == 0) {
+    gigaScreenUpdates++;
+    GigaLog("screen", atoi(value), nullptr);
+  } else if (strcmp(line, "SETSWITCHTOSTATE") == 0) {
+    GigaLog("switch", atoi(value), nullptr);
+  } else if (strncmp(line, "SETLABEL:", 9) == 0) {
+    // SETLABEL:<index>:<text>, the text itself can't hold a ':' in the text protocol
+    gigaLabelUpdates++;
+    GigaLog("label", atoi(line + 9), value);
+  }
+}
+
+static void GigaHandleFrame(const Frame &frame) {
+  switch (frame.type) {
+    case FRAME_SET_LABEL: {
+      char text[FRAME_MAX_PAYLOAD + 1];
+      uint8_t length = frame.length > 0 ? frame.length - 1 : 0;
+      memcpy(text, frame.payload + 1, length);
+      text[length] = '\0';
+      gigaLabelUpdates++;
+      GigaLog("label", frame.payload[0], text);
+      break;
+    }
+    case FRAME_SET_SCREEN:
+      gigaScreenUpdates++;
+      GigaLog("screen", frame.payload[0], nullptr);
+      break;
+    case FRAME_SET_SWITCH:
+      GigaLog("switch", frame.payload[0], nullptr);
+      break;
+    case FRAME_POSITION: {
+      if (frame.length < 1 || frame.payload[0] > POSITION_END) {
+        break;
+      }
+      gigaPositionFrames[frame.payload[0]]++;
+      gigaPositionBytes += frame.length + FRAME_OVERHEAD;
+      if (millis() - positionWindowStartMs >= 1000) {
+        positionWindowStartMs = millis();
+        positionWindowBytes = 0;
+      }
+      positionWindowBytes += frame.length + FRAME_OVERHEAD;
+      positionPeakWindowBytes = max(positionPeakWindowBytes, positionWindowBytes);
+
+      // Deltas would flood the log, the key and end frames show where the move went
+      char text[40];
+      if (frame.payload[0] == POSITION_KEY && frame.length >= POSITION_KEY_LENGTH) {
+        snprintf(text, sizeof(text), "%d -> %d", (int)FrameGetI32(frame.payload + 5), (int)FrameGetI32(frame.payload + 9));
+        GigaLog("position key", FrameGetI32(frame.payload + 1), text);
+      } else if (frame.payload[0] == POSITION_END && frame.length >= POSITION_END_LENGTH) {
+        GigaLog("position end", FrameGetI32(frame.payload + 1), nullptr);
+      }
+      break;
+    }
+    case FRAME_LINK_PROPOSE: {
+      uint32_t rate = frame.length >= 4 ? (uint32_t)FrameGetI32(frame.payload) : 0;
+      if (std::find(LINK_BAUD_RATES, LINK_BAUD_RATES + LINK_BAUD_RATE_COUNT, rate) == LINK_BAUD_RATES + LINK_BAUD_RATE_COUNT) {
+        break;
+      }
+      gigaWriter.Send(gigaPort, FRAME_LINK_ACCEPT, frame.payload, 4);
+      gigaTrialPrevBaud = gigaBaud;
+      gigaBaud = rate;
+      gigaGarbageBytes = 0;
+      gigaTrialPending = true;
+      gigaTrialStartMs = millis();
+      GigaLog("link trial", rate, nullptr);
+      break;
+    }
+    case FRAME_LINK_ECHO: {
+      uint8_t reply[FRAME_MAX_PAYLOAD];
+      memcpy(reply, frame.payload, frame.length);
+      if (gigaMaxBaud > 0 && gigaBaud > gigaMaxBaud && frame.length > 8) {
+        reply[8] ^= 0x10;
+      }
+      gigaWriter.Send(gigaPort, FRAME_LINK_ECHO_REPLY, reply, frame.length);
+      break;
+    }
+    case FRAME_LINK_COMMIT:
+      if (frame.length >= 4 && (uint32_t)FrameGetI32(frame.payload) == gigaBaud) {
+        gigaTrialPending = false;
+        if (gigaLoseCommitted > 0) {
+          gigaLoseCommitted--;
+          GigaLog("link committed, answer lost", gigaBaud, nullptr);
+          break;
+        }
+        gigaWriter.Send(gigaPort, FRAME_LINK_COMMITTED, frame.payload, 4);
+        GigaLog("link committed", gigaBaud, nullptr);
+      }
+      break;
+  }
+}
+
+// Called by Serial1 whenever the firmware looks at the port
+static void GigaPump() {
+  if (gigaTrialPending && millis() - gigaTrialStartMs >= LINK_TRIAL_TIMEOUT_MS) {
+    gigaTrialPending = false;
+    gigaBaud = gigaTrialPrevBaud;
+    gigaGarbageBytes = 0;
+    GigaLog("link trial timed out, back to", gigaBaud, nullptr);
+  } else if (gigaBaud != GIGA_BASE_BAUD && !gigaTrialPending && gigaGarbageBytes >= GIGA_GARBAGE_LIMIT) {
+    // Same order as the sketch: the rate the last trial came from, then the base rate
+    gigaBaud = gigaTrialPrevBaud < gigaBaud ? gigaTrialPrevBaud : GIGA_BASE_BAUD;
+    gigaTrialPrevBaud = GIGA_BASE_BAUD;
+    gigaGarbageBytes = 0;
+    GigaLog("link garbage, back to", gigaBaud, nullptr);
+  }
+
+  int c;
+  while ((c = Serial1.PeerRead()) >= 0) {
+    if (gigaBaud != Serial1.GetBaud()) {
+      if (gigaGarbageBytes < GIGA_GARBAGE_LIMIT) {
+        gigaGarbageBytes++;  // garbage on this end
+      }
+      continue;
+    }
+    if (gigaBinary) {
+      if (gigaParser.Feed((uint8_t)c)) {
+        gigaGarbageBytes = 0;
+        do {
+          GigaHandleFrame(gigaParser.GetFrame());
+        } while (gigaParser.Next());
+      }
+      continue;
+    }
+
+    if (c == '\n') {
+      gigaLine[gigaLineLength] = '\0';
+      GigaHandleLine(gigaLine);
+      gigaLineLength = 0;
+    } else if (c != '\r' && gigaLineLength < sizeof(gigaLine) - 1) {
+      gigaLine[gigaLineLength++] = (char)c;
+    }
+  }
+}
+
+static void GigaPressButton(int object) {
+  if (gigaBinary) {
+    gigaWriter.SendIndex(gigaPort, FRAME_BUTTON, (uint8_t)object);
+  } else {
+    char line[16];
+    snprintf(line, sizeof(line), "BUTTON:%d", object);
+    GigaWriteText(line);
+  }
+}
+
+static void GigaEnter(const char *text) {
+  if (gigaBinary) {
+    gigaWriter.SendText(gigaPort, FRAME_ENTER, text);
+  } else {
+    char line[80];
+    snprintf(line, sizeof(line), "ENTER:%s", text);
+    GigaWriteText(line);
+  }
+}
+
+// --- Scenario ---
+// One event per line, times in ms after setup() returns:
+//   <ms> BUTTON <object index>
+//   <ms> ENTER <text>
+//   <ms> ALERT            servo fault, clears after RESET_SERVO_BUTTON like the real drive
+//   <ms> TRACE            types TRACE_DUMP_REQUEST into the serial monitor
+//   <ms> STATS            types SCHEDULER_STATS_REQUEST ('S') into the serial monitor
+//   <ms> BENCHMARK        types LINK_BENCHMARK_REQUEST ('B') into the serial monitor
+//   <ms> END
+// Blank lines and lines starting with # are ignored.
+
+enum ScenarioAction {
+  ACTION_BUTTON,
+  ACTION_ENTER,
+  ACTION_ALERT,
+  ACTION_TRACE,
+  ACTION_STATS,
+  ACTION_BENCHMARK,
+  ACTION_END
+};
+
+struct ScenarioEvent {
+  unsigned long atMs;
+  ScenarioAction action;
+  int object;
+  char text[32];
+};
+
+static const int MAX_SCENARIO_EVENTS = 256;
+static ScenarioEvent scenario[MAX_SCENARIO_EVENTS];
+static int scenarioCount = 0;
+
+static bool LoadScenario(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    fprintf(stderr, "[sim] can't open scenario %s\n", path);
+    return false;
+  }
+
+  char line[128];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), file) != nullptr && scenarioCount < MAX_SCENARIO_EVENTS) {
+    lineNumber++;
+    char word[16] = "";
+    unsigned long atMs;
+    int consumed = 0;
+    if (line[0] == '#' || sscanf(line, "%lu %15s %n", &atMs, word, &consumed) < 2) {
+      continue;
+    }
+
+    ScenarioEvent &event = scenario[scenarioCount];
+    event.atMs = atMs;
+    event.object = 0;
+    event.text[0] = '\0';
+
+    if (strcmp(word, "BUTTON") == 0) {
+      event.action = ACTION_BUTTON;
+      event.object = atoi(line + consumed);
+    } else if (strcmp(word, "ENTER") == 0) {
+      event.action = ACTION_ENTER;
+      sscanf(line + consumed, "%31s", event.text);
+    } else if (strcmp(word, "ALERT") == 0) {
+      event.action = ACTION_ALERT;
+    } else if (strcmp(word, "TRACE") == 0) {
+      event.action = ACTION_TRACE;
+    } else if (strcmp(word, "STATS") == 0) {
+      event.action = ACTION_STATS;
+    } else if (strcmp(word, "BENCHMARK") == 0) {
+      event.action = ACTION_BENCHMARK;
+    } else if (strcmp(word, "END") == 0) {
+      event.action = ACTION_END;
+    } else {
+      fprintf(stderr, "[sim] %s:%d: unknown event '%s'\n", path, lineNumber, word);
+      continue;
+    }
+    scenarioCount++;
+  }
+  fclose(file);
+
+  std::stable_sort(scenario, scenario + scenarioCount, [](const ScenarioEvent &a, const ScenarioEvent &b) {
+    return a.atMs < b.atMs;
+  });
+  return true;
+}
+
+// --- Metrics ---
+
+static const int MAX_CYCLE_SAMPLES = 1 << 20;
+static uint32_t cycleUs[MAX_CYCLE_SAMPLES];
+static uint32_t busyUs[MAX_CYCLE_SAMPLES];
+static int cycleCount = 0;
+
+// A button press is tracked until the servo starts the move it asked for and until HLFB says it has settled
+struct MoveLatency {
+  unsigned long pressUs;  // toMoveUs is -1 while waiting for a move, -2 once a later press took over
+  uint32_t moveCountAtPress;
+  long toMoveUs;
+  long toSettledUs;
+};
+
+static const int MAX_MOVE_SAMPLES = 256;
+static MoveLatency moves[MAX_MOVE_SAMPLES];
+static int moveSampleCount = 0;
+
+static void TrackMoves() {
+  for (int i = 0; i < moveSampleCount; i++) {
+    MoveLatency &sample = moves[i];
+    if (sample.toMoveUs == -1 && ConnectorM0.SimGetMoveCount() > sample.moveCountAtPress) {
+      sample.toMoveUs = (long)(ConnectorM0.SimGetLastMoveStartUs() - sample.pressUs);
+    }
+    if (sample.toMoveUs >= 0 && sample.toSettledUs < 0) {
+      uint32_t settled = ConnectorM0.SimGetLastSettledUs();
+      if (settled != 0 && micros() >= settled) {
+        sample.toSettledUs = (long)(settled - sample.pressUs);
+      }
+    }
+  }
+}
+
+static uint32_t Percentile(uint32_t *samples, int count, int percent) {
+  if (count == 0) {
+    return 0;
+  }
+  std::sort(samples, samples + count);
+  return samples[min(count - 1, count * percent / 100)];
+}
+
+static void PrintCycleStats(const char *name, uint32_t *samples, int count) {
+  if (count == 0) {
+    printf("  %-6s no samples\n", name);
+    return;
+  }
+  uint64_t total = 0;
+  for (int i = 0; i < count; i++) {
+    total += samples[i];
+  }
+  uint32_t p50 = Percentile(samples, count, 50);
+  uint32_t p99 = Percentile(samples, count, 99);
+  printf("  %-6s min %6u  avg %6llu  p50 %6u  p99 %6u  max %6u us\n", name, samples[0],
+         (unsigned long long)(total / count), p50, p99, samples[count - 1]);
+}
+
+static void PrintReport(unsigned long bootMs, size_t heapAfterBoot, uint64_t allocsAfterBoot) {
+  printf("\n=== Simulation report ===\n");
+  printf("Boot (setup) time:      %lu ms\n", bootMs);
+  printf("Link:                   %s at %lu baud, %u label and %u screen updates, %llu bytes sent by the ClearCore\n",
+         gigaBinary ? "binary frames" : "text", gigaBaud, gigaLabelUpdates, gigaScreenUpdates,
+         (unsigned long long)Serial1.GetBytesWritten());
+  if (gigaPositionBytes > 0) {
+    unsigned long linkBytesPerSecond = Serial1.GetBaud() / 10;
+    printf("Position stream:        %u key, %u delta, %u end frames, %llu bytes, busiest second %u bytes (%.1f%% of %lu baud)\n",
+           gigaPositionFrames[POSITION_KEY], gigaPositionFrames[POSITION_DELTA], gigaPositionFrames[POSITION_END],
+           (unsigned long long)gigaPositionBytes, positionPeakWindowBytes,
+           linkBytesPerSecond > 0 ? 100.0 * positionPeakWindowBytes / linkBytesPerSecond : 0.0, Serial1.GetBaud());
+  }
+
+  printf("Loop cycles:            %d\n", cycleCount);
+  PrintCycleStats("cycle", cycleUs, cycleCount);
+  PrintCycleStats("busy", busyUs, cycleCount);  // cycle minus time spent sleeping in delay()
+
+  printf("Moves:                  %d, step generator started from rest %u times\n", moveSampleCount, ConnectorM0.SimGetMoveCount());
+  for (int i = 0; i < moveSampleCount; i++) {
+    if (moves[i].toSettledUs < 0) {
+      printf("  move %d: started %ld us after the press, not settled\n", i + 1, moves[i].toMoveUs);
+    } else {
+      printf("  move %d: started %ld us after the press, settled %ld ms after it\n", i + 1, moves[i].toMoveUs,
+             moves[i].toSettledUs / 1000);
+    }
+  }
+
+  printf("Heap after boot:        %zu bytes\n", heapAfterBoot);
+  printf("Heap at end / peak:     %zu / %zu bytes\n", heapCurrent, heapPeak);
+  printf("Allocations in loop():  %llu\n", (unsigned long long)(heapAllocCount - allocsAfterBoot));
+}
+
+// --- Main ---
+
+int main(int argc, char **argv) {
+  const char *scenarioPath = nullptr;
+  unsigned long durationMs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+      scenarioPath = argv[++i];
+    } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+      durationMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--giga-boot-ms") == 0 && i + 1 < argc) {
+      gigaBootMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--giga-max-baud") == 0 && i + 1 < argc) {
+      gigaMaxBaud = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--giga-lose-committed") == 0 && i + 1 < argc) {
+      gigaLoseCommitted = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--text") == 0) {
+      gigaTextOnly = true;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      gigaQuiet = true;
+    } else if (strcmp(argv[i], "--serial-log") == 0 && i + 1 < argc) {
+      FILE *log = fopen(argv[++i], "wb");
+      if (log == nullptr) {
+        fprintf(stderr, "[sim] can't write %s\n", argv[i]);
+        return 1;
+      }
+      Serial.SetLog(log);
+    } else {
+      fprintf(stderr, "usage: %s [--scenario file] [--duration ms] [--giga-boot-ms ms] [--text] [--quiet] [--serial-log file] [--giga-max-baud n] [--giga-lose-committed n]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (scenarioPath != nullptr && !LoadScenario(scenarioPath)) {
+    return 1;
+  }
+  if (durationMs == 0) {
+    // Without --duration run a scenario to its last event (plus time for the last move), otherwise idle for 5 s
+    durationMs = scenarioCount > 0 ? scenario[scenarioCount - 1].atMs + 2000 : 5000;
+  }
+
+  Serial1.SetPeerPump(GigaPump);
+
+  setup();
+
+  unsigned long bootMs = millis();
+  size_t heapAfterBoot = heapCurrent;
+  uint64_t allocsAfterBoot = heapAllocCount;
+
+  int nextEvent = 0;
+  unsigned long endMs = bootMs + durationMs;
+  while (millis() < endMs) {
+    unsigned long sinceBoot = millis() - bootMs;
+    while (nextEvent < scenarioCount && scenario[nextEvent].atMs <= sinceBoot) {
+      ScenarioEvent &event = scenario[nextEvent++];
+      switch (event.action) {
+        case ACTION_BUTTON:
+          // A move only belongs to the last press before it
+          for (int i = 0; i < moveSampleCount; i++) {
+            if (moves[i].toMoveUs == -1) {
+              moves[i].toMoveUs = -2;
+            }
+          }
+          if (moveSampleCount < MAX_MOVE_SAMPLES) {
+            moves[moveSampleCount++] = { micros(), ConnectorM0.SimGetMoveCount(), -1, -1 };
+          }
+          GigaPressButton(event.object);
+          break;
+        case ACTION_ENTER:
+          GigaEnter(event.text);
+          break;
+        case ACTION_ALERT:
+          printf("[sim %6lu ms] injecting servo fault\n", millis());
+          ConnectorM0.SimInjectFault();
+          break;
+        case ACTION_TRACE: {
+          uint8_t request = TRACE_DUMP_REQUEST;
+          Serial.PeerWrite(&request, 1);
+          break;
+        }
+        case ACTION_STATS: {
+          uint8_t request = 'S';
+          Serial.PeerWrite(&request, 1);
+          break;
+        }
+        case ACTION_BENCHMARK: {
+          uint8_t request = 'B';
+          Serial.PeerWrite(&request, 1);
+          break;
+        }
+        case ACTION_END:
+          endMs = millis();
+          break;
+      }
+    }
+
+    unsigned long startUs = micros();
+    uint64_t sleptBefore = SimSleptMicros();
+    loop();
+    uint32_t elapsed = micros() - startUs;
+
+    if (cycleCount < MAX_CYCLE_SAMPLES) {
+      cycleUs[cycleCount] = elapsed;
+      busyUs[cycleCount] = elapsed - (uint32_t)(SimSleptMicros() - sleptBefore);
+      cycleCount++;
+    }
+    TrackMoves();
+  }
+
+  // Only keep presses that caused a move, the rest were screen navigation
+  int kept = 0;
+  for (int i = 0; i < moveSampleCount; i++) {
+    if (moves[i].toMoveUs >= 0) {
+      moves[kept++] = moves[i];
+    }
+  }
+  moveSampleCount = kept;
+
+  PrintReport(bootMs, heapAfterBoot, allocsAfterBoot);
+  return 0;
+}
@@ -0,0 +1,314 @@
+// Decodes the loop trace dump the firmware writes to the serial monitor (see LoopTrace.h) into per-section timing
+// stats and a flame style summary of the last events in the ring.
+//
+//   ./trace-decode capture.bin            stats and summary of the last dump in the capture
+//   ./trace-decode --folded capture.bin   folded stacks ("loop;screen;button 1234"), for flamegraph.pl
+//
+// The capture can be anything the serial monitor wrote, text included: the decoder looks for the magic and checks
+// the CRC. fence-sim --serial-log writes one, on hardware log the USB serial port with any terminal program.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define TRACE_FORMAT_ONLY
+#include "LoopTrace.h"
+
+struct SectionStats {
+  uint32_t count = 0;
+  uint64_t totalUs = 0;
+  uint32_t minUs = 0;
+  uint32_t maxUs = 0;
+  uint32_t buckets[TRACE_BUCKET_COUNT] = {};
+};
+
+struct TraceEvent {
+  uint32_t startUs;
+  uint32_t durationUs;
+  uint8_t section;
+  uint8_t depth;
+};
+
+struct TraceDump {
+  uint32_t dumpUs = 0;
+  std::vector<SectionStats> sections;
+  std::vector<TraceEvent> events;
+};
+
+// Same CRC-16/CCITT-FALSE as FrameCrc16 in FrameProtocol.cpp
+static uint16_t Crc16(uint16_t crc, uint8_t b) {
+  crc ^= static_cast<uint16_t>(b) << 8;
+  for (int i = 0; i < 8; i++) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
+
+class Reader {
+public:
+  Reader(const std::vector<uint8_t> &data, size_t offset) : data(data), offset(offset) {}
+
+  bool Ok() const { return ok; }
+  size_t Offset() const { return offset; }
+  uint16_t GetCrc() const { return crc; }
+
+  uint8_t U8() {
+    if (offset >= data.size()) {
+      ok = false;
+      return 0;
+    }
+    uint8_t value = data[offset++];
+    crc = Crc16(crc, value);
+    return value;
+  }
+  uint16_t U16() {
+    uint16_t low = U8();
+    return low | (uint16_t)(U8() << 8);
+  }
+  uint32_t U32() {
+    uint32_t low = U16();
+    return low | ((uint32_t)U16() << 16);
+  }
+  uint64_t U64() {
+    uint64_t low = U32();
+    return low | ((uint64_t)U32() << 32);
+  }
+
+private:
+  const std::vector<uint8_t> &data;
+  size_t offset;
+  uint16_t crc = 0xFFFF;
+  bool ok = true;
+};
+
+// Parses the dump whose magic starts at offset. Returns false if it is cut off, corrupt or from another version.
+static bool ParseDump(const std::vector<uint8_t> &data, size_t offset, TraceDump &dump) {
+  Reader reader(data, offset + strlen(TRACE_MAGIC));
+  if (reader.U8() != TRACE_FORMAT_VERSION) {
+    return false;
+  }
+  uint8_t sectionCount = reader.U8();
+  uint16_t eventCount = reader.U16();
+  dump.dumpUs = reader.U32();
+
+  dump.sections.assign(sectionCount, SectionStats());
+  for (SectionStats &stats : dump.sections) {
+    stats.count = reader.U32();
+    stats.totalUs = reader.U64();
+    stats.minUs = reader.U32();
+    stats.maxUs = reader.U32();
+    uint8_t used = reader.U8();
+    for (uint8_t i = 0; i < used && reader.Ok(); i++) {
+      uint8_t bucket = reader.U8();
+      uint32_t count = reader.U32();
+      if (bucket < TRACE_BUCKET_COUNT) {
+        stats.buckets[bucket] = count;
+      }
+    }
+  }
+
+  dump.events.clear();
+  for (uint16_t i = 0; i < eventCount && reader.Ok(); i++) {
+    TraceEvent event;
+    event.startUs = reader.U32();
+    event.durationUs = reader.U32();
+    event.section = reader.U8();
+    event.depth = reader.U8();
+    dump.events.push_back(event);
+  }
+
+  uint16_t expected = reader.GetCrc();
+  size_t end = reader.Offset();
+  if (!reader.Ok() || end + 2 > data.size()) {
+    return false;
+  }
+  return (uint16_t)(data[end] | (data[end + 1] << 8)) == expected;
+}
+
+static uint32_t Percentile(const SectionStats &stats, int percent) {
+  uint64_t rank = ((uint64_t)stats.count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (uint8_t b = 0; b < TRACE_BUCKET_COUNT; b++) {
+    seen += stats.buckets[b];
+    if (seen >= rank) {
+      return std::min(TraceBucketLimit(b), stats.maxUs);
+    }
+  }
+  return stats.maxUs;
+}
+
+static void PrintSections(const TraceDump &dump) {
+  printf("%-14s %9s %9s %9s %9s %9s  (us, p99 within 25%%)\n", "section", "count", "min", "avg", "p99", "max");
+  for (size_t i = 0; i < dump.sections.size(); i++) {
+    const SectionStats &stats = dump.sections[i];
+    if (stats.count == 0) {
+      printf("%-14s %9u\n", TraceSectionName(i), 0u);
+      continue;
+    }
+    printf("%-14s %9u %9u %9llu %9u %9u\n", TraceSectionName(i), stats.count, stats.minUs,
+           (unsigned long long)(stats.totalUs / stats.count), Percentile(stats, 99), stats.maxUs);
+  }
+}
+
+// --- Flame summary ---
+// Events are nested by depth, rebuilt into a call tree. Self time is what a section spent outside its children.
+
+struct FlameNode {
+  std::string name;
+  uint64_t totalUs = 0;
+  uint64_t selfUs = 0;
+  uint32_t count = 0;
+  std::vector<int> children;
+};
+
+static int ChildNode(std::vector<FlameNode> &nodes, int parent, const char *name) {
+  for (int child : nodes[parent].children) {
+    if (nodes[child].name == name) {
+      return child;
+    }
+  }
+  nodes.push_back(FlameNode());
+  nodes.back().name = name;
+  int id = (int)nodes.size() - 1;
+  nodes[parent].children.push_back(id);
+  return id;
+}
+
+static std::vector<FlameNode> BuildFlameTree(std::vector<TraceEvent> events) {
+  // A parent is recorded after its children (it finishes last), sort back into start order
+  std::stable_sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) {
+    int32_t diff = (int32_t)(a.startUs - b.startUs);
+    return diff != 0 ? diff < 0 : a.depth < b.depth;
+  });
+
+  std::vector<FlameNode> nodes(1);  // 0 is the root
+  std::vector<int> stack;
+  for (const TraceEvent &event : events) {
+    // The ring may have dropped the parent of its oldest events, those hang off the root
+    size_t depth = std::min((size_t)event.depth, stack.size());
+    stack.resize(depth);
+    int parent = depth == 0 ? 0 : stack.back();
+
+    int node = ChildNode(nodes, parent, TraceSectionName(event.section));
+    nodes[node].totalUs += event.durationUs;
+    nodes[node].selfUs += event.durationUs;
+    nodes[node].count++;
+    if (parent != 0) {
+      nodes[parent].selfUs -= std::min<uint64_t>(nodes[parent].selfUs, event.durationUs);
+    }
+    stack.push_back(node);
+  }
+  return nodes;
+}
+
+static void PrintFlameNode(const std::vector<FlameNode> &nodes, int id, int indent, uint64_t windowUs) {
+  const FlameNode &node = nodes[id];
+  printf("%*s%-*s %6u %11llu %11llu %6.1f%%\n", indent * 2, "", 24 - indent * 2, node.name.c_str(), node.count,
+         (unsigned long long)node.totalUs, (unsigned long long)node.selfUs, windowUs ? 100.0 * node.totalUs / windowUs : 0.0);
+
+  std::vector<int> children = node.children;
+  std::sort(children.begin(), children.end(), [&](int a, int b) { return nodes[a].totalUs > nodes[b].totalUs; });
+  for (int child : children) {
+    PrintFlameNode(nodes, child, indent + 1, windowUs);
+  }
+}
+
+static void PrintFolded(const std::vector<FlameNode> &nodes, int id, const std::string &prefix) {
+  for (int child : nodes[id].children) {
+    std::string path = prefix.empty() ? nodes[child].name : prefix + ";" + nodes[child].name;
+    if (nodes[child].selfUs > 0) {
+      printf("%s %llu\n", path.c_str(), (unsigned long long)nodes[child].selfUs);
+    }
+    PrintFolded(nodes, child, path);
+  }
+}
+
+static uint64_t WindowUs(const std::vector<TraceEvent> &events) {
+  if (events.empty()) {
+    return 0;
+  }
+  uint32_t first = events[0].startUs;
+  uint32_t last = first;
+  for (const TraceEvent &event : events) {
+    if ((int32_t)(event.startUs - first) < 0) {
+      first = event.startUs;
+    }
+    uint32_t end = event.startUs + event.durationUs;
+    if ((int32_t)(end - last) > 0) {
+      last = end;
+    }
+  }
+  return last - first;
+}
+
+int main(int argc, char **argv) {
+  bool folded = false;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--folded") == 0) {
+      folded = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == nullptr) {
+    fprintf(stderr, "usage: %s [--folded] capture.bin\n", argv[0]);
+    return 2;
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr) {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.insert(data.end(), buffer, buffer + length);
+  }
+  fclose(file);
+
+  // Keep the last good dump, count the rest
+  TraceDump dump;
+  int found = 0;
+  int corrupt = 0;
+  const size_t magicLength = strlen(TRACE_MAGIC);
+  for (size_t i = 0; i + magicLength <= data.size(); i++) {
+    if (memcmp(&data[i], TRACE_MAGIC, magicLength) != 0) {
+      continue;
+    }
+    TraceDump candidate;
+    if (ParseDump(data, i, candidate)) {
+      dump = candidate;
+      found++;
+    } else {
+      corrupt++;
+    }
+  }
+  if (found == 0) {
+    fprintf(stderr, "no loop trace dump in %s (%d corrupt)\n", path, corrupt);
+    return 1;
+  }
+
+  std::vector<FlameNode> nodes = BuildFlameTree(dump.events);
+  if (folded) {
+    PrintFolded(nodes, 0, "");
+    return 0;
+  }
+
+  uint64_t windowUs = WindowUs(dump.events);
+  printf("Loop trace: last of %d dumps (%d corrupt), taken at %.3f s\n\n", found, corrupt, dump.dumpUs / 1e6);
+  PrintSections(dump);
+  printf("\nLast %zu events, %.1f ms:\n", dump.events.size(), windowUs / 1000.0);
+  printf("%-24s %6s %11s %11s %7s\n", "section", "count", "total us", "self us", "window");
+  std::vector<int> roots = nodes[0].children;
+  std::sort(roots.begin(), roots.end(), [&](int a, int b) { return nodes[a].totalUs > nodes[b].totalUs; });
+  for (int root : roots) {
+    PrintFlameNode(nodes, root, 0, windowUs);
+  }
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+
+// --- Time ---
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+static uint64_t sleptMicros = 0;
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms) {
+  delayMicroseconds(ms * 1000);
+}
+
+void delayMicroseconds(unsigned long us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+  sleptMicros += us;
+}
+
+uint64_t SimSleptMicros() {
+  return sleptMicros;
+}
+
+// --- String ---
+
+std::string String::FormatInteger(long value, unsigned char base) {
+  if (base == DEC) {
+    return std::to_string(value);
+  }
+  return FormatUnsigned((unsigned long)value, base);
+}
+
+std::string String::FormatUnsigned(unsigned long value, unsigned char base) {
+  if (base < 2 || base > 16) {
+    base = DEC;
+  }
+  std::string out;
+  do {
+    out.insert(out.begin(), "0123456789ABCDEF"[value % base]);
+    value /= base;
+  } while (value > 0);
+  return out;
+}
+
+std::string String::FormatFloat(double value, unsigned char decimals) {
+  char buffer[48];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  return buffer;
+}
+
+void String::trim() {
+  size_t begin = 0;
+  while (begin < s.size() && isspace((unsigned char)s[begin])) begin++;
+  size_t end = s.size();
+  while (end > begin && isspace((unsigned char)s[end - 1])) end--;
+  s = s.substr(begin, end - begin);
+}
+
+void String::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const {
+  if (bufsize == 0 || buf == nullptr) {
+    return;
+  }
+  if (index >= s.size()) {
+    buf[0] = '\0';
+    return;
+  }
+  size_t n = s.size() - index;
+  if (n > bufsize - 1) {
+    n = bufsize - 1;
+  }
+  memcpy(buf, s.data() + index, n);
+  buf[n] = '\0';
+}
+
+// --- Print / Stream ---
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+int Stream::TimedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) {
+      return c;
+    }
+  } while (millis() - start < timeoutMs);
+  return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = TimedRead();
+    if (c < 0) {
+      break;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String out;
+  int c = TimedRead();
+  while (c >= 0 && c != terminator) {
+    out += (char)c;
+    c = TimedRead();
+  }
+  return out;
+}
+
+// --- Serial ports ---
+
+HardwareSerialSim Serial(true);
+HardwareSerialSim Serial1(false);
+
+size_t HardwareSerialSim::write(uint8_t b) {
+  bytesWritten++;
+  if (log) {
+    fputc(b, log);
+  }
+  if (toStdout) {
+    if (b != '\r') {
+      fputc(b, stdout);
+    }
+    return 1;
+  }
+  txQueue.push_back((char)b);
+  return 1;
+}
+
+int HardwareSerialSim::available() {
+  if (peerPump) {
+    peerPump();
+  }
+  return (int)rxQueue.size();
+}
+
+int HardwareSerialSim::read() {
+  if (rxQueue.empty() && peerPump) {
+    peerPump();
+  }
+  if (rxQueue.empty()) {
+    return -1;
+  }
+  uint8_t b = (uint8_t)rxQueue[0];
+  rxQueue.erase(0, 1);
+  return b;
+}
+
+int HardwareSerialSim::peek() {
+  if (rxQueue.empty()) {
+    return -1;
+  }
+  return (uint8_t)rxQueue[0];
+}
+
+void HardwareSerialSim::PeerWrite(const uint8_t *data, size_t length) {
+  rxQueue.append((const char *)data, length);
+}
+
+int HardwareSerialSim::PeerAvailable() const {
+  return (int)txQueue.size();
+}
+
+int HardwareSerialSim::PeerRead() {
+  if (txQueue.empty()) {
+    return -1;
+  }
+  uint8_t b = (uint8_t)txQueue[0];
+  txQueue.erase(0, 1);
+  return b;
+}
@@ -0,0 +1,211 @@
+#pragma once
+// Host stand-in for the parts of the Arduino core the ClearCore sketch uses.
+// Time is real (steady clock) so cycle times measured here are meaningful, delay() really sleeps.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <type_traits>
+
+#define PI 3.1415926535897932384626433832795
+#define HEX 16
+#define DEC 10
+
+typedef uint8_t byte;
+
+template <class T, class L, class H>
+auto constrain(T x, L low, H high) -> typename std::decay<decltype(x < low ? low : (x > high ? high : x))>::type {
+  return x < low ? low : (x > high ? high : x);
+}
+template <class A, class B>
+auto min(A a, B b) -> typename std::decay<decltype(a < b ? a : b)>::type {
+  return a < b ? a : b;
+}
+template <class A, class B>
+auto max(A a, B b) -> typename std::decay<decltype(a > b ? a : b)>::type {
+  return a > b ? a : b;
+}
+
+inline bool isPrintable(int c) {
+  return isprint(c);
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned long us);
+
+// Time spent sleeping inside delay()/Delay_ms, so the simulation can report busy time separately from cycle time
+uint64_t SimSleptMicros();
+
+// --- String ---
+
+class String {
+public:
+  String(const char *cstr = "") : s(cstr ? cstr : "") {}
+  String(const std::string &str) : s(str) {}
+  explicit String(char c) : s(1, c) {}
+  String(int value, unsigned char base = DEC) : s(FormatInteger(value, base)) {}
+  String(unsigned int value, unsigned char base = DEC) : s(FormatUnsigned(value, base)) {}
+  String(long value, unsigned char base = DEC) : s(FormatInteger(value, base)) {}
+  String(unsigned long value, unsigned char base = DEC) : s(FormatUnsigned(value, base)) {}
+  String(float value, unsigned char decimals = 2) : s(FormatFloat(value, decimals)) {}
+  String(double value, unsigned char decimals = 2) : s(FormatFloat(value, decimals)) {}
+
+  unsigned int length() const { return s.size(); }
+  const char *c_str() const { return s.c_str(); }
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+  char charAt(unsigned int index) const { return index < s.size() ? s[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  bool concat(const String &str) { s += str.s; return true; }
+  bool concat(const char *cstr) { if (cstr) s += cstr; return true; }
+  bool concat(char c) { s += c; return true; }
+  String &operator+=(const String &str) { concat(str); return *this; }
+  String &operator+=(const char *cstr) { concat(cstr); return *this; }
+  String &operator+=(char c) { concat(c); return *this; }
+
+  bool equals(const String &str) const { return s == str.s; }
+  bool operator==(const String &str) const { return s == str.s; }
+  bool operator==(const char *cstr) const { return s == (cstr ? cstr : ""); }
+  bool operator!=(const String &str) const { return s != str.s; }
+  bool operator!=(const char *cstr) const { return !(*this == cstr); }
+
+  bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool endsWith(const String &suffix) const {
+    return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return ToIndex(s.find(c, from)); }
+  int indexOf(const String &str, unsigned int from = 0) const { return ToIndex(s.find(str.s, from)); }
+  int lastIndexOf(char c) const { return ToIndex(s.rfind(c)); }
+
+  String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) { unsigned int t = from; from = to; to = t; }
+    if (from >= s.size()) return String();
+    return String(s.substr(from, to - from));
+  }
+
+  void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+  void trim();
+  void toLowerCase() { for (char &c : s) c = tolower(c); }
+  void toUpperCase() { for (char &c : s) c = toupper(c); }
+
+  long toInt() const { return atol(s.c_str()); }
+  float toFloat() const { return (float)atof(s.c_str()); }
+  double toDouble() const { return atof(s.c_str()); }
+
+  void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+
+  friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+  friend String operator+(const String &a, const char *b) { return String(a.s + (b ? b : "")); }
+  friend String operator+(const char *a, const String &b) { return String((a ? a : "") + b.s); }
+
+private:
+  std::string s;
+
+  static int ToIndex(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  static std::string FormatInteger(long value, unsigned char base);
+  static std::string FormatUnsigned(unsigned long value, unsigned char base);
+  static std::string FormatFloat(double value, unsigned char decimals);
+};
+
+// --- Print / Stream ---
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  size_t print(const String &str) { return write(str.c_str()); }
+  size_t print(const char *str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+  size_t println() { return write("\r\n"); }
+  template <class T>
+  size_t println(const T &value) { size_t n = print(value); return n + println(); }
+  template <class T>
+  size_t println(const T &value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+  String readStringUntil(char terminator);
+
+protected:
+  unsigned long timeoutMs = 1000;
+  int TimedRead();
+};
+
+// Serial (USB monitor) prints to stdout. Serial1/Serial2 are byte queues with a peer on the other end
+// (the simulated Giga in SimMain.cpp) that gets a chance to run every time the sketch looks at the port.
+class HardwareSerialSim : public Stream {
+public:
+  typedef void (*PeerPump)();
+
+  explicit HardwareSerialSim(bool toStdout) : toStdout(toStdout) {}
+
+  void begin(unsigned long baud) { baudRate = baud; }
+  void end() {}
+  // Whatever was written goes out at the current rate, the peer gets it before a begin() changes the rate
+  void flush() override {
+    if (peerPump) {
+      peerPump();
+    }
+  }
+  void ttl(bool) {}
+  unsigned long GetBaud() const { return baudRate; }
+  operator bool() const { return true; }
+
+  size_t write(uint8_t b) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  int availableForWrite() { return 64; }
+
+  // Peer side of the loopback
+  void SetPeerPump(PeerPump pump) { peerPump = pump; }
+  void PeerWrite(const uint8_t *data, size_t length);
+  int PeerAvailable() const;
+  int PeerRead();
+  uint64_t GetBytesWritten() const { return bytesWritten; }
+  // Copy of every byte the sketch writes, untouched (stdout drops the \r's)
+  void SetLog(FILE *file) { log = file; }
+
+private:
+  bool toStdout;
+  FILE *log = nullptr;
+  unsigned long baudRate = 0;
+  PeerPump peerPump = nullptr;
+  std::string rxQueue;  // peer -> sketch
+  std::string txQueue;  // sketch -> peer
+  uint64_t bytesWritten = 0;
+};
+
+extern HardwareSerialSim Serial;
+extern HardwareSerialSim Serial1;
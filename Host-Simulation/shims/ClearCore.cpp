@@ -0,0 +1,228 @@
+#include <ClearCore.h>
+
+MotorDriver ConnectorM0;
+MotorManager MotorMgr;
+
+void Delay_ms(uint32_t ms) {
+  delay(ms);
+}
+
+void MotorDriver::EnableRequest(bool enable) {
+  Update();
+  if (enable && !enabled) {
+    // The drive holds wherever the shaft is now, any windup from before is gone (and shows up as lost steps)
+    enabledAtUs = micros();
+    driveOffset = commandedPosition - axisPosition;
+    settledUs = enabledAtUs + SIM_ENABLE_DELAY_US;
+  }
+  if (!enable) {
+    MoveStopAbrupt();
+  }
+  enabled = enable;
+}
+
+MotorDriver::StatusRegMotor MotorDriver::StatusReg() {
+  Update();
+
+  StatusRegMotor status;
+  status.reg = 0;
+  status.bit.StepsActive = mode != GEN_IDLE;
+  status.bit.AtTargetPosition = mode == GEN_IDLE;
+  status.bit.MotorInFault = faulted;
+  status.bit.Enabled = enabled;
+  status.bit.AlertsPresent = faulted;
+  status.bit.HlfbState = HlfbState();
+  status.bit.Ready = enabled && !faulted;
+  return status;
+}
+
+MotorDriver::AlertRegMotor MotorDriver::AlertReg() {
+  AlertRegMotor alerts;
+  alerts.reg = 0;
+  alerts.bit.MotorFaulted = faulted;
+  alerts.bit.MotionCanceledInAlert = faulted;
+  return alerts;
+}
+
+void MotorDriver::ClearAlerts() {
+  // A real fault needs the enable cycled before it clears, same as the ClearPath
+  if (!enabled) {
+    faulted = false;
+  }
+}
+
+MotorDriver::HlfbStates MotorDriver::HlfbState() {
+  Update();
+
+  if (!enabled || faulted || micros() - enabledAtUs < SIM_ENABLE_DELAY_US) {
+    return HLFB_DEASSERTED;
+  }
+  if (mode != GEN_IDLE) {
+    return hlfbMode == HLFB_MODE_STATIC ? HLFB_DEASSERTED : HLFB_HAS_MEASUREMENT;
+  }
+  if (moveCount > 0 && settledUs == 0) {
+    // Not in position yet, in PWM mode the drive reports torque instead
+    return hlfbMode == HLFB_MODE_STATIC ? HLFB_DEASSERTED : HLFB_HAS_MEASUREMENT;
+  }
+  return HLFB_ASSERTED;
+}
+
+float MotorDriver::HlfbPercent() {
+  // Torque follows what the motor has to push into the spring, scaled so accelerating at AccelMax reads about 50%.
+  // Signed like the bipolar PWM reading.
+  Update();
+  double omega = 2 * PI * SIM_RESONANCE_HZ;
+  double torque = omega * omega * FollowingError();
+  double reference = accelMaxStepsPerSec2 > 0 ? accelMaxStepsPerSec2 : 1;
+  return (float)constrain(50.0 * torque / reference, -100.0, 100.0);
+}
+
+bool MotorDriver::Move(int32_t distance, MoveTarget moveTarget) {
+  Update();
+  if (!enabled || faulted) {
+    return false;
+  }
+
+  int32_t from = (int32_t)lround(commandedPosition);
+  positionTarget = moveTarget == MOVE_TARGET_ABSOLUTE ? distance : from + distance;
+  moveAccel = accelMaxStepsPerSec2 > 0 ? accelMaxStepsPerSec2 : 1;
+  moveVelMax = velMaxStepsPerSec > 0 ? velMaxStepsPerSec : 1;
+  if (mode == GEN_IDLE) {
+    StartMotion();
+  }
+  mode = GEN_POSITION;
+  return true;
+}
+
+bool MotorDriver::MoveVelocity(int32_t velocity) {
+  Update();
+  if (!enabled || faulted) {
+    return false;
+  }
+  if (mode == GEN_IDLE && velocity == 0) {
+    return true;
+  }
+
+  velocityTarget = velocity;
+  moveAccel = accelMaxStepsPerSec2 > 0 ? accelMaxStepsPerSec2 : 1;
+  if (mode == GEN_IDLE) {
+    StartMotion();
+  }
+  mode = GEN_VELOCITY;
+  return true;
+}
+
+bool MotorDriver::StepsComplete() {
+  Update();
+  return mode == GEN_IDLE;
+}
+
+void MotorDriver::MoveStopAbrupt() {
+  Update();
+  mode = GEN_IDLE;
+  commandedVelocity = 0;
+}
+
+void MotorDriver::PositionRefSet(int32_t newPosition) {
+  MoveStopAbrupt();
+  double offset = newPosition - commandedPosition;
+  commandedPosition += offset;
+  axisPosition += offset;
+  hardstopPosition += offset;
+}
+
+int32_t MotorDriver::PositionRefCommanded() {
+  Update();
+  return (int32_t)lround(commandedPosition);
+}
+
+int32_t MotorDriver::VelocityRefCommanded() {
+  Update();
+  return (int32_t)lround(commandedVelocity);
+}
+
+uint32_t MotorDriver::SimGetLastSettledUs() {
+  Update();
+  return settledUs;
+}
+
+void MotorDriver::StartMotion() {
+  moveCount++;
+  moveStartUs = micros();
+  settledUs = 0;
+  inPosition = false;
+}
+
+double MotorDriver::FollowingError() const {
+  return commandedPosition - driveOffset - axisPosition;
+}
+
+void MotorDriver::Update() {
+  uint32_t now = micros();
+  if (!timeStarted) {
+    lastUpdateUs = now;
+    timeStarted = true;
+  }
+  while (now - lastUpdateUs >= SIM_STEP_US) {
+    lastUpdateUs += SIM_STEP_US;
+    Step(SIM_STEP_US / 1e6);
+  }
+}
+
+void MotorDriver::Step(double dt) {
+  if (faulted && mode != GEN_IDLE) {
+    mode = GEN_IDLE;
+    commandedVelocity = 0;
+  }
+
+  // Step generator
+  double maxChange = moveAccel * dt;
+  if (mode == GEN_POSITION) {
+    double remaining = positionTarget - commandedPosition;
+    double direction = remaining >= 0 ? 1 : -1;
+    // Fastest speed we can still stop from, capped at VelMax. Following it gives the trapezoid.
+    double desired = direction * min(moveVelMax, sqrt(2 * moveAccel * fabs(remaining)));
+    commandedVelocity += constrain(desired - commandedVelocity, -maxChange, maxChange);
+
+    double next = commandedPosition + commandedVelocity * dt;
+    if ((positionTarget - next) * remaining <= 0 || (fabs(remaining) < 0.5 && fabs(commandedVelocity) <= maxChange)) {
+      commandedPosition = positionTarget;
+      commandedVelocity = 0;
+      mode = GEN_IDLE;
+    } else {
+      commandedPosition = next;
+    }
+  } else if (mode == GEN_VELOCITY) {
+    commandedVelocity += constrain(velocityTarget - commandedVelocity, -maxChange, maxChange);
+    commandedPosition += commandedVelocity * dt;
+    if (velocityTarget == 0 && commandedVelocity == 0) {
+      mode = GEN_IDLE;
+    }
+  }
+
+  // Axis on its spring
+  double omega = 2 * PI * SIM_RESONANCE_HZ;
+  // Disabled, nothing holds the axis and it just coasts down
+  double spring = enabled ? omega * omega * FollowingError() : 0;
+  axisAccel = spring - 2 * SIM_DAMPING_RATIO * omega * axisVelocity;
+  axisVelocity += axisAccel * dt;
+  axisPosition += axisVelocity * dt;
+  if (axisPosition < hardstopPosition) {
+    axisPosition = hardstopPosition;
+    axisVelocity = 0;
+  }
+  if (enabled && fabs(FollowingError()) > SIM_FOLLOWING_ERROR_LIMIT) {
+    faulted = true;
+  }
+
+  // HLFB in-position
+  bool inWindow = mode == GEN_IDLE && fabs(FollowingError()) < SIM_IN_POSITION_STEPS;
+  if (!inWindow) {
+    inPosition = false;
+  } else if (!inPosition) {
+    inPosition = true;
+    inPositionSinceUs = lastUpdateUs;
+  } else if (settledUs == 0 && lastUpdateUs - inPositionSinceUs >= SIM_IN_POSITION_US) {
+    settledUs = lastUpdateUs;
+  }
+}
@@ -0,0 +1,176 @@
+#pragma once
+// Host stand-in for the ClearCore library: a simulated step and direction servo (ClearPath-SD style) on ConnectorM0.
+// The step generator runs positional moves as trapezoids from VelMax/AccelMax and velocity moves as ramps at AccelMax,
+// like the ClearCore does. The axis behind it is a lightly damped spring-mass (a long belt), so a hard stop in
+// acceleration leaves it ringing and HLFB only asserts once the shaft has been back in position for a moment.
+// The home end of travel is a hardstop some distance behind where the axis powers up, driving into it shows up as
+// torque on HLFB (bipolar PWM mode) and eventually a following error fault.
+// Alerts can also be injected from the scenario to exercise the fault paths.
+
+#include <Arduino.h>
+
+class Connector {
+public:
+  enum ConnectorModes {
+    CPM_MODE_STEP_AND_DIR
+  };
+};
+
+class MotorDriver {
+public:
+  enum HlfbStates {
+    HLFB_DEASSERTED,
+    HLFB_ASSERTED,
+    HLFB_HAS_MEASUREMENT,
+    HLFB_UNKNOWN
+  };
+  enum HlfbModes {
+    HLFB_MODE_STATIC,
+    HLFB_MODE_HAS_PWM,
+    HLFB_MODE_HAS_BIPOLAR_PWM
+  };
+  enum HlfbCarrierFrequencies {
+    HLFB_CARRIER_45_HZ,
+    HLFB_CARRIER_482_HZ
+  };
+  enum MoveTarget {
+    MOVE_TARGET_ABSOLUTE,
+    MOVE_TARGET_REL_END_POSN
+  };
+
+  union StatusRegMotor {
+    uint32_t reg;
+    struct {
+      uint32_t AtTargetPosition : 1;
+      uint32_t StepsActive : 1;
+      uint32_t AtTargetVelocity : 1;
+      uint32_t MoveDirection : 1;
+      uint32_t MotorInFault : 1;
+      uint32_t Enabled : 1;
+      uint32_t PositionalMove : 1;
+      uint32_t HlfbState : 2;
+      uint32_t AlertsPresent : 1;
+      uint32_t Ready : 1;
+    } bit;
+  };
+
+  union AlertRegMotor {
+    uint32_t reg;
+    struct {
+      uint32_t MotionCanceledInAlert : 1;
+      uint32_t MotionCanceledPositiveLimit : 1;
+      uint32_t MotionCanceledNegativeLimit : 1;
+      uint32_t MotionCanceledSensorEStop : 1;
+      uint32_t MotionCanceledMotorDisabled : 1;
+      uint32_t MotorFaulted : 1;
+    } bit;
+  };
+
+  void HlfbMode(HlfbModes mode) { hlfbMode = mode; }
+  void HlfbCarrier(HlfbCarrierFrequencies) {}
+  void VelMax(int32_t velMax) { velMaxStepsPerSec = velMax; }
+  void AccelMax(uint32_t accelMax) { accelMaxStepsPerSec2 = accelMax; }
+
+  void EnableRequest(bool enable);
+  bool EnableRequest() const { return enabled; }
+
+  StatusRegMotor StatusReg();
+  AlertRegMotor AlertReg();
+  void ClearAlerts();
+
+  HlfbStates HlfbState();
+  float HlfbPercent();
+
+  bool Move(int32_t distance, MoveTarget moveTarget = MOVE_TARGET_REL_END_POSN);
+  bool MoveVelocity(int32_t velocity);
+  bool StepsComplete();
+  void MoveStopAbrupt();
+
+  void PositionRefSet(int32_t position);
+  int32_t PositionRefCommanded();
+  int32_t VelocityRefCommanded();
+
+  // --- Simulation hooks ---
+  void SimInjectFault() { faulted = true; }
+  // Number of times the step generator started from rest
+  uint32_t SimGetMoveCount() const { return moveCount; }
+  uint32_t SimGetLastMoveStartUs() const { return moveStartUs; }
+  // When HLFB asserted after the last move, 0 while a move is in progress or still settling
+  uint32_t SimGetLastSettledUs();
+
+  static const uint32_t SIM_ENABLE_DELAY_US = 30000;  // enable to HLFB asserted
+  static const uint32_t SIM_STEP_US = 50;             // integration step for the step generator and the axis
+  static constexpr double SIM_RESONANCE_HZ = 15.0;    // first mode of the fence on its belt
+  static constexpr double SIM_DAMPING_RATIO = 0.15;
+  static constexpr double SIM_IN_POSITION_STEPS = 2.0;
+  static const uint32_t SIM_IN_POSITION_US = 5000;  // how long the shaft must stay in the window before HLFB asserts
+  static constexpr double SIM_HARDSTOP_STEPS = -3000;           // hardstop relative to the power up position
+  static constexpr double SIM_FOLLOWING_ERROR_LIMIT = 400;      // steps of windup before the drive shuts down
+
+private:
+  enum GeneratorMode {
+    GEN_IDLE,
+    GEN_POSITION,
+    GEN_VELOCITY
+  };
+
+  HlfbModes hlfbMode = HLFB_MODE_STATIC;
+  int32_t velMaxStepsPerSec = 1000;
+  uint32_t accelMaxStepsPerSec2 = 10000;
+
+  bool enabled = false;
+  uint32_t enabledAtUs = 0;
+  bool faulted = false;
+
+  // Step generator
+  GeneratorMode mode = GEN_IDLE;
+  double commandedPosition = 0;
+  double commandedVelocity = 0;
+  double moveAccel = 0;  // AccelMax latched when the move was issued, like the ClearCore
+  double moveVelMax = 0;
+  int32_t positionTarget = 0;
+  double velocityTarget = 0;
+
+  // Axis, tracks the commanded position through the spring
+  double axisPosition = 0;
+  double axisVelocity = 0;
+  double axisAccel = 0;
+
+  double driveOffset = 0;  // commanded minus shaft position the drive latched at enable
+  double hardstopPosition = SIM_HARDSTOP_STEPS;  // moves with PositionRefSet, it's the same wall in a new frame
+
+  uint32_t lastUpdateUs = 0;
+  bool timeStarted = false;
+  uint32_t moveStartUs = 0;
+  uint32_t moveCount = 0;
+  uint32_t inPositionSinceUs = 0;
+  bool inPosition = true;
+  uint32_t settledUs = 0;
+
+  double FollowingError() const;
+  void Update();
+  void Step(double dt);
+  void StartMotion();
+};
+
+class MotorManager {
+public:
+  enum MotorClockRates {
+    CLOCK_RATE_LOW,
+    CLOCK_RATE_NORMAL,
+    CLOCK_RATE_HIGH
+  };
+  enum MotorPair {
+    MOTOR_M0M1,
+    MOTOR_M2M3,
+    MOTOR_ALL
+  };
+
+  bool MotorInputClocking(MotorClockRates) { return true; }
+  bool MotorModeSet(MotorPair, Connector::ConnectorModes) { return true; }
+};
+
+extern MotorDriver ConnectorM0;
+extern MotorManager MotorMgr;
+
+void Delay_ms(uint32_t ms);
@@ -0,0 +1,51 @@
+#include "HeapHooks.h"
+#include <stdlib.h>
+#include <new>
+
+// Each block carries its size in a header so delete can subtract it again
+
+size_t heapCurrent = 0;
+size_t heapPeak = 0;
+uint64_t heapAllocCount = 0;
+
+struct alignas(16) HeapHeader {
+  size_t size;
+};
+
+void *operator new(size_t size) {
+  HeapHeader *header = (HeapHeader *)malloc(sizeof(HeapHeader) + size);
+  if (header == nullptr) {
+    throw std::bad_alloc();
+  }
+  header->size = size;
+  heapCurrent += size;
+  if (heapCurrent > heapPeak) {
+    heapPeak = heapCurrent;
+  }
+  heapAllocCount++;
+  return header + 1;
+}
+
+// GCC pairs the malloc above with this free and warns, but they are the same block
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  HeapHeader *header = (HeapHeader *)ptr - 1;
+  heapCurrent -= header->size;
+  free(header);
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+void operator delete[](void *ptr) noexcept {
+  operator delete(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+void operator delete[](void *ptr, size_t) noexcept {
+  operator delete(ptr);
+}
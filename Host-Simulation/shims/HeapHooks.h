@@ -0,0 +1,10 @@
+#pragma once
+// Heap accounting shared by the host builds. Every allocation the firmware makes (new, String, ArduinoJson, ...) goes
+// through the operator new/delete in HeapHooks.cpp, which keep these up to date.
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern size_t heapCurrent;
+extern size_t heapPeak;  // highest heapCurrent so far, callers may lower it to start a new window
+extern uint64_t heapAllocCount;
@@ -0,0 +1,121 @@
+#include <SD.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SDClass SD;
+
+// --- File ---
+
+size_t File::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!handle) {
+    return 0;
+  }
+  return fwrite(buffer, 1, size, handle);
+}
+
+int File::available() {
+  if (!handle) {
+    return 0;
+  }
+  return (int)(size() - position());
+}
+
+int File::read() {
+  if (!handle) {
+    return -1;
+  }
+  int c = fgetc(handle);
+  return c == EOF ? -1 : c;
+}
+
+int File::read(void *buffer, size_t length) {
+  if (!handle) {
+    return -1;
+  }
+  return (int)fread(buffer, 1, length, handle);
+}
+
+int File::peek() {
+  int c = read();
+  if (c >= 0) {
+    ungetc(c, handle);
+  }
+  return c;
+}
+
+void File::flush() {
+  if (handle) {
+    fflush(handle);
+  }
+}
+
+bool File::seek(uint32_t pos) {
+  return handle && fseek(handle, pos, SEEK_SET) == 0;
+}
+
+uint32_t File::position() {
+  return handle ? (uint32_t)ftell(handle) : 0;
+}
+
+uint32_t File::size() {
+  if (!handle) {
+    return 0;
+  }
+  long current = ftell(handle);
+  fseek(handle, 0, SEEK_END);
+  long end = ftell(handle);
+  fseek(handle, current, SEEK_SET);
+  return (uint32_t)end;
+}
+
+void File::close() {
+  if (handle) {
+    fclose(handle);
+    handle = nullptr;
+  }
+}
+
+// --- SDClass ---
+
+bool SDClass::begin(uint8_t) {
+  const char *dir = getenv("SIM_SD_DIR");
+  root = dir ? dir : "sd";
+
+  struct stat info;
+  if (stat(root.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+    fprintf(stderr, "[sim] SD directory '%s' not found\n", root.c_str());
+    return false;
+  }
+  return true;
+}
+
+String SDClass::HostPath(const char *path) const {
+  if (path[0] == '/') {
+    return root + path;
+  }
+  return root + "/" + path;
+}
+
+File SDClass::open(const char *path, uint8_t mode) {
+  String hostPath = HostPath(path);
+  FILE *handle = nullptr;
+
+  if (mode == FILE_WRITE) {
+    handle = fopen(hostPath.c_str(), "a+b");
+  } else {
+    handle = fopen(hostPath.c_str(), "rb");
+  }
+  return File(handle, path);
+}
+
+bool SDClass::exists(const char *path) {
+  return access(HostPath(path).c_str(), F_OK) == 0;
+}
+
+bool SDClass::remove(const char *path) {
+  return ::remove(HostPath(path).c_str()) == 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+// Host stand-in for the SD library, backed by a directory on disk (Host-Simulation/sd by default, SIM_SD_DIR to override).
+// Like the Arduino SD library, FILE_WRITE opens for read/write, creates the file and appends.
+
+#include <Arduino.h>
+
+#define FILE_READ 0x01
+#define FILE_WRITE 0x13
+
+class File : public Stream {
+public:
+  File() {}
+  File(FILE *handle, const char *name) : handle(handle), fileName(name) {}
+
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int read(void *buffer, size_t length);
+  int peek() override;
+  void flush() override;
+
+  bool seek(uint32_t position);
+  uint32_t position();
+  uint32_t size();
+  void close();
+  const char *name() const { return fileName.c_str(); }
+
+  operator bool() const { return handle != nullptr; }
+
+private:
+  FILE *handle = nullptr;
+  String fileName;
+};
+
+class SDClass {
+public:
+  bool begin(uint8_t csPin = 0);
+  File open(const char *path, uint8_t mode = FILE_READ);
+  bool exists(const char *path);
+  bool remove(const char *path);
+
+private:
+  String root;
+  String HostPath(const char *path) const;
+};
+
+extern SDClass SD;
@@ -0,0 +1,2 @@
+#pragma once
+// The ClearCore sketch includes the 4D Systems library but the Giga build doesn't use any of it.
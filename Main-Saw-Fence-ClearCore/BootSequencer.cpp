@@ -0,0 +1,117 @@
+#include <Arduino.h>
+#include "BootSequencer.h"
+
+int BootSequencer::AddStep(const char *name, StepStartFn start, StepPollFn poll, uint32_t timeoutMs, uint8_t dependsMask) {
+  if (stepCount >= MAX_STEPS) {
+    Serial.println("BootSequencer: too many steps");
+    return -1;
+  }
+
+  Step &step = steps[stepCount];
+  step.name = name;
+  step.start = start;
+  step.poll = poll;
+  step.timeoutMs = timeoutMs;
+  step.dependsMask = dependsMask;
+  step.status = STEP_WAITING;
+  step.startMs = 0;
+  step.endMs = 0;
+  return stepCount++;
+}
+
+bool BootSequencer::IsFinished(const Step &step) const {
+  return step.status == STEP_DONE || step.status == STEP_FAILED || step.status == STEP_TIMED_OUT;
+}
+
+void BootSequencer::Finish(Step &step, StepStatus status) {
+  step.status = status;
+  step.endMs = millis();
+}
+
+bool BootSequencer::Run() {
+  bootStartMs = millis();
+
+  bool allFinished = false;
+  while (!allFinished) {
+    allFinished = true;
+
+    for (uint8_t i = 0; i < stepCount; i++) {
+      Step &step = steps[i];
+
+      if (step.status == STEP_WAITING) {
+        // Dependencies only need to have finished, a timed out screen shouldn't stop the motor from coming up
+        bool ready = true;
+        for (uint8_t d = 0; d < stepCount; d++) {
+          if ((step.dependsMask & (1 << d)) && !IsFinished(steps[d])) {
+            ready = false;
+            break;
+          }
+        }
+        if (!ready) {
+          allFinished = false;
+          continue;
+        }
+
+        step.status = STEP_RUNNING;
+        step.startMs = millis();
+        if (step.start != nullptr && !step.start()) {
+          Finish(step, STEP_FAILED);
+        } else if (step.poll == nullptr) {
+          Finish(step, STEP_DONE);
+        }
+      }
+
+      if (step.status == STEP_RUNNING) {
+        StepStatus status = step.poll();
+        if (status != STEP_RUNNING) {
+          Finish(step, status);
+        } else if (step.timeoutMs > 0 && millis() - step.startMs >= step.timeoutMs) {
+          Finish(step, STEP_TIMED_OUT);
+        } else {
+          allFinished = false;
+        }
+      }
+    }
+  }
+
+  bootEndMs = millis();
+
+  for (uint8_t i = 0; i < stepCount; i++) {
+    if (steps[i].status != STEP_DONE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BootSequencer::StepStatus BootSequencer::GetStatus(int id) const {
+  if (id < 0 || id >= stepCount) {
+    return STEP_FAILED;
+  }
+  return steps[id].status;
+}
+
+void BootSequencer::PrintTrace() const {
+  static const char *statusNames[] = { "waiting", "running", "ok", "FAILED", "TIMED OUT" };
+
+  Serial.println();
+  Serial.println("=== BOOT TRACE (ms since sequencer start) ===");
+  for (uint8_t i = 0; i < stepCount; i++) {
+    const Step &step = steps[i];
+    Serial.print(step.name);
+    Serial.print(": start ");
+    Serial.print(step.startMs - bootStartMs);
+    Serial.print(", end ");
+    Serial.print(step.endMs - bootStartMs);
+    Serial.print(", took ");
+    Serial.print(step.endMs - step.startMs);
+    Serial.print(" ");
+    Serial.println(statusNames[step.status]);
+  }
+  Serial.print("Total: ");
+  Serial.print(bootEndMs - bootStartMs);
+  Serial.print(" ms (");
+  Serial.print(bootEndMs);
+  Serial.println(" ms since power on)");
+  Serial.println();
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+// Runs the startup steps as soon as their dependencies are ready instead of through fixed delays.
+// Steps with a poll function (screen handshake, serial monitor) run side by side with the others until they report
+// ready or hit their timeout. Every step's start/end time is kept so setup() can print where the boot time went.
+class BootSequencer {
+public:
+  enum StepStatus {
+    STEP_WAITING,
+    STEP_RUNNING,
+    STEP_DONE,
+    STEP_FAILED,
+    STEP_TIMED_OUT
+  };
+
+  typedef bool (*StepStartFn)();        // Returns false if the step failed outright
+  typedef StepStatus (*StepPollFn)();  // STEP_RUNNING until ready; nullptr means the step is done once started
+
+  static const uint8_t MAX_STEPS = 8;
+
+  // Returns the step id, use (1 << id) to build the dependency mask of later steps
+  int AddStep(const char *name, StepStartFn start, StepPollFn poll = nullptr, uint32_t timeoutMs = 0, uint8_t dependsMask = 0);
+
+  // Blocks until every step has finished one way or another. Returns false if any step failed or timed out.
+  bool Run();
+
+  StepStatus GetStatus(int id) const;
+  void PrintTrace() const;
+
+private:
+  struct Step {
+    const char *name;
+    StepStartFn start;
+    StepPollFn poll;
+    uint32_t timeoutMs;
+    uint8_t dependsMask;
+    StepStatus status;
+    uint32_t startMs;
+    uint32_t endMs;
+  };
+
+  Step steps[MAX_STEPS];
+  uint8_t stepCount = 0;
+  uint32_t bootStartMs = 0;
+  uint32_t bootEndMs = 0;
+
+  bool IsFinished(const Step &step) const;
+  void Finish(Step &step, StepStatus status);
+};
@@ -0,0 +1,169 @@
+#include <Arduino.h>
+#include "CutListClasses.h"
+#include "Utils.h"
+
+bool CutList::AddJob(float length, UnitType unit, int quantity, int remaining) {
+  if (jobCount >= MAX_JOBS || length < 0 || quantity <= 0) {
+    return false;
+  }
+
+  CutJob &job = jobs[jobCount++];
+  job.length = length;
+  job.unit = unit;
+  job.quantity = quantity;
+  job.remaining = constrain(remaining, 0, quantity);
+
+  nextCutPrepared = false;
+  return true;
+}
+
+void CutList::Clear() {
+  jobCount = 0;
+  nextCutPrepared = false;
+  atCut = false;
+}
+
+int CutList::GetJobCount() const {
+  return jobCount;
+}
+
+const CutJob &CutList::GetJob(int index) const {
+  return jobs[index];
+}
+
+int CutList::GetRemainingCuts() const {
+  int total = 0;
+  for (int i = 0; i < jobCount; i++) {
+    total += jobs[i].remaining;
+  }
+  return total;
+}
+
+bool CutList::HasPendingCuts() const {
+  return FindNextJobIndex() >= 0;
+}
+
+int CutList::FindNextJobIndex() const {
+  for (int i = 0; i < jobCount; i++) {
+    if (jobs[i].remaining > 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// The job that is next once the part at the current cut is counted
+int CutList::FindJobAfterCut() const {
+  int index = FindNextJobIndex();
+  if (!atCut || index < 0 || jobs[index].remaining > 1) {
+    return index;
+  }
+  for (int i = index + 1; i < jobCount; i++) {
+    if (jobs[i].remaining > 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void CutList::SortForMinimalTravel(float currentPositionInches) {
+  // Finished jobs go to the back, pending jobs are sorted by position (insertion sort, the list is tiny)
+  for (int i = 1; i < jobCount; i++) {
+    CutJob key = jobs[i];
+    float keyPos = convertToInches(key.length, key.unit);
+    int j = i - 1;
+    while (j >= 0) {
+      bool keyDone = key.remaining == 0;
+      bool otherDone = jobs[j].remaining == 0;
+      bool shift = (!keyDone && otherDone) || (keyDone == otherDone && convertToInches(jobs[j].length, jobs[j].unit) > keyPos);
+      if (!shift) break;
+      jobs[j + 1] = jobs[j];
+      j--;
+    }
+    jobs[j + 1] = key;
+  }
+  atCut = false;
+
+  int pending = 0;
+  while (pending < jobCount && jobs[pending].remaining > 0) {
+    pending++;
+  }
+  if (pending < 2) {
+    nextCutPrepared = false;
+    return;
+  }
+
+  // On a line the shortest route through every point is: go to the nearer end first, then sweep to the other end
+  float nearPos = convertToInches(jobs[0].length, jobs[0].unit);
+  float farPos = convertToInches(jobs[pending - 1].length, jobs[pending - 1].unit);
+  if (fabs(currentPositionInches - farPos) < fabs(currentPositionInches - nearPos)) {
+    for (int i = 0, j = pending - 1; i < j; i++, j--) {
+      CutJob tmp = jobs[i];
+      jobs[i] = jobs[j];
+      jobs[j] = tmp;
+    }
+  }
+
+  nextCutPrepared = false;
+}
+
+bool CutList::PrepareNextCut(const MechanismKinematics &kinematics) {
+  preparedJobIndex = FindJobAfterCut();
+  if (preparedJobIndex < 0) {
+    nextCutPrepared = false;
+    return false;
+  }
+
+  const CutJob &job = jobs[preparedJobIndex];
+  preparedTargetSteps = kinematics.TargetToSteps(job.length, job.unit);
+  nextCutPrepared = true;
+  return true;
+}
+
+bool CutList::IsNextCutPrepared() const {
+  return nextCutPrepared;
+}
+
+int32_t CutList::GetPreparedTargetSteps() const {
+  return preparedTargetSteps;
+}
+
+const CutJob *CutList::GetPreparedJob() const {
+  return nextCutPrepared ? &jobs[preparedJobIndex] : nullptr;
+}
+
+const CutJob *CutList::GetNextJob() const {
+  int index = FindNextJobIndex();
+  if (index < 0) {
+    return nullptr;
+  }
+  return &jobs[index];
+}
+
+void CutList::ArriveAtCut(int32_t steps) {
+  atCut = FindNextJobIndex() >= 0;
+  atCutSteps = steps;
+  nextCutPrepared = false;
+}
+
+bool CutList::IsAtCut() const {
+  return atCut;
+}
+
+bool CutList::CompleteCut(int32_t currentSteps) {
+  if (!atCut) {
+    return false;
+  }
+  atCut = false;
+
+  if (currentSteps != atCutSteps) {
+    // The fence was moved off the cut (jog, homing, a fault), the part isn't counted and the target prepared on
+    // arrival assumed it would be
+    nextCutPrepared = false;
+    return false;
+  }
+
+  // The prepared target already points past this part, it stays valid
+  jobs[FindNextJobIndex()].remaining--;
+  return true;
+}
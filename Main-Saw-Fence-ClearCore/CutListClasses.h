@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+#include "Utils.h"
+#include "MechanismClasses.h"
+
+// One line of a cut list: cut `quantity` parts at `length`. `remaining` counts down as cuts are made so a list can be resumed after a reboot.
+struct CutJob {
+  float length = 0.0f;
+  UnitType unit = UnitType::UNIT_UNKNOWN;
+  int quantity = 0;
+  int remaining = 0;
+};
+
+// Ordered queue of cut jobs. The next target is computed as soon as the fence arrives at a cut so it is ready while the saw is cutting,
+// but the part is only counted once the next cut is asked for, so an abandoned cut is never recorded as done.
+class CutList {
+public:
+  static const int MAX_JOBS = 32;
+
+  bool AddJob(float length, UnitType unit, int quantity, int remaining);
+  void Clear();
+
+  int GetJobCount() const;
+  const CutJob &GetJob(int index) const;
+  int GetRemainingCuts() const;
+  bool HasPendingCuts() const;
+
+  // Orders the pending jobs so the fence sweeps once from its current position to the far end (fewest direction changes, least total travel)
+  void SortForMinimalTravel(float currentPositionInches);
+
+  // Precomputes the step target for the next pending cut, the one after the cut the fence is at if it is at one.
+  // Returns false if nothing is pending.
+  bool PrepareNextCut(const MechanismKinematics &kinematics);
+  bool IsNextCutPrepared() const;
+  int32_t GetPreparedTargetSteps() const;
+  const CutJob *GetPreparedJob() const;
+  const CutJob *GetNextJob() const;
+
+  // The fence finished its move to the next pending job's target and is at `steps`
+  void ArriveAtCut(int32_t steps);
+  bool IsAtCut() const;
+  // Counts one part of the job the fence is at, if it is still where it arrived. Either way the fence is no longer
+  // at a cut afterwards. Returns true if a part was counted.
+  bool CompleteCut(int32_t currentSteps);
+
+private:
+  CutJob jobs[MAX_JOBS];
+  int jobCount = 0;
+
+  bool nextCutPrepared = false;
+  int32_t preparedTargetSteps = 0;
+  int preparedJobIndex = -1;
+
+  bool atCut = false;
+  int32_t atCutSteps = 0;
+
+  int FindNextJobIndex() const;
+  int FindJobAfterCut() const;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+
+// Bounded single producer / single consumer ring, no locks. One side only ever calls Push, the other only Peek and
+// Pop, so each index has a single writer and the queue stays safe even if the producer is later moved into an ISR.
+// Capacity has to be a power of two (the indexes just count up and wrap) and at most 128 so the count fits a uint8_t.
+template <typename T, uint8_t Capacity>
+class SpscQueue {
+  static_assert(Capacity > 0 && Capacity <= 128 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two up to 128");
+
+public:
+  // Producer. Returns false (and drops the item) when full.
+  bool Push(const T &item) {
+    uint8_t writeIndex = head;
+    if ((uint8_t)(writeIndex - tail) == Capacity) {
+      return false;
+    }
+    items[writeIndex & (Capacity - 1)] = item;
+    __sync_synchronize();  // the item has to be in place before the consumer can see the new head
+    head = writeIndex + 1;
+    return true;
+  }
+
+  // Consumer
+  uint8_t Count() const { return (uint8_t)(head - tail); }
+  bool IsEmpty() const { return head == tail; }
+  // offset 0 is the oldest item, only valid below Count()
+  const T &Peek(uint8_t offset = 0) const { return items[(uint8_t)(tail + offset) & (Capacity - 1)]; }
+  void Pop() {
+    __sync_synchronize();  // done reading the slot before handing it back to the producer
+    tail = tail + 1;
+  }
+
+private:
+  T items[Capacity];
+  volatile uint8_t head = 0;  // written by the producer only
+  volatile uint8_t tail = 0;  // written by the consumer only
+};
@@ -0,0 +1,273 @@
+#include <Arduino.h>
+#include "LinkNegotiator.h"
+
+void LinkNegotiator::Start(FrameWriter &frameWriter, const FrameParser &frameParser, uint32_t currentBaud, uint32_t maxRate, bool benchmark) {
+  writer = &frameWriter;
+  parser = &frameParser;
+  baud = currentBaud;
+  maxBaud = maxRate;
+  memset(results, 0, sizeof(results));
+
+  // Benchmarks go all the way down first, proposing the rate already in use is fine too
+  uint8_t first = 0;
+  while (!benchmark && first < LINK_BAUD_RATE_COUNT && LINK_BAUD_RATES[first] <= currentBaud) {
+    first++;
+  }
+  if (first >= LINK_BAUD_RATE_COUNT || LINK_BAUD_RATES[first] > maxBaud) {
+    SetState(LINK_IDLE);
+    return;
+  }
+
+  Serial.print("Negotiating screen link speed, up to ");
+  Serial.print(maxBaud);
+  Serial.println(" baud");
+  StartTrial(first);
+}
+
+void LinkNegotiator::SetState(LinkState next) {
+  state = next;
+  stateStartMs = millis();
+}
+
+void LinkNegotiator::Finish() {
+  SetState(LINK_IDLE);
+  Serial.print("Screen link running at ");
+  Serial.print(baud);
+  Serial.println(" baud");
+}
+
+void LinkNegotiator::SwitchBaud(uint32_t rate) {
+  Serial1.flush();
+  Serial1.begin(rate);
+  Serial1.ttl(true);
+}
+
+void LinkNegotiator::StartTrial(uint8_t index) {
+  trialIndex = index;
+  results[index].tested = true;
+
+  uint8_t payload[4];
+  FramePutI32(payload, (int32_t)LINK_BAUD_RATES[index]);
+  writer->Send(Serial1, FRAME_LINK_PROPOSE, payload, sizeof(payload));
+  SetState(LINK_PROPOSED);
+}
+
+void LinkNegotiator::FillPattern(uint8_t index, uint8_t *out) {
+  // The bytes a marginal link gets wrong first (all zeros, all ones, alternating bits, our own SOF), then noise
+  out[0] = index;
+  out[1] = 0x00;
+  out[2] = 0xFF;
+  out[3] = 0x55;
+  out[4] = 0xAA;
+  out[5] = FRAME_SOF;
+  uint16_t lfsr = 0xACE1 ^ (index * 0x1D);
+  for (uint8_t i = 6; i < ECHO_LENGTH; i++) {
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+    out[i] = lfsr & 0xFF;
+  }
+}
+
+void LinkNegotiator::SendEcho() {
+  uint8_t pattern[ECHO_LENGTH];
+  FillPattern(echoIndex, pattern);
+  echoSentUs = micros();
+  writer->Send(Serial1, FRAME_LINK_ECHO, pattern, ECHO_LENGTH);
+}
+
+void LinkNegotiator::NextEcho() {
+  echoIndex++;
+  if (echoIndex < ECHO_COUNT) {
+    SendEcho();
+    return;
+  }
+
+  RateResult &result = results[trialIndex];
+  result.errors += parser->GetCrcErrors() - crcErrorsAtStart;
+  if (result.errors > 0) {
+    EndTrial(false);
+    return;
+  }
+
+  commitAttempts = 0;
+  SendCommit(LINK_BAUD_RATES[trialIndex]);
+  SetState(LINK_COMMITTING);
+}
+
+void LinkNegotiator::SendCommit(uint32_t rate) {
+  uint8_t payload[4];
+  FramePutI32(payload, (int32_t)rate);
+  writer->Send(Serial1, FRAME_LINK_COMMIT, payload, sizeof(payload));
+  commitAttempts++;
+}
+
+void LinkNegotiator::EndTrial(bool clean) {
+  results[trialIndex].clean = clean;
+
+  if (clean) {
+    baud = LINK_BAUD_RATES[trialIndex];
+    uint8_t next = trialIndex + 1;
+    if (next < LINK_BAUD_RATE_COUNT && LINK_BAUD_RATES[next] <= maxBaud) {
+      StartTrial(next);
+    } else {
+      Finish();
+    }
+    return;
+  }
+
+  if (state == LINK_COMMITTING) {
+    // The Giga may have committed with only its answers lost, then no trial timeout brings it back. Propose the last
+    // good rate while it still listens on the trial one and commit that rate once both ends are there.
+    uint8_t payload[4];
+    FramePutI32(payload, (int32_t)baud);
+    writer->Send(Serial1, FRAME_LINK_PROPOSE, payload, sizeof(payload));
+    SwitchBaud(baud);
+    switchMs = millis();
+    commitAttempts = 0;
+    SetState(LINK_RETURNING);
+    return;
+  }
+
+  // Back to the last good rate. The Giga may have switched even if we never saw its accept, so give it time to
+  // come back too before anything else is sent.
+  SwitchBaud(baud);
+  if (state == LINK_PROPOSED) {
+    switchMs = millis();
+  }
+  SetState(LINK_REVERTING);
+}
+
+bool LinkNegotiator::Poll() {
+  uint32_t elapsed = millis() - stateStartMs;
+
+  switch (state) {
+    case LINK_IDLE:
+      return false;
+
+    case LINK_PROPOSED:
+      if (elapsed >= ACCEPT_TIMEOUT_MS) {
+        EndTrial(false);
+      }
+      break;
+
+    case LINK_COMMITTING:
+      // The Giga answers COMMIT again once it has committed, so only the answer may have been lost
+      if (elapsed >= ACCEPT_TIMEOUT_MS) {
+        if (commitAttempts < COMMIT_ATTEMPTS) {
+          SendCommit(LINK_BAUD_RATES[trialIndex]);
+          SetState(LINK_COMMITTING);
+        } else {
+          EndTrial(false);
+        }
+      }
+      break;
+
+    case LINK_RETURNING:
+      if (elapsed >= (commitAttempts == 0 ? SETTLE_MS : ACCEPT_TIMEOUT_MS)) {
+        if (commitAttempts < COMMIT_ATTEMPTS) {
+          SendCommit(baud);
+          SetState(LINK_RETURNING);
+        } else {
+          SetState(LINK_REVERTING);  // the Giga never heard the proposal, its trial timeout or garbage fallback brings it
+        }
+      }
+      break;
+
+    case LINK_SETTLING:
+      if (elapsed >= SETTLE_MS) {
+        crcErrorsAtStart = parser->GetCrcErrors();
+        echoIndex = 0;
+        SetState(LINK_ECHO);
+        SendEcho();
+      }
+      break;
+
+    case LINK_ECHO:
+      if ((micros() - echoSentUs) / 1000 >= echoTimeoutMs) {
+        results[trialIndex].errors++;
+        NextEcho();
+      }
+      break;
+
+    case LINK_REVERTING:
+      if (millis() - switchMs >= LINK_TRIAL_TIMEOUT_MS + SETTLE_MS) {
+        Finish();
+      }
+      break;
+  }
+  return state != LINK_IDLE;
+}
+
+bool LinkNegotiator::HandleFrame(const Frame &frame) {
+  if (frame.type != FRAME_LINK_ACCEPT && frame.type != FRAME_LINK_ECHO_REPLY && frame.type != FRAME_LINK_COMMITTED) {
+    return false;
+  }
+  uint32_t trialBaud = LINK_BAUD_RATES[trialIndex];
+
+  if (frame.type == FRAME_LINK_ACCEPT && state == LINK_PROPOSED && frame.length >= 4
+      && (uint32_t)FrameGetI32(frame.payload) == trialBaud) {
+    SwitchBaud(trialBaud);
+    switchMs = millis();
+    // An echo is two frames on the wire, the timeout grows with them on the slow rates
+    echoTimeoutMs = ECHO_TIMEOUT_MS + 2 * (ECHO_LENGTH + FRAME_OVERHEAD) * 10 * 1000 / trialBaud;
+    SetState(LINK_SETTLING);
+  } else if (frame.type == FRAME_LINK_ECHO_REPLY && state == LINK_ECHO) {
+    if (frame.length == 0 || frame.payload[0] != echoIndex) {
+      return true;  // late reply to an echo that already timed out
+    }
+
+    RateResult &result = results[trialIndex];
+    uint8_t pattern[ECHO_LENGTH];
+    FillPattern(echoIndex, pattern);
+    if (frame.length == ECHO_LENGTH && memcmp(frame.payload, pattern, ECHO_LENGTH) == 0) {
+      uint32_t rttUs = micros() - echoSentUs;
+      result.echoesOk++;
+      result.totalRttUs += rttUs;
+      result.maxRttUs = max(result.maxRttUs, rttUs);
+    } else {
+      result.errors++;
+    }
+    NextEcho();
+  } else if (frame.type == FRAME_LINK_COMMITTED && state == LINK_COMMITTING && frame.length >= 4
+             && (uint32_t)FrameGetI32(frame.payload) == trialBaud) {
+    EndTrial(true);
+  } else if (frame.type == FRAME_LINK_COMMITTED && state == LINK_RETURNING && frame.length >= 4
+             && (uint32_t)FrameGetI32(frame.payload) == baud) {
+    Finish();
+  }
+  return true;
+}
+
+void LinkNegotiator::PrintResults() const {
+  Serial.println();
+  Serial.println("=== SCREEN LINK (round trip of a 48 byte echo) ===");
+  for (uint8_t i = 0; i < LINK_BAUD_RATE_COUNT; i++) {
+    const RateResult &result = results[i];
+    if (!result.tested) {
+      continue;
+    }
+    Serial.print(LINK_BAUD_RATES[i]);
+    Serial.print(" baud: ");
+    Serial.print(result.clean ? "clean" : "FAILED");
+    Serial.print(", ");
+    Serial.print(result.echoesOk);
+    Serial.print("/");
+    Serial.print(ECHO_COUNT);
+    Serial.print(" echoes, ");
+    Serial.print(result.errors);
+    Serial.print(" errors");
+    if (result.echoesOk > 0) {
+      // Both directions carry the pattern, so each round trip moves two payloads
+      uint32_t bytesPerSecond = (uint32_t)((uint64_t)result.echoesOk * ECHO_LENGTH * 2 * 1000000 / max(result.totalRttUs, (uint32_t)1));
+      Serial.print(", rtt avg ");
+      Serial.print(result.totalRttUs / result.echoesOk);
+      Serial.print(" us max ");
+      Serial.print(result.maxRttUs);
+      Serial.print(" us, ");
+      Serial.print(bytesPerSecond);
+      Serial.print(" B/s (");
+      Serial.print(bytesPerSecond * 100 / (LINK_BAUD_RATES[i] / 10));
+      Serial.print("% of the wire)");
+    }
+    Serial.println();
+  }
+}
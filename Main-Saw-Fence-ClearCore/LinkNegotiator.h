@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+#include "FrameProtocol.h"
+
+// Steps the Giga link up from the base rate after a binary handshake, through LINK_BAUD_RATES. Each rate is proposed
+// at the current one, the Giga accepts and both ends switch, then ECHO_COUNT test patterns have to come back intact
+// before the rate is committed. The first rate that fails ends it and the link stays on the last clean one.
+// Benchmark mode starts from the bottom of the list instead, so PrintResults has round trip numbers for every rate.
+// Non-blocking: Poll() it from the connect/periodic path and hand it every frame that comes in.
+class LinkNegotiator {
+public:
+  static const uint8_t ECHO_COUNT = 8;
+  static const uint8_t ECHO_LENGTH = 48;
+  static const uint32_t ACCEPT_TIMEOUT_MS = 200;
+  static const uint8_t COMMIT_ATTEMPTS = 3;     // a lost COMMITTED must not leave the Giga on the new rate alone
+  static const uint32_t SETTLE_MS = 20;         // both UARTs coming up at the new rate
+  static const uint32_t ECHO_TIMEOUT_MS = 60;   // plus wire time, the Giga only looks at its port every ~10 ms
+
+  void Start(FrameWriter &writer, const FrameParser &parser, uint32_t currentBaud, uint32_t maxBaud, bool benchmark);
+  // Returns false once it is done
+  bool Poll();
+  // True if the frame belonged to the negotiation
+  bool HandleFrame(const Frame &frame);
+
+  bool IsRunning() const { return state != LINK_IDLE; }
+  uint32_t GetBaud() const { return baud; }
+  void PrintResults() const;
+
+private:
+  enum LinkState {
+    LINK_IDLE,
+    LINK_PROPOSED,
+    LINK_SETTLING,
+    LINK_ECHO,
+    LINK_COMMITTING,
+    LINK_RETURNING,  // every COMMITTED got lost, took the Giga back with us and committing the old rate
+    LINK_REVERTING   // waiting out the Giga's trial timeout after a failure
+  };
+
+  struct RateResult {
+    bool tested;
+    bool clean;
+    uint8_t echoesOk;
+    uint8_t errors;  // timeouts, mismatched echoes and CRC errors
+    uint32_t totalRttUs;
+    uint32_t maxRttUs;
+  };
+
+  FrameWriter *writer = nullptr;
+  const FrameParser *parser = nullptr;
+  LinkState state = LINK_IDLE;
+  uint32_t baud = 0;  // last rate both ends agreed on
+  uint32_t maxBaud = 0;
+  uint8_t trialIndex = 0;
+  uint32_t stateStartMs = 0;
+  uint32_t switchMs = 0;  // when the trial rate was switched to, the Giga's trial timeout runs from about then
+  uint8_t echoIndex = 0;
+  uint32_t echoSentUs = 0;
+  uint32_t echoTimeoutMs = 0;
+  uint32_t crcErrorsAtStart = 0;
+  uint8_t commitAttempts = 0;
+  RateResult results[LINK_BAUD_RATE_COUNT];
+
+  void SetState(LinkState next);
+  void StartTrial(uint8_t index);
+  void SendEcho();
+  void NextEcho();
+  void SendCommit(uint32_t rate);
+  void EndTrial(bool clean);
+  void Finish();
+  void SwitchBaud(uint32_t rate);
+  static void FillPattern(uint8_t index, uint8_t *out);
+};
@@ -0,0 +1,137 @@
+#include <Arduino.h>
+#include "LoopTrace.h"
+#include "FrameProtocol.h"
+
+LoopTrace loopTrace;
+
+void LoopTrace::Record(TRACE_SECTION section, uint32_t startUs, uint32_t durationUs, uint8_t depth) {
+  Histogram &histogram = histograms[section];
+  if (histogram.count == 0 || durationUs < histogram.minUs) {
+    histogram.minUs = durationUs;
+  }
+  if (durationUs > histogram.maxUs) {
+    histogram.maxUs = durationUs;
+  }
+  histogram.count++;
+  histogram.totalUs += durationUs;
+  histogram.buckets[TraceBucket(durationUs)]++;
+
+  // Cycles overlap everything else, they would only double up the flame summary
+  if (section == TRACE_CYCLE) {
+    return;
+  }
+
+  Event &event = ring[ringNext];
+  event.startUs = startUs;
+  event.durationUs = durationUs;
+  event.section = section;
+  event.depth = depth;
+  ringNext = (ringNext + 1) % TRACE_RING_SIZE;
+  if (ringCount < TRACE_RING_SIZE) {
+    ringCount++;
+  }
+}
+
+void LoopTrace::MarkCycle() {
+  uint32_t now = micros();
+  if (hasCycleStart) {
+    Record(TRACE_CYCLE, cycleStartUs, now - cycleStartUs, 0);
+  }
+  cycleStartUs = now;
+  hasCycleStart = true;
+}
+
+void LoopTrace::Clear() {
+  memset(histograms, 0, sizeof(histograms));
+  ringNext = 0;
+  ringCount = 0;
+  hasCycleStart = false;
+}
+
+void LoopTrace::HandleRequest(int c) {
+  if (c == TRACE_DUMP_REQUEST) {
+    Dump(Serial);
+    // The dump itself would show up as one huge cycle
+    hasCycleStart = false;
+  } else if (c == TRACE_CLEAR_REQUEST) {
+    Clear();
+    Serial.println("Loop trace cleared.");
+  }
+}
+
+// Writes little endian values and keeps the running CRC
+class TraceWriter {
+public:
+  explicit TraceWriter(Stream &port) : port(port) {}
+
+  void U8(uint8_t value) {
+    port.write(value);
+    crc = FrameCrc16(crc, value);
+  }
+  void U16(uint16_t value) {
+    U8(value & 0xFF);
+    U8(value >> 8);
+  }
+  void U32(uint32_t value) {
+    U16(value & 0xFFFF);
+    U16(value >> 16);
+  }
+  void U64(uint64_t value) {
+    U32((uint32_t)value);
+    U32((uint32_t)(value >> 32));
+  }
+  void Crc() {
+    uint16_t value = crc;
+    port.write(value & 0xFF);
+    port.write(value >> 8);
+  }
+
+private:
+  Stream &port;
+  uint16_t crc = 0xFFFF;
+};
+
+void LoopTrace::Dump(Stream &port) const {
+  port.write((const uint8_t *)TRACE_MAGIC, 4);
+
+  TraceWriter writer(port);
+  writer.U8(TRACE_FORMAT_VERSION);
+  writer.U8(TRACE_SECTION_COUNT);
+  writer.U16(ringCount);
+  writer.U32(micros());
+
+  for (uint8_t i = 0; i < TRACE_SECTION_COUNT; i++) {
+    const Histogram &histogram = histograms[i];
+    writer.U32(histogram.count);
+    writer.U64(histogram.totalUs);
+    writer.U32(histogram.minUs);
+    writer.U32(histogram.maxUs);
+
+    // Only a handful of buckets are ever used, send those instead of all TRACE_BUCKET_COUNT
+    uint8_t used = 0;
+    for (uint8_t b = 0; b < TRACE_BUCKET_COUNT; b++) {
+      if (histogram.buckets[b] != 0) {
+        used++;
+      }
+    }
+    writer.U8(used);
+    for (uint8_t b = 0; b < TRACE_BUCKET_COUNT; b++) {
+      if (histogram.buckets[b] != 0) {
+        writer.U8(b);
+        writer.U32(histogram.buckets[b]);
+      }
+    }
+  }
+
+  uint16_t oldest = (ringNext + TRACE_RING_SIZE - ringCount) % TRACE_RING_SIZE;
+  for (uint16_t i = 0; i < ringCount; i++) {
+    const Event &event = ring[(oldest + i) % TRACE_RING_SIZE];
+    writer.U32(event.startUs);
+    writer.U32(event.durationUs);
+    writer.U8(event.section);
+    writer.U8(event.depth);
+  }
+
+  writer.Crc();
+  port.flush();
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+
+// Cycle time tracing for loop(). Every traced section keeps a min/avg/max histogram, and each finished section also
+// goes into a ring of the last TRACE_RING_SIZE events (start, duration, nesting depth) so a dump shows what the
+// slow cycles were actually doing. Recording is two micros() reads and a few adds, no allocation.
+//
+// Sending TRACE_DUMP_REQUEST on the serial monitor dumps everything in the binary layout below, decode it on the PC
+// with Host-Simulation's trace-decode. TRACE_CLEAR_REQUEST starts the stats over.
+//
+// Dump layout, little endian:
+//   "LTRC" | version u8 | section count u8 | event count u16 | micros() at dump u32
+//   per section: count u32 | total us u64 | min us u32 | max us u32 | used buckets u8 | (bucket u8, count u32) * used
+//   per event, oldest first: start us u32 | duration us u32 | section u8 | depth u8
+//   crc16 lo | crc16 hi   (CRC-16/CCITT-FALSE like FrameProtocol, over everything after the magic)
+// The host decoder includes this with TRACE_FORMAT_ONLY defined and only gets the layout, keep that part Arduino free.
+
+#define TRACE_MAGIC "LTRC"
+const uint8_t TRACE_FORMAT_VERSION = 1;
+const char TRACE_DUMP_REQUEST = 'T';
+const char TRACE_CLEAR_REQUEST = 'C';
+
+enum TRACE_SECTION : uint8_t {
+  TRACE_CYCLE,          // loop() start to the next loop() start, histogram only
+  TRACE_LOOP,           // one scheduler pass, the tasks that ran but not the idle sleep
+  TRACE_SCREEN,         // ScreenPeriodic, serial parsing and flushing screen updates
+  TRACE_STATE_MACHINE,  // SDMotor::StateMachinePeriodic
+  TRACE_BUTTON,         // ButtonHandler, runs inside TRACE_SCREEN
+  TRACE_SD_WRITE,       // settings journal, config snapshot and cut list writes
+  TRACE_SECTION_COUNT
+};
+
+inline const char *TraceSectionName(uint8_t section) {
+  static const char *const names[TRACE_SECTION_COUNT] = { "cycle", "loop", "screen", "state machine", "button", "sd write" };
+  return section < TRACE_SECTION_COUNT ? names[section] : "?";
+}
+
+// Log-linear buckets: 4 per power of two, so any percentile read from them is within 25% (0-3 us are exact)
+const uint8_t TRACE_BUCKET_COUNT = 124;
+
+inline uint8_t TraceBucket(uint32_t us) {
+  if (us < 4) {
+    return (uint8_t)us;
+  }
+  uint8_t octave = 31 - __builtin_clz(us);
+  return (uint8_t)((octave - 1) * 4 + ((us >> (octave - 2)) & 3));
+}
+
+// Largest value that lands in the bucket
+inline uint32_t TraceBucketLimit(uint8_t bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  uint8_t octave = bucket / 4 + 1;
+  uint64_t low = (uint64_t)(4 + bucket % 4) << (octave - 2);
+  uint64_t high = low + ((uint64_t)1 << (octave - 2)) - 1;
+  return high > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)high;
+}
+
+#ifndef TRACE_FORMAT_ONLY
+#include <Arduino.h>
+
+class LoopTrace {
+public:
+  static const uint16_t TRACE_RING_SIZE = 512;
+
+  void Record(TRACE_SECTION section, uint32_t startUs, uint32_t durationUs, uint8_t depth);
+  // Called at the top of loop(), feeds TRACE_CYCLE
+  void MarkCycle();
+  void Clear();
+
+  // TRACE_DUMP_REQUEST / TRACE_CLEAR_REQUEST from the serial monitor, anything else is ignored
+  void HandleRequest(int c);
+  void Dump(Stream &port) const;
+
+  uint8_t EnterSection() { return depth++; }
+  void LeaveSection() { depth--; }
+
+private:
+  struct Histogram {
+    uint32_t count;
+    uint64_t totalUs;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t buckets[TRACE_BUCKET_COUNT];
+  };
+
+  struct Event {
+    uint32_t startUs;
+    uint32_t durationUs;
+    uint8_t section;
+    uint8_t depth;
+  };
+
+  Histogram histograms[TRACE_SECTION_COUNT] = {};
+  Event ring[TRACE_RING_SIZE];
+  uint16_t ringNext = 0;
+  uint16_t ringCount = 0;
+  uint8_t depth = 0;
+  bool hasCycleStart = false;
+  uint32_t cycleStartUs = 0;
+};
+
+extern LoopTrace loopTrace;
+
+// Times the enclosing block: TraceScope scope(TRACE_SCREEN);
+class TraceScope {
+public:
+  explicit TraceScope(TRACE_SECTION section)
+    : section(section), depth(loopTrace.EnterSection()), startUs(micros()) {}
+
+  ~TraceScope() {
+    uint32_t durationUs = micros() - startUs;
+    loopTrace.LeaveSection();
+    loopTrace.Record(section, startUs, durationUs, depth);
+  }
+
+private:
+  TRACE_SECTION section;
+  uint8_t depth;
+  uint32_t startUs;
+};
+#endif
@@ -4,6 +4,10 @@
 #include "MotorClasses.h"
 #include "ScreenClasses.h"
 #include "SDHelper.h"
+#include "CutListClasses.h"
+#include "BootSequencer.h"
+#include "LoopTrace.h"
+#include "TaskScheduler.h"
 #include "Utils.h"
 #include <Arduino.h>
 
@@ -15,6 +19,19 @@ Neo7CNC Automated Chop Saw fence
 String getUnitString(UnitType unit);
 float convertUnits(float value, UnitType from, UnitType to);
 float GetParameterEnteredAsFloat();
+// Normally generated by the Arduino IDE, spelled out so the sketch also builds as plain C++ (Host-Simulation)
+void ButtonHandler(SCREEN_OBJECT obj);
+void ShowTimedScreen(SCREEN screen);
+void EndTimedScreen();
+void ScreenTask();
+void MotorTask();
+void SettingsTask();
+void SerialMonitorTask();
+void PositionStreamTask();
+void UpdateMaxTravelSteps();
+void RunNextCut();
+void OnCutMoveComplete(bool success, int32_t position);
+void SetMeasurementUIDisplay();
 
 //---------------------------------------------------
 
@@ -25,11 +42,14 @@ int newValue;
 float currentMainMeasurement = 0.0f;
 float maxTravelMeasurement = 0.0f;
 UnitType maxTravelUnit;
+int32_t maxTravelSteps = 0;  // maxTravelMeasurement precompiled to steps so MEASURE doesn't convert units
 int displayMsTime = 1250;
 UnitType currentUnit;
 int serialMoniterBaudRate;
 int screenBaudRate;
 SystemConfig config;
+CutList cutList;
+bool cutListDirty = false;  // a part was counted, SettingsTask writes cutlist.txt
 
 enum InputMode {
   INPUT_MEASUREMENT,
@@ -41,13 +61,37 @@ InputMode currentInputMode = INPUT_MEASUREMENT;
 Mechanism* currentMechanismPtr = nullptr;
 ScreenGiga* screenPtr = nullptr;
 SDMotor* motorPtr = nullptr;
+BootSequencer bootSequencer;
+TaskScheduler scheduler;
+SCREEN timedScreen = MAIN_CONTROL_SCREEN;  // popup EndTimedScreen will take down
 
+// loop() task periods. The screen is polled fastest since that is where button presses come in.
+const uint32_t SCREEN_TASK_PERIOD_US = 2000;
+const uint32_t MOTOR_TASK_PERIOD_US = 5000;
+const uint32_t SETTINGS_TASK_PERIOD_US = 50000;
+const uint32_t SERIAL_MONITOR_TASK_PERIOD_US = 20000;
+const char SCHEDULER_STATS_REQUEST = 'S';
+const char LINK_BENCHMARK_REQUEST = 'B';
 
-void setup() {
+
+// --- Boot steps, run by BootSequencer in dependency order ---
+
+const uint32_t SERIAL_MONITOR_WAIT_MS = 1500;  // Only matters when a PC is attached, the saw doesn't need it
+
+bool BootStartSerialMonitor() {
   Serial.begin(serialMoniterBaudRate);
-  delay(5000);
-  Serial.println("Serial Monitor init");
+  return true;
+}
 
+BootSequencer::StepStatus BootPollSerialMonitor() {
+  if (Serial) {
+    Serial.println("Serial Monitor init");
+    return BootSequencer::STEP_DONE;
+  }
+  return BootSequencer::STEP_RUNNING;
+}
+
+bool BootLoadConfig() {
   initSDCard();
 
   config = readSettings();
@@ -59,7 +103,10 @@ void setup() {
 
   maxTravelMeasurement = config.mechanismParams.maxTravel;
   maxTravelUnit = config.mechanismParams.maxTravelUnit;
+  return true;
+}
 
+bool BootBuildMechanism() {
   //per mechanism type config loading
   if (config.mechanismType == "belt") {
 
@@ -89,51 +136,172 @@ void setup() {
                                                      config.mechanismParams.unit1);
   }
 
-  screenPtr = new ScreenGiga(screenBaudRate);
-  motorPtr = new SDMotor(currentMechanismPtr);
+  if (currentMechanismPtr == nullptr) {
+    Serial.println("Error: Unknown mechanism type in config.txt.");
+    return false;
+  }
+
+  if (!currentMechanismPtr->GetKinematics().IsValid()) {
+    Serial.println("Error: Mechanism parameters give zero steps per unit, check config.txt.");
+  }
+  UpdateMaxTravelSteps();
+  return true;
+}
 
-  screenPtr->InitAndConnect(currentUnit);
-  motorPtr->InitAndConnect();
+bool BootStartScreen() {
+  screenPtr = new ScreenGiga(screenBaudRate, config.screenMaxBaud);
+  screenPtr->BeginConnect(currentUnit);
+  return true;
+}
 
-  screenPtr->RegisterEventCallback(ButtonHandler);
+BootSequencer::StepStatus BootPollScreen() {
+  switch (screenPtr->PollConnect()) {
+    case Screen::CONNECT_DONE: return BootSequencer::STEP_DONE;
+    case Screen::CONNECT_TIMED_OUT: return BootSequencer::STEP_TIMED_OUT;
+    default: return BootSequencer::STEP_RUNNING;
+  }
+}
 
+bool BootStartMotor() {
+  if (currentMechanismPtr == nullptr) {
+    return false;
+  }
+  motorPtr = new SDMotor(currentMechanismPtr, config.motorShaftJerk);
+  motorPtr->ConfigureHoming(config.homingParams.fastVelocity,
+                            config.homingParams.slowVelocity,
+                            config.homingParams.torqueLimit,
+                            currentMechanismPtr->GetKinematics().TargetToSteps(config.homingParams.backoff, config.homingParams.backoffUnit),
+                            config.homingParams.timeoutMs);
+  motorPtr->InitAndConnect();
   motorPtr->HandleAlerts();
+  return true;
+}
 
+bool BootLoadCutList() {
+  // Fence starts a shift at home (0), so sort the loaded cut list from there and have the first target ready
+  if (currentMechanismPtr != nullptr && readCutList(cutList)) {
+    cutList.SortForMinimalTravel(0.0f);
+    cutList.PrepareNextCut(currentMechanismPtr->GetKinematics());
+  }
+  return true;
+}
 
-  screenPtr->SetScreen(MAIN_CONTROL_SCREEN);
+bool BootLoadCalibration() {
+  // No calibration.txt just means nominal kinematics, not a boot failure
+  if (currentMechanismPtr != nullptr) {
+    readCalibration(currentMechanismPtr->GetCalibration(), currentMechanismPtr->GetKinematics());
+  }
+  return true;
+}
 
-  //SetMeasurementUIDisplay();
-  screenPtr->SetStringLabel(MAIN_MEASUREMENT_LABEL, "0.00" + getUnitString(currentUnit));
+void setup() {
+  // The screen handshake is the long pole (waiting on the Giga to boot), so the motor and cut list come up while it runs
+  // Nothing waits on the serial monitor, it is only polled alongside the other steps so a saw without a PC attached never stalls on it
+  bootSequencer.AddStep("serial monitor", BootStartSerialMonitor, BootPollSerialMonitor, SERIAL_MONITOR_WAIT_MS);
+  int configStep = bootSequencer.AddStep("sd + config", BootLoadConfig);
+  int mechanismStep = bootSequencer.AddStep("mechanism", BootBuildMechanism, nullptr, 0, 1 << configStep);
+  bootSequencer.AddStep("screen link", BootStartScreen, BootPollScreen, 0, 1 << configStep);
+  bootSequencer.AddStep("motor", BootStartMotor, nullptr, 0, 1 << mechanismStep);
+  bootSequencer.AddStep("cut list", BootLoadCutList, nullptr, 0, 1 << mechanismStep);
+  bootSequencer.AddStep("calibration", BootLoadCalibration, nullptr, 0, 1 << mechanismStep);
+
+  bootSequencer.Run();
+
+  if (screenPtr != nullptr && motorPtr != nullptr) {
+    screenPtr->RegisterEventCallback(ButtonHandler);
+
+    screenPtr->SetScreen(MAIN_CONTROL_SCREEN);
+
+    //SetMeasurementUIDisplay();
+    screenPtr->SetStringLabel(MAIN_MEASUREMENT_LABEL, "0.00" + getUnitString(currentUnit));
+
+    scheduler.AddPeriodic("screen", ScreenTask, SCREEN_TASK_PERIOD_US);
+    scheduler.AddPeriodic("motor", MotorTask, MOTOR_TASK_PERIOD_US);
+    scheduler.AddPeriodic("settings", SettingsTask, SETTINGS_TASK_PERIOD_US);
+    scheduler.AddPeriodic("serial monitor", SerialMonitorTask, SERIAL_MONITOR_TASK_PERIOD_US);
+    if (config.positionStreamRate > 0) {
+      scheduler.AddPeriodic("position stream", PositionStreamTask, 1000000UL / min(config.positionStreamRate, 100));
+    }
+  }
+
+  bootSequencer.PrintTrace();
 }
 
 void loop() {
-  if (screenPtr != nullptr) {
-    screenPtr->ScreenPeriodic();
-    motorPtr->StateMachinePeriodic(screenPtr);
-    delay(10);
+  loopTrace.MarkCycle();
+  if (screenPtr != nullptr && motorPtr != nullptr) {
+    {
+      TraceScope loopScope(TRACE_LOOP);
+      scheduler.RunDue();
+    }
+    scheduler.Idle();
+  }
+}
+
+void ScreenTask() {
+  TraceScope scope(TRACE_SCREEN);
+  screenPtr->ScreenPeriodic();
+}
+
+void MotorTask() {
+  TraceScope scope(TRACE_STATE_MACHINE);
+  motorPtr->StateMachinePeriodic(screenPtr);
+}
+
+void SettingsTask() {
+  // A cut list or journal write can hold the loop for a few hundred ms, not while the motor task is steering a move
+  if (motorPtr->IsMoving() || motorPtr->IsHoming()) {
+    return;
+  }
+  settingsPeriodic(config);
+  if (cutListDirty) {
+    cutListDirty = false;
+    writeCutList(cutList);
+  }
+}
+
+// Live position for the screen's readout. The screen spaces the frames out further if the link is too slow for the rate.
+void PositionStreamTask() {
+  const MechanismKinematics &kinematics = currentMechanismPtr->GetKinematics();
+  screenPtr->StreamPosition(kinematics.StepsToHundredths(motorPtr->GetPosition(), currentUnit),
+                            kinematics.StepsToHundredths(motorPtr->GetMoveStart(), currentUnit),
+                            kinematics.StepsToHundredths(motorPtr->GetMoveTarget(), currentUnit),
+                            currentUnit, motorPtr->IsMoving());
+}
+
+// One letter commands typed into the serial monitor
+void SerialMonitorTask() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == SCHEDULER_STATS_REQUEST) {
+      scheduler.PrintStats();
+      screenPtr->PrintEventStats();
+    } else if (c == LINK_BENCHMARK_REQUEST) {
+      screenPtr->StartLinkBenchmark();
+    } else if (c == TRACE_CLEAR_REQUEST) {
+      scheduler.ClearStats();
+      loopTrace.HandleRequest(c);
+    } else {
+      loopTrace.HandleRequest(c);
+    }
   }
 }
 
 void ButtonHandler(SCREEN_OBJECT obj) {
+  TraceScope scope(TRACE_BUTTON);
   switch (obj) {
     case MEASURE_BUTTON:
       Serial.println("Measure pressed");
       if (motorPtr->hasHomed) {
-        float position = convertUnits(currentMainMeasurement, currentUnit, UNIT_INCHES);
-        // Serial.println("Position in inches: "+ String(position)); debugging
-        if (position < convertUnits(maxTravelMeasurement, maxTravelUnit, UNIT_INCHES)) {
-          Serial.println("Max travel: " + String(maxTravelMeasurement) + " " + getUnitString(currentUnit) + getUnitString(config.mechanismParams.maxTravelUnit));
-          motorPtr->MoveAbsolutePosition(static_cast<int32_t>(position * currentMechanismPtr->CalculateStepsPerUnit()));
+        int32_t targetSteps = currentMechanismPtr->GetKinematics().TargetToSteps(currentMainMeasurement, currentUnit);
+        if (targetSteps < maxTravelSteps) {
+          motorPtr->MoveAbsolutePosition(targetSteps);
         } else {
-          screenPtr->SetScreen(OUTSIDE_RANGE_ERROR_SCREEN);
-          delay(displayMsTime);
-          screenPtr->SetScreen(MAIN_CONTROL_SCREEN);
+          ShowTimedScreen(OUTSIDE_RANGE_ERROR_SCREEN);
           return;
         }
       } else {
-        screenPtr->SetScreen(PLEASE_HOME_ERROR_SCREEN);
-        delay(displayMsTime);
-        screenPtr->SetScreen(MAIN_CONTROL_SCREEN);
+        ShowTimedScreen(PLEASE_HOME_ERROR_SCREEN);
       }
       break;
     case EDIT_TARGET_BUTTON:
@@ -144,9 +312,8 @@ void ButtonHandler(SCREEN_OBJECT obj) {
     case HOME_BUTTON:
       Serial.println("HOME BUTTON PRESSED");
       motorPtr->StartSensorlessHoming();
+      // Stays up until homing finishes, the motor state machine puts the main screen back
       screenPtr->SetScreen(HOMING_ALERT_SCREEN);
-      delay(displayMsTime);
-      screenPtr->SetScreen(MAIN_CONTROL_SCREEN);
       currentMainMeasurement = 0.0f;
       screenPtr->SetStringLabel(MAIN_MEASUREMENT_LABEL, String(currentMainMeasurement) + getUnitString(currentUnit));
       break;
@@ -173,14 +340,14 @@ void ButtonHandler(SCREEN_OBJECT obj) {
       currentMainMeasurement = 0.0f;
       screenPtr->SetStringLabel(MAIN_MEASUREMENT_LABEL, String(currentMainMeasurement) + getUnitString(currentUnit));
       config.defaultUnit = currentUnit;
-      writeSettings(config);
+      markSettingsDirty(CONFIG_FIELD_DEFAULT_UNIT);
       break;
     case INCHES_UNIT_BUTTON:
       currentUnit = UNIT_INCHES;
       currentMainMeasurement = 0.0f;
       screenPtr->SetStringLabel(MAIN_MEASUREMENT_LABEL, String(currentMainMeasurement) + getUnitString(currentUnit));
       config.defaultUnit = currentUnit;
-      writeSettings(config);
+      markSettingsDirty(CONFIG_FIELD_DEFAULT_UNIT);
       break;
     case KEYBOARD_VALUE_ENTER:
       switch (currentInputMode) {
@@ -193,12 +360,84 @@ void ButtonHandler(SCREEN_OBJECT obj) {
             maxTravelMeasurement = newVal;
             config.mechanismParams.maxTravel = maxTravelMeasurement;
             config.mechanismParams.maxTravelUnit = currentUnit;
-            writeSettings(config);
+            maxTravelUnit = currentUnit;
+            UpdateMaxTravelSteps();
+            markSettingsDirty(CONFIG_FIELD_MAX_TRAVEL);
           }
           screenPtr->SetScreen(SETTINGS_SCREEN);
           break;
       }
       break;
+    case NEXT_CUT_BUTTON:
+      Serial.println("Next cut pressed");
+      RunNextCut();
+      break;
+  }
+}
+
+// Shows an alert screen for displayMsTime, then returns to the main screen. The loop keeps running meanwhile.
+void ShowTimedScreen(SCREEN screen) {
+  screenPtr->SetScreen(screen);
+  timedScreen = screen;
+  scheduler.StartTimer(EndTimedScreen, displayMsTime);
+}
+
+void EndTimedScreen() {
+  // Leave it alone if something else (homing, the keypad) has taken over the screen since
+  if (screenPtr->GetScreen() == timedScreen) {
+    screenPtr->SetScreen(MAIN_CONTROL_SCREEN);
+  }
+}
+
+void UpdateMaxTravelSteps() {
+  maxTravelSteps = currentMechanismPtr->GetKinematics().TargetToSteps(maxTravelMeasurement, maxTravelUnit);
+}
+
+void RunNextCut() {
+  if (!motorPtr->hasHomed) {
+    ShowTimedScreen(PLEASE_HOME_ERROR_SCREEN);
+    return;
+  }
+
+  // Asking for the next cut confirms the part at the current one
+  if (cutList.CompleteCut(motorPtr->GetPosition())) {
+    cutListDirty = true;
+  }
+
+  const CutJob *job = cutList.GetNextJob();
+  if (job == nullptr) {
+    Serial.println("Cut list complete.");
+    return;
+  }
+
+  if (currentMechanismPtr->GetKinematics().TargetToSteps(job->length, job->unit) >= maxTravelSteps) {
+    ShowTimedScreen(OUTSIDE_RANGE_ERROR_SCREEN);
+    return;
+  }
+
+  if (!cutList.IsNextCutPrepared()) {
+    cutList.PrepareNextCut(currentMechanismPtr->GetKinematics());
+  }
+
+  currentMainMeasurement = convertUnits(job->length, job->unit, currentUnit);
+  screenPtr->SetStringLabel(MAIN_MEASUREMENT_LABEL, String(currentMainMeasurement) + getUnitString(currentUnit));
+  motorPtr->MoveAbsolutePosition(cutList.GetPreparedTargetSteps(), OnCutMoveComplete);
+}
+
+void OnCutMoveComplete(bool success, int32_t position) {
+  if (!success) {
+    return;
+  }
+
+  // The fence is at the cut, work out the next target while the operator cuts. The part is counted (and the list
+  // saved) when the next cut is asked for, this runs on the motor task and has no time for the SD card.
+  cutList.ArriveAtCut(motorPtr->GetPosition());
+
+  if (cutList.PrepareNextCut(currentMechanismPtr->GetKinematics())) {
+    const CutJob *next = cutList.GetPreparedJob();
+    Serial.println("Next cut ready: " + String(next->length) + getUnitString(next->unit) + " (" + String(cutList.GetRemainingCuts() - 1) + " cuts left after this one)");
+  } else {
+    Serial.println("Last cut of the list.");
   }
 }
 
@@ -227,8 +466,6 @@ void SetMeasurementUIDisplay() {
     currentMainMeasurement = val;
     screenPtr->SetStringLabel(MAIN_MEASUREMENT_LABEL, combinedString);
   } else {
-    screenPtr->SetScreen(OUTSIDE_RANGE_ERROR_SCREEN);
-    delay(displayMsTime);
-    screenPtr->SetScreen(MAIN_CONTROL_SCREEN);
+    ShowTimedScreen(OUTSIDE_RANGE_ERROR_SCREEN);
   }
 }
@@ -3,11 +3,92 @@
 #include "Utils.h"
 #include <Arduino.h>
 
+// Exact conversion factor, kept out of float so long belt axes don't pick up rounding drift
+static const double MM_PER_INCH = 25.4;
+static const double PI_DOUBLE = 3.14159265358979323846;
+
+static double toInchesDouble(float value, UnitType unit) {
+  if (unit == UNIT_MILLIMETERS) {
+    return static_cast<double>(value) / MM_PER_INCH;
+  }
+  return value;
+}
+
+MechanismKinematics::MechanismKinematics(double stepsPerInch) {
+  if (stepsPerInch <= 0) {
+    return;
+  }
+  const double scale = static_cast<double>(1LL << STEPS_FRAC_BITS);
+  stepsPerUnitFixed[UNIT_INCHES] = static_cast<int64_t>(stepsPerInch * scale + 0.5);
+  stepsPerUnitFixed[UNIT_MILLIMETERS] = static_cast<int64_t>(stepsPerInch / MM_PER_INCH * scale + 0.5);
+  stepsPerUnitFixed[UNIT_UNKNOWN] = stepsPerUnitFixed[UNIT_INCHES];  // convertToInches treats unknown as inches
+
+  hundredthsPerStep[UNIT_INCHES] = static_cast<float>(100.0 / stepsPerInch);
+  hundredthsPerStep[UNIT_MILLIMETERS] = static_cast<float>(100.0 * MM_PER_INCH / stepsPerInch);
+  hundredthsPerStep[UNIT_UNKNOWN] = hundredthsPerStep[UNIT_INCHES];
+}
+
+void CalibrationTable::Clear() {
+  count = 0;
+  approachSteps = 0;
+}
+
+bool CalibrationTable::AddPoint(int32_t commandedSteps, int32_t measuredSteps) {
+  if (count >= MAX_POINTS) {
+    return false;
+  }
+  if (count > 0) {
+    int32_t commandedSpan = commandedSteps - commanded[count - 1];
+    int32_t measuredSpan = measuredSteps - measured[count - 1];
+    if (commandedSpan <= 0 || measuredSpan <= 0) {
+      return false;
+    }
+    slope[count - 1] = static_cast<int32_t>((static_cast<int64_t>(commandedSpan) << SLOPE_FRAC_BITS) / measuredSpan);
+  }
+
+  commanded[count] = commandedSteps;
+  measured[count] = measuredSteps;
+  slope[count] = 1L << SLOPE_FRAC_BITS;
+  count++;
+  return true;
+}
+
+int32_t CalibrationTable::Measured(int32_t commandedSteps) const {
+  if (count == 0) {
+    return commandedSteps;
+  }
+  if (commandedSteps <= commanded[0]) {
+    return commandedSteps - (commanded[0] - measured[0]);
+  }
+  if (commandedSteps >= commanded[count - 1]) {
+    return commandedSteps - (commanded[count - 1] - measured[count - 1]);
+  }
+
+  uint16_t low = 0;
+  uint16_t high = count - 1;
+  while (high - low > 1) {
+    uint16_t mid = (low + high) / 2;
+    if (commanded[mid] <= commandedSteps) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+
+  int64_t commandedSpan = commanded[low + 1] - commanded[low];
+  int64_t measuredSpan = measured[low + 1] - measured[low];
+  return measured[low] + static_cast<int32_t>((commandedSteps - commanded[low]) * measuredSpan / commandedSpan);
+}
 
 // --- Concrete Class for Belt Mechanism ---
 // Corrected constructor definition to match declaration in MechanismClasses.h
 BeltMechanism::BeltMechanism(int res, int accel, int vel, float diameter, float gearboxReduction, UnitType unit)
-  : motorProgInputRes(res), maxAccel(accel * res/60), maxVel(vel * res/60), pulleyDiameter(diameter), gearboxReduction(gearboxReduction), pulleyDiameterUnit(unit) {}
+  : motorProgInputRes(res), maxAccel(accel * res/60), maxVel(vel * res/60), pulleyDiameter(diameter), gearboxReduction(gearboxReduction), pulleyDiameterUnit(unit) {
+  double diameterInInches = toInchesDouble(pulleyDiameter, pulleyDiameterUnit);
+  if (diameterInInches > 0) {
+    kinematics = MechanismKinematics((motorProgInputRes / (diameterInInches * PI_DOUBLE)) * gearboxReduction);
+  }
+}
 
 int BeltMechanism::GetMotorProgInputRes() const {
   return motorProgInputRes;
@@ -41,7 +122,12 @@ UnitType BeltMechanism::GetParamUnit() const {
 // --- Concrete Class for Leadscrew Mechanism ---
 // Corrected constructor definition to match declaration in MechanismClasses.h
 LeadscrewMechanism::LeadscrewMechanism(int res, int accel, int vel, float pitch, float gearboxReduction, UnitType unit)
-  : motorProgInputRes(res), maxAccel(accel * res/60), maxVel(vel * res/60), leadscrewPitch(pitch), gearboxReduction(gearboxReduction), leadscrewPitchUnit(unit) {}
+  : motorProgInputRes(res), maxAccel(accel * res/60), maxVel(vel * res/60), leadscrewPitch(pitch), gearboxReduction(gearboxReduction), leadscrewPitchUnit(unit) {
+  double pitchInInches = toInchesDouble(leadscrewPitch, leadscrewPitchUnit);
+  if (pitchInInches > 0) {
+    kinematics = MechanismKinematics((motorProgInputRes / pitchInInches) * gearboxReduction);
+  }
+}
 
 int LeadscrewMechanism::GetMotorProgInputRes() const {
   return motorProgInputRes;
@@ -77,7 +163,12 @@ UnitType LeadscrewMechanism::GetParamUnit() const {
 // --- Concrete Class for Rack and Pinion Mechanism ---
 // Corrected constructor definition to match declaration in MechanismClasses.h
 RackAndPinionMechanism::RackAndPinionMechanism(int res, int accel, int vel, float diameter, float gearboxReduction, UnitType unit)
-  : motorProgInputRes(res), maxAccel(accel * res/60), maxVel(vel * res/60), pinionDiameter(diameter), gearboxReduction(gearboxReduction), pinionDiameterUnit(unit) {}
+  : motorProgInputRes(res), maxAccel(accel * res/60), maxVel(vel * res/60), pinionDiameter(diameter), gearboxReduction(gearboxReduction), pinionDiameterUnit(unit) {
+  double diameterInInches = toInchesDouble(pinionDiameter, pinionDiameterUnit);
+  if (diameterInInches > 0) {
+    kinematics = MechanismKinematics((motorProgInputRes / (diameterInInches * PI_DOUBLE)) * gearboxReduction);
+  }
+}
 
 int RackAndPinionMechanism::GetMotorProgInputRes() const {
   return motorProgInputRes;
@@ -1,6 +1,105 @@
 #pragma once
+#include <stdint.h>
 #include "Utils.h"
 
+// Steps-per-unit for every UnitType, derived once in double precision and stored as fixed point.
+// TargetToSteps is the move hot path: one float scale, one 64-bit multiply and a shift. No virtual calls, no divides.
+class MechanismKinematics {
+public:
+    static const int TARGET_FRAC_BITS = 16; // Q15.16 target, good to ~32000 units
+    static const int STEPS_FRAC_BITS = 20;  // Q43.20 steps per unit
+
+    MechanismKinematics() {}
+    explicit MechanismKinematics(double stepsPerInch);
+
+    inline int32_t TargetToSteps(float target, UnitType unit) const {
+        // Scaling by a power of two is exact in float, so the only rounding left is the final shift
+        int64_t targetFixed = static_cast<int32_t>(target * static_cast<float>(1L << TARGET_FRAC_BITS));
+        int64_t stepsFixed = targetFixed * stepsPerUnitFixed[unit];
+        return static_cast<int32_t>((stepsFixed + (1LL << (FIXED_SHIFT - 1))) >> FIXED_SHIFT);
+    }
+
+    // The other way round, for the live position readout. Hundredths of a unit so the Giga never needs a float.
+    inline int32_t StepsToHundredths(int32_t steps, UnitType unit) const {
+        float hundredths = steps * hundredthsPerStep[unit];
+        return static_cast<int32_t>(hundredths < 0 ? hundredths - 0.5f : hundredths + 0.5f);
+    }
+
+    bool IsValid() const { return stepsPerUnitFixed[UNIT_INCHES] > 0; }
+
+private:
+    static const int FIXED_SHIFT = TARGET_FRAC_BITS + STEPS_FRAC_BITS;
+
+    int64_t stepsPerUnitFixed[UNIT_UNKNOWN + 1] = {0, 0, 0};
+    float hundredthsPerStep[UNIT_UNKNOWN + 1] = {0, 0, 0};
+};
+
+
+// Measured position error along the travel (belt stretch, lead screw pitch error), loaded from /calibration.txt.
+// Points are (commanded, measured) in steps, both strictly increasing. Correct() maps a wanted physical position to the
+// steps to command. Outside the table the offset of the nearest end point is used.
+// Fixed arrays and a precomputed per-segment slope, so a lookup is a binary search, a multiply and a shift.
+class CalibrationTable {
+public:
+    static const uint16_t MAX_POINTS = 1024;
+    static const int SLOPE_FRAC_BITS = 16;
+
+    void Clear();
+    // Points have to come in increasing order, returns false (and ignores the point) otherwise or when full
+    bool AddPoint(int32_t commandedSteps, int32_t measuredSteps);
+
+    // Backlash: moves toward home overshoot by this much and come back, so every target is approached the same way
+    void SetApproachSteps(int32_t steps) { approachSteps = steps; }
+    int32_t GetApproachSteps() const { return approachSteps; }
+    // First leg of a move from currentSteps: short of a target toward home by the approach, never past home
+    int32_t ApproachTarget(int32_t finalSteps, int32_t currentSteps) const {
+        if (approachSteps > 0 && finalSteps < currentSteps) {
+            int32_t overshoot = finalSteps - approachSteps;
+            return overshoot > 0 ? overshoot : 0;
+        }
+        return finalSteps;
+    }
+
+    uint16_t GetPointCount() const { return count; }
+
+    // Inverse of Correct(): the physical position a commanded position ends up at. Display only (the live position
+    // stream), so it divides instead of keeping a second slope table.
+    int32_t Measured(int32_t commandedSteps) const;
+
+    inline int32_t Correct(int32_t targetSteps) const {
+        if (count == 0) {
+            return targetSteps;
+        }
+        if (targetSteps <= measured[0]) {
+            return targetSteps + (commanded[0] - measured[0]);
+        }
+        if (targetSteps >= measured[count - 1]) {
+            return targetSteps + (commanded[count - 1] - measured[count - 1]);
+        }
+
+        // Last point at or below the target
+        uint16_t low = 0;
+        uint16_t high = count - 1;
+        while (high - low > 1) {
+            uint16_t mid = (low + high) / 2;
+            if (measured[mid] <= targetSteps) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+
+        int64_t offset = static_cast<int64_t>(targetSteps - measured[low]) * slope[low];
+        return commanded[low] + static_cast<int32_t>((offset + (1LL << (SLOPE_FRAC_BITS - 1))) >> SLOPE_FRAC_BITS);
+    }
+
+private:
+    int32_t commanded[MAX_POINTS];
+    int32_t measured[MAX_POINTS];
+    int32_t slope[MAX_POINTS];  // Q15.16 commanded steps per measured step from this point to the next
+    uint16_t count = 0;
+    int32_t approachSteps = 0;
+};
 
 
 // --- Abstract Base Class (Interface) for Mechanism Configuration ---
@@ -17,8 +116,19 @@ public:
     virtual float GetPinionDiameter() const { return 0.0; }
     virtual UnitType GetParamUnit() const = 0;
 
+    // Compiled at construction, use this instead of CalculateStepsPerUnit when converting a target to steps
+    const MechanismKinematics &GetKinematics() const { return kinematics; }
+
+    // Same table whatever the drive, empty until readCalibration fills it
+    CalibrationTable &GetCalibration() { return calibration; }
+    const CalibrationTable &GetCalibration() const { return calibration; }
+
     // Virtual destructor for proper polymorphic deletion or whatever that means for C++ lol
     virtual ~Mechanism() {}
+
+protected:
+    MechanismKinematics kinematics;
+    CalibrationTable calibration;
 };
 
 // --- Concrete Class for Belt Mechanism ---
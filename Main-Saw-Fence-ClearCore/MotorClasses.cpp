@@ -3,9 +3,11 @@
 #include "MechanismClasses.h"
 #include "ScreenClasses.h"
 
-SDMotor::SDMotor(Mechanism *mech)
+SDMotor::SDMotor(Mechanism *mech, int shaftJerk)
   : maxAccel(mech->GetMaxAccel()),
     maxVel(mech->GetMaxVel()),
+    maxJerk(static_cast<float>(shaftJerk) * mech->GetMotorProgInputRes() / 60),
+    calibration(mech->GetCalibration()),
     motorProgInputRes(mech->GetMotorProgInputRes()) {}
 
 void SDMotor::InitAndConnect() {
@@ -26,65 +28,302 @@ int SDMotor::GetMaxVel() const {
   return maxVel;
 }
 
+float SDMotor::GetMaxJerk() const {
+  return maxJerk;
+}
+
 int SDMotor::GetMotorProgInputRes() const {
   return motorProgInputRes;
 }
 
-bool SDMotor::MoveAbsolutePosition(int32_t position) {
+bool SDMotor::MoveAbsolutePosition(int32_t position, MoveCompleteCallback callback) {
   if (!hasHomed) {
     return false;
   }
 
+  // A new target supersedes whatever move is still in flight
+  if (IsMoving()) {
+    Serial.println("Move superseded by new target.");
+    FinishMove(false);
+  }
+
+  moveRequested = position;
+  moveStart = GetPosition();
+  moveFinalTarget = calibration.Correct(position);
+  moveTarget = moveFinalTarget;
+  moveCallback = callback;
+  SetMoveState(MOVE_QUEUED);
+  return true;
+}
+
+void SDMotor::CancelMove() {
+  if (!IsMoving()) {
+    return;
+  }
   motor.MoveStopAbrupt();
+  Serial.println("Move canceled.");
+  FinishMove(false);
+}
 
-  motor.EnableRequest(true);
-  Delay_ms(10);
+int32_t SDMotor::GetPosition() const {
+  return calibration.Measured(motor.PositionRefCommanded());
+}
 
-  if (motor.StatusReg().bit.AlertsPresent) {
-    Serial.println("Motor alert detected before move.");
-    // HandleAlerts();
-    motor.ClearAlerts();
+bool SDMotor::IsMoving() const {
+  return moveState == MOVE_QUEUED || moveState == MOVE_ENABLING || moveState == MOVE_MOVING || moveState == MOVE_SETTLING;
+}
 
-    if (motor.StatusReg().bit.AlertsPresent) {
-      Serial.println("Alert persists after handling. Canceling move.");
-      return false;
-    }
+SDMotor::MoveState SDMotor::GetMoveState() const {
+  return moveState;
+}
+
+void SDMotor::SetMoveState(MoveState state) {
+  moveState = state;
+  moveStateStartMs = millis();
+}
+
+void SDMotor::FinishMove(bool success) {
+  StopStreaming();
+  SetMoveState(success ? MOVE_DONE : MOVE_FAULTED);
+
+  // Clear before calling so the callback is free to queue the next move
+  MoveCompleteCallback callback = moveCallback;
+  moveCallback = nullptr;
+  if (callback) {
+    callback(success, moveRequested);
   }
+}
 
-  // Ensure motor is ready
-  if (motor.HlfbState() != MotorDriver::HLFB_ASSERTED) {
-    Serial.println("Motor not ready (HLFB not asserted).");
-    return false;
+void SDMotor::StartMotion() {
+  // Moves shorter than a couple of segments can't be shaped anyway, the built in trapezoid does those
+  if (maxJerk > 0 && profile.Plan(motor.PositionRefCommanded(), moveTarget, maxVel, maxAccel, maxJerk)
+      && profile.GetDuration() * 1000000 > 2 * PROFILE_SEGMENT_US) {
+    streamingProfile = true;
+    profileStartUs = micros();
+    StreamProfile();
+    return;
   }
+  motor.Move(moveTarget, MotorDriver::MOVE_TARGET_ABSOLUTE);
+}
 
-  Serial.print("Moving to position: ");
-  Serial.println(position);
+void SDMotor::StreamProfile() {
+  float t = (micros() - profileStartUs) / 1000000.0f;
+  if (t >= profile.GetDuration()) {
+    // The segments were already bounded by the target, a normal move lands whatever is left exactly on it
+    StopStreaming();
+    motor.Move(moveTarget, MotorDriver::MOVE_TARGET_ABSOLUTE);
+    return;
+  }
 
-  motor.Move(position, MotorDriver::MOVE_TARGET_ABSOLUTE);
+  const float segment = PROFILE_SEGMENT_US / 1000000.0f;
+  float planPosition, planVelocity;
+  profile.Evaluate(t + segment, planPosition, planVelocity);
 
-  // Wait for motion to complete
-  while ((!motor.StepsComplete() || motor.HlfbState() != MotorDriver::HLFB_ASSERTED) && !motor.StatusReg().bit.AlertsPresent) {
-    continue;
+  // The step generator ramps linearly to the new velocity over the segment. Compare where that leaves us with the plan
+  // and fold half the difference back in, so late ticks and rounding don't pile up into a position error.
+  float currentVelocity = motor.VelocityRefCommanded();
+  float predicted = motor.PositionRefCommanded() + (currentVelocity + planVelocity) / 2 * segment;
+  float velocity = planVelocity + (planPosition - predicted) / segment;
+
+  // Never reverse or overspeed to chase the plan
+  bool forward = moveTarget >= profile.GetStart();
+  if (forward != (velocity >= 0)) {
+    velocity = 0;
   }
+  velocity = constrain(velocity, -(float)maxVel, (float)maxVel);
 
-  // Check again for alerts during the move
-  if (motor.StatusReg().bit.AlertsPresent) {
-    Serial.println("Motor alert during move.");
-    HandleAlerts();
-    return false;
+  // Never below the configured acceleration: the same limit also sets how hard the step generator can stop
+  float accel = fabsf(velocity - currentVelocity) / segment;
+  accel = constrain(accel, (float)maxAccel, 2.0f * maxAccel);
+
+  // Each segment is a bounded absolute move, never an open-ended velocity. It heads for the plan one segment out plus
+  // the distance to stop from this speed. If the next tick is late (a slow SD write) the fence stops at that point
+  // rather than running on at speed. Never past the target, the plan itself stops there within maxAccel.
+  float stopDistance = velocity * velocity / (2 * accel);
+  float bound = forward ? min(planPosition + stopDistance, (float)moveTarget)
+                        : max(planPosition - stopDistance, (float)moveTarget);
+
+  motor.VelMax(max(static_cast<int32_t>(fabsf(velocity)), (int32_t)1));
+  motor.AccelMax(static_cast<uint32_t>(accel));
+  motor.Move(static_cast<int32_t>(lroundf(bound)), MotorDriver::MOVE_TARGET_ABSOLUTE);
+}
+
+void SDMotor::StopStreaming() {
+  if (!streamingProfile) {
+    return;
   }
+  streamingProfile = false;
+  motor.VelMax(maxVel);
+  motor.AccelMax(maxAccel);
+}
 
-  Serial.println("Move done.");
-  return true;
+void SDMotor::MovePeriodic() {
+  switch (moveState) {
+    case MOVE_QUEUED:
+      motor.MoveStopAbrupt();
+      motor.EnableRequest(true);
+      SetMoveState(MOVE_ENABLING);
+      break;
+
+    case MOVE_ENABLING:
+      // Give the enable signal time to settle before looking at alerts/HLFB (used to be a blocking Delay_ms(10))
+      if (millis() - moveStateStartMs < MOVE_ENABLE_DELAY_MS) {
+        break;
+      }
+
+      if (motor.StatusReg().bit.AlertsPresent) {
+        Serial.println("Motor alert detected before move.");
+        motor.ClearAlerts();
+
+        if (motor.StatusReg().bit.AlertsPresent) {
+          Serial.println("Alert persists after handling. Canceling move.");
+          FinishMove(false);
+          break;
+        }
+      }
+
+      // Ensure motor is ready
+      if (motor.HlfbState() != MotorDriver::HLFB_ASSERTED) {
+        if (millis() - moveStateStartMs < MOVE_ENABLE_TIMEOUT_MS) {
+          break;
+        }
+        Serial.println("Motor not ready (HLFB not asserted).");
+        FinishMove(false);
+        break;
+      }
+
+      // Backlash: targets toward home are overshot and approached from below like every other target
+      moveTarget = calibration.ApproachTarget(moveFinalTarget, motor.PositionRefCommanded());
+
+      Serial.print("Moving to position: ");
+      Serial.println(moveFinalTarget);
+
+      SetMoveState(MOVE_MOVING);
+      StartMotion();
+      break;
+
+    case MOVE_MOVING:
+    case MOVE_SETTLING:
+      // Check for alerts during the move
+      if (motor.StatusReg().bit.AlertsPresent) {
+        Serial.println("Motor alert during move.");
+        HandleAlerts();
+        break;
+      }
+
+      if (moveState == MOVE_MOVING) {
+        if (streamingProfile) {
+          StreamProfile();
+        } else if (motor.StepsComplete()) {
+          if (moveTarget != moveFinalTarget) {
+            // Overshoot leg done, no need to settle before the approach
+            moveTarget = moveFinalTarget;
+            StartMotion();
+          } else {
+            SetMoveState(MOVE_SETTLING);
+          }
+        }
+      } else if (motor.HlfbState() == MotorDriver::HLFB_ASSERTED) {
+        Serial.println("Move done.");
+        FinishMove(true);
+      } else if (millis() - moveStateStartMs >= MOVE_SETTLE_TIMEOUT_MS) {
+        Serial.println("Move did not settle (HLFB not asserted).");
+        FinishMove(false);
+      }
+      break;
+
+    case MOVE_IDLE:
+    case MOVE_DONE:
+    case MOVE_FAULTED:
+      break;
+  }
 }
 
 
+void SDMotor::ConfigureHoming(int fastVelRpm, int slowVelRpm, float torqueLimitPercent, int32_t backoffSteps, uint32_t timeoutMs) {
+  homingFastVel = fastVelRpm * motorProgInputRes / 60;
+  homingSlowVel = slowVelRpm * motorProgInputRes / 60;
+  homingTorqueLimit = torqueLimitPercent;
+  homingBackoffSteps = backoffSteps;
+  homingTimeoutMs = timeoutMs;
+}
+
 void SDMotor::StartSensorlessHoming() {
+  CancelMove();
+  for (uint32_t &phaseMs : homingPhaseMs) {
+    phaseMs = 0;
+  }
+  homingStartMs = millis();
+  homingPhaseStartMs = homingStartMs;
   homingState = HOMING_INIT;
 }
 
+bool SDMotor::IsHoming() const {
+  return homingState != HOMING_IDLE;
+}
+
+uint32_t SDMotor::GetHomingPhaseMs(HomingState phase) const {
+  return homingPhaseMs[phase];
+}
+
+void SDMotor::SetHomingState(HomingState state) {
+  uint32_t now = millis();
+  homingPhaseMs[homingState] += now - homingPhaseStartMs;
+  homingPhaseStartMs = now;
+  homingState = state;
+  stallDetected = false;
+}
+
+bool SDMotor::HardstopReached() {
+  if (millis() - homingPhaseStartMs < HOMING_BLANK_MS) {
+    return false;
+  }
+
+  // Torque only comes back on HLFB while the drive is moving (bipolar PWM mode), anything else isn't a reading
+  if (motor.HlfbState() != MotorDriver::HLFB_HAS_MEASUREMENT || fabsf(motor.HlfbPercent()) < homingTorqueLimit) {
+    stallDetected = false;
+    return false;
+  }
+
+  if (!stallDetected) {
+    stallDetected = true;
+    stallStartMs = millis();
+  }
+  return millis() - stallStartMs >= HOMING_STALL_MS;
+}
+
+void SDMotor::PrintHomingReport(bool hadHomed) {
+  Serial.print("Homing done in ");
+  Serial.print(millis() - homingStartMs);
+  Serial.print(" ms (enable ");
+  Serial.print(homingPhaseMs[HOMING_ENABLING]);
+  Serial.print(", fast approach ");
+  Serial.print(homingPhaseMs[HOMING_FAST_APPROACH]);
+  Serial.print(", back off ");
+  Serial.print(homingPhaseMs[HOMING_BACK_OFF]);
+  Serial.print(", slow approach ");
+  Serial.print(homingPhaseMs[HOMING_SLOW_APPROACH]);
+  Serial.print(", release ");
+  Serial.print(homingPhaseMs[HOMING_RELEASE]);
+  Serial.println(")");
+
+  // How far apart the two touches were, and how far home moved since the last home (lost steps, belt stretch)
+  Serial.print("Slow touch was ");
+  Serial.print(slowStallPosition - fastStallPosition);
+  Serial.print(" steps from the fast one");
+  if (hadHomed) {
+    Serial.print(", home moved ");
+    Serial.print(slowStallPosition + homingBackoffSteps);
+    Serial.print(" steps since the last home");
+  }
+  Serial.println(".");
+}
+
 void SDMotor::HandleAlerts() {
   motor.MoveStopAbrupt();
+  if (IsMoving()) {
+    FinishMove(false);
+  }
   if (motor.AlertReg().bit.MotorFaulted) {
     Serial.println("Faults present. Cycling enable signal.");
     motor.EnableRequest(false);
@@ -95,44 +334,114 @@ void SDMotor::HandleAlerts() {
   motor.ClearAlerts();
 
   motor.EnableRequest(false);
+
+  // Homing would re-enable the drive and carry on, the next tick puts the screen back and clears hasHomed
+  if (homingState != HOMING_IDLE && homingState != HOMING_ERROR) {
+    Serial.println("Homing cancelled.");
+    SetHomingState(HOMING_ERROR);
+  }
 }
 
 void SDMotor::StateMachinePeriodic(Screen *screen) {
+  MovePeriodic();
+
+  HomingPeriodic(screen);
+}
+
+void SDMotor::HomingPeriodic(Screen *screen) {
+  if (homingState == HOMING_IDLE) {
+    return;
+  }
+
+  if (homingState != HOMING_COMPLETE && homingState != HOMING_ERROR) {
+    if (millis() - homingStartMs > homingTimeoutMs) {
+      Serial.println("Homing timed out.");
+      motor.MoveStopAbrupt();
+      SetHomingState(HOMING_ERROR);
+    } else if (homingState != HOMING_INIT && homingState != HOMING_ENABLING && motor.StatusReg().bit.AlertsPresent) {
+      Serial.println("Alert occurred during homing.");
+      HandleAlerts();
+      SetHomingState(HOMING_ERROR);
+    }
+  }
+
   switch (homingState) {
     case HOMING_INIT:
       hasHomed = false;
       Serial.println("Performing sensorless homing...");
       motor.EnableRequest(false);
-      Delay_ms(10);
-      motor.EnableRequest(true);
-      homingState = HOMING_COMPLETE;
-
-      //Again this is janky and this should be fixed at some point. It works though.
-      // if (motor.HlfbState() == MotorDriver::HLFB_ASSERTED) {
-      //   Serial.println("Sensorless homing complete!");
-      //   hasHomed = true;
-      //   homingState = HOMING_COMPLETE;
-      // } else if (motor.StatusReg().bit.AlertsPresent) {
-      //   Serial.println("Alert occurred during homing.");
-      //   HandleAlerts();
-      //   homingState = HOMING_ERROR;
-      // }
+      homingEnableRequested = false;
+      SetHomingState(HOMING_ENABLING);
+      break;
+
+    case HOMING_ENABLING:
+      // Enable off for a moment then back on (used to be a blocking Delay_ms(10)), then wait for the drive to be ready
+      if (!homingEnableRequested) {
+        if (millis() - homingPhaseStartMs >= HOMING_DISABLE_MS) {
+          motor.ClearAlerts();
+          motor.EnableRequest(true);
+          homingEnableRequested = true;
+        }
+        break;
+      }
+      if (motor.HlfbState() != MotorDriver::HLFB_ASSERTED) {
+        break;
+      }
+
+      motor.AccelMax(maxAccel);
+      motor.MoveVelocity(-homingFastVel);
+      SetHomingState(HOMING_FAST_APPROACH);
+      break;
+
+    case HOMING_FAST_APPROACH:
+      if (HardstopReached()) {
+        fastStallPosition = motor.PositionRefCommanded();
+        motor.MoveStopAbrupt();
+        motor.Move(homingBackoffSteps, MotorDriver::MOVE_TARGET_REL_END_POSN);
+        SetHomingState(HOMING_BACK_OFF);
+      }
+      break;
+
+    case HOMING_BACK_OFF:
+      if (motor.StepsComplete()) {
+        motor.MoveVelocity(-homingSlowVel);
+        SetHomingState(HOMING_SLOW_APPROACH);
+      }
+      break;
+
+    case HOMING_SLOW_APPROACH:
+      if (HardstopReached()) {
+        // Slow enough that the following error at the touch is small and the same every time
+        slowStallPosition = motor.PositionRefCommanded();
+        motor.MoveStopAbrupt();
+        motor.PositionRefSet(-homingBackoffSteps);
+        motor.Move(0, MotorDriver::MOVE_TARGET_ABSOLUTE);
+        SetHomingState(HOMING_RELEASE);
+      }
+      break;
+
+    case HOMING_RELEASE:
+      if (motor.StepsComplete() && motor.HlfbState() == MotorDriver::HLFB_ASSERTED) {
+        SetHomingState(HOMING_COMPLETE);
+      }
       break;
 
     case HOMING_COMPLETE:
-      motor.PositionRefSet(0);
+      PrintHomingReport(hasHomedBefore);
       hasHomed = true;
+      hasHomedBefore = true;
       screen->SetScreen(MAIN_CONTROL_SCREEN);
-      homingState = HOMING_IDLE;
+      SetHomingState(HOMING_IDLE);
       break;
 
     case HOMING_ERROR:
       screen->SetScreen(MAIN_CONTROL_SCREEN);
-      homingState = HOMING_IDLE;
+      SetHomingState(HOMING_IDLE);
       hasHomed = false;
       break;
 
     case HOMING_IDLE:
+    case HOMING_STATE_COUNT:
       break;
   }
 }
\ No newline at end of file
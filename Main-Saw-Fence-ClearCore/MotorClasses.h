@@ -3,24 +3,62 @@
 #include <ClearCore.h>
 #include "MechanismClasses.h"
 #include "ScreenClasses.h"
+#include "TrajectoryClasses.h"
 
 class SDMotor {
 public:
+    // Sensorless homing against the hardstop at the home end: fast approach until the torque says we hit it, back off,
+    // then a slow approach for the repeatable touch. Home (0) is the back off distance out from that touch, so the
+    // fence never sits preloaded against the hardstop.
     enum HomingState {
         HOMING_INIT,
+        HOMING_ENABLING,
+        HOMING_FAST_APPROACH,
+        HOMING_BACK_OFF,
+        HOMING_SLOW_APPROACH,
+        HOMING_RELEASE,
         HOMING_COMPLETE,
         HOMING_ERROR,
-        HOMING_IDLE
+        HOMING_IDLE,
+        HOMING_STATE_COUNT
     };
 
-    SDMotor(Mechanism *mech);
+    // Lifecycle of a single absolute move. StateMachinePeriodic advances it one step per tick so loop() never blocks on motion.
+    enum MoveState {
+        MOVE_IDLE,
+        MOVE_QUEUED,
+        MOVE_ENABLING,
+        MOVE_MOVING,
+        MOVE_SETTLING,
+        MOVE_DONE,
+        MOVE_FAULTED
+    };
+
+    typedef void (*MoveCompleteCallback)(bool success, int32_t position);
+
+    // shaftJerk is in RPM/s^2 like the other shaft limits, 0 leaves every move to the ClearCore's own trapezoid
+    SDMotor(Mechanism *mech, int shaftJerk = 0);
 
     int GetMaxAccel() const;
     int GetMaxVel() const;
+    float GetMaxJerk() const;
     int GetMotorProgInputRes() const;
 
-    bool MoveAbsolutePosition(int32_t position);
+    // Queues the move and returns immediately. position is nominal steps, the mechanism's calibration table is applied here.
+    bool MoveAbsolutePosition(int32_t position, MoveCompleteCallback callback = nullptr);
+    void CancelMove();
+    bool IsMoving() const;
+    MoveState GetMoveState() const;
+    // Where the fence is right now and where the current (or last) move started and is going. Nominal steps, with the
+    // calibration taken back out, so they compare against what was asked for.
+    int32_t GetPosition() const;
+    int32_t GetMoveStart() const { return moveStart; }
+    int32_t GetMoveTarget() const { return moveRequested; }
+    // Velocities in shaft RPM, torque limit in % of peak as reported on HLFB
+    void ConfigureHoming(int fastVelRpm, int slowVelRpm, float torqueLimitPercent, int32_t backoffSteps, uint32_t timeoutMs);
     void StartSensorlessHoming();
+    bool IsHoming() const;
+    uint32_t GetHomingPhaseMs(HomingState phase) const;
     void HandleAlerts();
     void StateMachinePeriodic(Screen *screen);
     void InitAndConnect();
@@ -30,8 +68,59 @@ public:
 private:
     int maxAccel;
     int maxVel;
+    float maxJerk;  // steps/s^3
+    const CalibrationTable &calibration;
     int motorProgInputRes;
     MotorDriver &motor = ConnectorM0;
 
     HomingState homingState = HOMING_IDLE;
+    int homingFastVel = 0;  // steps/s
+    int homingSlowVel = 0;
+    float homingTorqueLimit = 40.0f;
+    int32_t homingBackoffSteps = 0;
+    uint32_t homingTimeoutMs = 20000;
+
+    uint32_t homingStartMs = 0;
+    uint32_t homingPhaseStartMs = 0;
+    uint32_t homingPhaseMs[HOMING_STATE_COUNT];
+    bool homingEnableRequested = false;
+    bool hasHomedBefore = false;  // the previous home is the reference for how far home moved
+    bool stallDetected = false;
+    uint32_t stallStartMs = 0;
+    int32_t fastStallPosition = 0;
+    int32_t slowStallPosition = 0;
+
+    static const uint32_t HOMING_DISABLE_MS = 10;      // enable held off before re-enabling, clears the drive
+    static const uint32_t HOMING_BLANK_MS = 150;       // ignore the torque spike while the approach accelerates
+    static const uint32_t HOMING_STALL_MS = 20;        // torque must stay over the limit this long to count as the hardstop
+
+    void HomingPeriodic(Screen *screen);
+    void SetHomingState(HomingState state);
+    bool HardstopReached();
+    void PrintHomingReport(bool hadHomed);
+
+    MoveState moveState = MOVE_IDLE;
+    int32_t moveRequested = 0;    // position asked for, before calibration
+    int32_t moveStart = 0;        // nominal, where the fence was when the move was queued
+    int32_t moveFinalTarget = 0;  // after calibration
+    int32_t moveTarget = 0;       // current leg, below moveFinalTarget while overshooting for backlash
+    uint32_t moveStateStartMs = 0;
+    MoveCompleteCallback moveCallback = nullptr;
+
+    static const uint32_t MOVE_ENABLE_DELAY_MS = 10;
+    static const uint32_t MOVE_ENABLE_TIMEOUT_MS = 500;
+    static const uint32_t MOVE_SETTLE_TIMEOUT_MS = 2000;  // steps done, a drive that can't reach the position never asserts HLFB
+
+    // S-curve playback. Each tick commands a bounded absolute move toward where the profile will be one segment from now.
+    SCurveProfile profile;
+    bool streamingProfile = false;
+    uint32_t profileStartUs = 0;
+    static const uint32_t PROFILE_SEGMENT_US = 10000;
+
+    void StartMotion();
+    void StreamProfile();
+    void StopStreaming();
+    void MovePeriodic();
+    void SetMoveState(MoveState state);
+    void FinishMove(bool success);
 };
@@ -2,12 +2,112 @@
 
 #define ARDUINOJSON_ENABLE_PROGMEM 0
 #include "SDHelper.h"
+#include "LoopTrace.h"
 #include <ArduinoJson.h>
 #include "Utils.h"
 
 File myFile;
 bool sdInit = false;
 
+// config.txt is only ever replaced by a complete, parsed copy (config.tmp), and the version before that is kept in config.bak.
+// Small runtime changes (unit toggle, max travel) go to the append only config.jnl and get folded back into config.txt
+// once the journal grows past CONFIG_JOURNAL_COMPACT_ENTRIES.
+static const char *CONFIG_PATH = "/config.txt";
+static const char *CONFIG_TEMP_PATH = "/config.tmp";
+static const char *CONFIG_BACKUP_PATH = "/config.bak";
+static const char *CONFIG_JOURNAL_PATH = "/config.jnl";
+// The cut list is rewritten the same way, its remaining counts have to survive a power cut mid shift
+static const char *CUTLIST_PATH = "/cutlist.txt";
+static const char *CUTLIST_TEMP_PATH = "/cutlist.tmp";
+static const char *CUTLIST_BACKUP_PATH = "/cutlist.bak";
+
+static const uint32_t CONFIG_WRITE_DEBOUNCE_MS = 2000;
+static const int CONFIG_JOURNAL_COMPACT_ENTRIES = 64;
+
+static uint16_t dirtyFields = 0;
+static uint32_t lastDirtyMs = 0;
+static int journalEntries = 0;
+static int loadedConfigVersion = 0;
+
+static bool isValidJsonFile(const char *path) {
+  if (!SD.exists(path)) {
+    return false;
+  }
+
+  File file = SD.open(path, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  StaticJsonDocument<2048> doc;  // big enough for a full cut list
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+  return !error;
+}
+
+static bool copyFile(const char *fromPath, const char *toPath) {
+  File from = SD.open(fromPath, FILE_READ);
+  if (!from) {
+    return false;
+  }
+
+  SD.remove(toPath);
+  File to = SD.open(toPath, FILE_WRITE);
+  if (!to) {
+    from.close();
+    return false;
+  }
+
+  uint8_t buffer[64];
+  bool ok = true;
+  int count;
+  while ((count = from.read(buffer, sizeof(buffer))) > 0) {
+    if (to.write(buffer, count) != (size_t)count) {
+      ok = false;
+      break;
+    }
+  }
+
+  to.close();
+  from.close();
+  return ok;
+}
+
+// Finishes or rolls back a rewrite through tempPath that was cut off by a power loss
+static void recoverFile(const char *path, const char *tempPath, const char *backupPath) {
+  if (SD.exists(tempPath)) {
+    if (isValidJsonFile(tempPath)) {
+      // The new version was complete, the copy over path was what got interrupted
+      Serial.println("Recovering " + String(path) + " from " + String(tempPath));
+      copyFile(tempPath, path);
+    }
+    SD.remove(tempPath);
+  }
+
+  if (SD.exists(backupPath) && !isValidJsonFile(path) && isValidJsonFile(backupPath)) {
+    Serial.println(String(path) + " missing or corrupt, restoring " + String(backupPath));
+    copyFile(backupPath, path);
+  }
+}
+
+// Swaps a freshly written tempPath in for path once it reads back as valid JSON, keeping the old path in backupPath.
+// SD has no rename, so this copies, recoverFile() finishes it if power drops part way through.
+static bool replaceFile(const char *path, const char *tempPath, const char *backupPath) {
+  if (!isValidJsonFile(tempPath)) {
+    Serial.println(String(tempPath) + " failed verification, keeping the old " + String(path));
+    SD.remove(tempPath);
+    return false;
+  }
+
+  copyFile(path, backupPath);
+  if (!copyFile(tempPath, path)) {
+    Serial.println("Failed to replace " + String(path) + ", it will be recovered from " + String(tempPath) + " on next boot");
+    return false;
+  }
+  SD.remove(tempPath);
+  return true;
+}
+
 void initSDCard() {
   Serial.println("Initializing SD card...");
 
@@ -16,7 +116,10 @@ void initSDCard() {
     while (true) {}
   }
 
-  if (SD.exists("/config.txt")) {
+  recoverFile(CONFIG_PATH, CONFIG_TEMP_PATH, CONFIG_BACKUP_PATH);
+  recoverFile(CUTLIST_PATH, CUTLIST_TEMP_PATH, CUTLIST_BACKUP_PATH);
+
+  if (SD.exists(CONFIG_PATH)) {
     Serial.println("initialization done.");
     sdInit = true;
   } else {
@@ -26,27 +129,185 @@ void initSDCard() {
 }
 
 
+// --- Binary snapshot ---
+// config.bin holds config.txt already parsed into a SystemConfig so a normal boot skips ArduinoJson entirely, the
+// few lines of config.jnl are replayed on top of it. It is only rewritten when config.txt is (writeSettings, or a
+// boot that found the CRC of config.txt no longer matching sourceCrc), never on a journal flush.
+
+static const char *CONFIG_SNAPSHOT_PATH = "/config.bin";
+static const uint32_t CONFIG_SNAPSHOT_MAGIC = 0x42434653;  // "SFCB"
+static const uint16_t CONFIG_SNAPSHOT_VERSION = 6;         // bump whenever ConfigSnapshot changes layout
+
+struct ConfigSnapshot {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  uint32_t sourceCrc;
+
+  int32_t serialMonitorBaud;
+  int32_t screenBaud;
+  int32_t screenMaxBaud;
+  int32_t motorPulsesPerRevolution;
+  int32_t motorShaftVel;
+  int32_t motorShaftAccel;
+  int32_t motorShaftJerk;
+  int32_t positionStreamRate;
+  int32_t configVersion;
+  uint8_t defaultUnit;
+  char screenType[16];
+  char mechanismType[16];
+  mechanismConfig mechanismParams;
+  homingConfig homingParams;
+
+  uint32_t crc;  // over everything above
+};
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t length) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static uint32_t crc32File(uint32_t crc, const char *path) {
+  File file = SD.open(path, FILE_READ);
+  if (!file) {
+    return crc;
+  }
+
+  uint8_t buffer[64];
+  int count;
+  while ((count = file.read(buffer, sizeof(buffer))) > 0) {
+    crc = crc32Update(crc, buffer, count);
+  }
+  file.close();
+  return crc;
+}
+
+// Only config.txt, the snapshot holds the settings before the journal and the journal is replayed on top of it
+static uint32_t configSourceCrc() {
+  return crc32File(0, CONFIG_PATH);
+}
+
+static bool readConfigSnapshot(SystemConfig &config, uint32_t sourceCrc) {
+  if (!SD.exists(CONFIG_SNAPSHOT_PATH)) {
+    return false;
+  }
+
+  File file = SD.open(CONFIG_SNAPSHOT_PATH, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  ConfigSnapshot snapshot;
+  int count = file.read(&snapshot, sizeof(snapshot));
+  file.close();
+
+  if (count != sizeof(snapshot) || snapshot.magic != CONFIG_SNAPSHOT_MAGIC || snapshot.version != CONFIG_SNAPSHOT_VERSION
+      || snapshot.size != sizeof(snapshot)) {
+    Serial.println("config.bin is missing or from another firmware version, parsing config.txt");
+    return false;
+  }
+  if (snapshot.crc != crc32Update(0, (const uint8_t *)&snapshot, offsetof(ConfigSnapshot, crc))) {
+    Serial.println("config.bin failed its CRC check, parsing config.txt");
+    return false;
+  }
+  if (snapshot.sourceCrc != sourceCrc) {
+    Serial.println("config.txt changed since config.bin was written, parsing config.txt");
+    return false;
+  }
+
+  snapshot.screenType[sizeof(snapshot.screenType) - 1] = '\0';
+  snapshot.mechanismType[sizeof(snapshot.mechanismType) - 1] = '\0';
+
+  config.serialMonitorBaud = snapshot.serialMonitorBaud;
+  config.screenBaud = snapshot.screenBaud;
+  config.screenMaxBaud = snapshot.screenMaxBaud;
+  config.motorPulsesPerRevolution = snapshot.motorPulsesPerRevolution;
+  config.motorShaftVel = snapshot.motorShaftVel;
+  config.motorShaftAccel = snapshot.motorShaftAccel;
+  config.motorShaftJerk = snapshot.motorShaftJerk;
+  config.positionStreamRate = snapshot.positionStreamRate;
+  config.configVersion = snapshot.configVersion;
+  config.defaultUnit = (UnitType)snapshot.defaultUnit;
+  config.screenType = String(snapshot.screenType);
+  config.mechanismType = String(snapshot.mechanismType);
+  config.mechanismParams = snapshot.mechanismParams;
+  config.homingParams = snapshot.homingParams;
+
+  loadedConfigVersion = snapshot.configVersion;
+  return true;
+}
+
+static void writeConfigSnapshot(const SystemConfig &config, uint32_t sourceCrc) {
+  ConfigSnapshot snapshot;
+  memset((void *)&snapshot, 0, sizeof(snapshot));  // padding too, it is covered by the CRC
+
+  snapshot.magic = CONFIG_SNAPSHOT_MAGIC;
+  snapshot.version = CONFIG_SNAPSHOT_VERSION;
+  snapshot.size = sizeof(snapshot);
+  snapshot.sourceCrc = sourceCrc;
+
+  snapshot.serialMonitorBaud = config.serialMonitorBaud;
+  snapshot.screenBaud = config.screenBaud;
+  snapshot.screenMaxBaud = config.screenMaxBaud;
+  snapshot.motorPulsesPerRevolution = config.motorPulsesPerRevolution;
+  snapshot.motorShaftVel = config.motorShaftVel;
+  snapshot.motorShaftAccel = config.motorShaftAccel;
+  snapshot.motorShaftJerk = config.motorShaftJerk;
+  snapshot.positionStreamRate = config.positionStreamRate;
+  snapshot.configVersion = config.configVersion;
+  snapshot.defaultUnit = (uint8_t)config.defaultUnit;
+  config.screenType.toCharArray(snapshot.screenType, sizeof(snapshot.screenType));
+  config.mechanismType.toCharArray(snapshot.mechanismType, sizeof(snapshot.mechanismType));
+  snapshot.mechanismParams = config.mechanismParams;
+  snapshot.homingParams = config.homingParams;
+
+  snapshot.crc = crc32Update(0, (const uint8_t *)&snapshot, offsetof(ConfigSnapshot, crc));
+
+  SD.remove(CONFIG_SNAPSHOT_PATH);
+  File file = SD.open(CONFIG_SNAPSHOT_PATH, FILE_WRITE);
+  if (!file) {
+    Serial.println("Failed to open config.bin for writing");
+    return;
+  }
+  file.write((const uint8_t *)&snapshot, sizeof(snapshot));
+  file.close();
+}
+
 void writeSettings(SystemConfig writeConfig) {
   if (!sdInit) {
     Serial.println("SD card not initialized!");
     return;
   }
 
-  SD.remove("/config.txt");
+  // Write the complete new version next to the old one first, config.txt is only touched once this is safely on the card
+  SD.remove(CONFIG_TEMP_PATH);
 
-  myFile = SD.open("/config.txt", FILE_WRITE);
+  myFile = SD.open(CONFIG_TEMP_PATH, FILE_WRITE);
   if (!myFile) {
-    Serial.println("Failed to open config.txt for writing");
+    Serial.println("Failed to open config.tmp for writing");
     return;
   }
 
+  loadedConfigVersion = max(loadedConfigVersion, writeConfig.configVersion) + 1;
+
   StaticJsonDocument<1024> doc;
 
+  doc["configVersion"] = String(loadedConfigVersion);
+
   doc["serialMonitorBaud"] = String(writeConfig.serialMonitorBaud);
   doc["screenBaud"] = String(writeConfig.screenBaud);
+  doc["screenMaxBaud"] = String(writeConfig.screenMaxBaud);
   doc["motorPulsesPerRevolution"] = String(writeConfig.motorPulsesPerRevolution);
   doc["motorShaftVelocity"] = String(writeConfig.motorShaftVel);
   doc["motorShaftAcceleration"] = String(writeConfig.motorShaftAccel);
+  doc["motorShaftJerk"] = String(writeConfig.motorShaftJerk);
+  doc["positionStreamRate"] = String(writeConfig.positionStreamRate);
   doc["defaultUnit"] = String(getUnitWordStringFromUnit(writeConfig.defaultUnit));
   doc["screenType"] = String(writeConfig.screenType);
   doc["mechanism"] = String(writeConfig.mechanismType);
@@ -70,16 +331,234 @@ void writeSettings(SystemConfig writeConfig) {
     params["gearboxReduction"] = String(writeConfig.mechanismParams.gearboxReduction);
   }
 
+  JsonObject homing = doc.createNestedObject("homingParameters");
+  homing["fastVelocity"] = String(writeConfig.homingParams.fastVelocity);
+  homing["slowVelocity"] = String(writeConfig.homingParams.slowVelocity);
+  homing["torqueLimit"] = String(writeConfig.homingParams.torqueLimit);
+  homing["backoff"] = String(writeConfig.homingParams.backoff);
+  homing["backoffUnit"] = getUnitWordStringFromUnit(writeConfig.homingParams.backoffUnit);
+  homing["timeout"] = String(writeConfig.homingParams.timeoutMs);
+
   myFile.seek(0);
 
   // Write the JSON to the file
   if (serializeJson(doc, myFile) == 0) {
     Serial.println("Failed to write JSON to file");
-  } else {
-    Serial.println("Config successfully written to SD");
+    myFile.close();
+    SD.remove(CONFIG_TEMP_PATH);
+    return;
   }
-
   myFile.close();
+
+  if (!replaceFile(CONFIG_PATH, CONFIG_TEMP_PATH, CONFIG_BACKUP_PATH)) {
+    return;
+  }
+
+  // Everything in the journal is now part of config.txt
+  SD.remove(CONFIG_JOURNAL_PATH);
+  journalEntries = 0;
+  dirtyFields = 0;
+
+  SystemConfig writtenConfig = writeConfig;
+  writtenConfig.configVersion = loadedConfigVersion;
+  writeConfigSnapshot(writtenConfig, configSourceCrc());
+
+  Serial.println("Config successfully written to SD (version " + String(loadedConfigVersion) + ")");
+}
+
+// --- Journal ---
+// One change per line: key=value*XX where XX is the XOR of the characters before the '*' in hex (NMEA style),
+// so a line torn by a power loss is detected and skipped instead of replayed with a truncated value.
+
+static uint8_t journalChecksum(const char *line, int length) {
+  uint8_t sum = 0;
+  for (int i = 0; i < length; i++) {
+    sum ^= (uint8_t)line[i];
+  }
+  return sum;
+}
+
+static bool appendJournal(const String &entry) {
+  File journal = SD.open(CONFIG_JOURNAL_PATH, FILE_WRITE);  // FILE_WRITE appends
+  if (!journal) {
+    Serial.println("Failed to open config.jnl for writing");
+    return false;
+  }
+
+  char checksum[4];
+  snprintf(checksum, sizeof(checksum), "*%02X", journalChecksum(entry.c_str(), entry.length()));
+  journal.print(entry);
+  journal.println(checksum);
+  journal.close();
+
+  journalEntries++;
+  return true;
+}
+
+static void applyJournalEntry(SystemConfig &config, const char *key, const char *value) {
+  if (strcmp(key, "defaultUnit") == 0) {
+    config.defaultUnit = getUnitFromString(String(value));
+  } else if (strcmp(key, "maxTravel") == 0) {
+    // value is "<number>,<unit word>"
+    const char *comma = strchr(value, ',');
+    if (comma != nullptr) {
+      config.mechanismParams.maxTravel = atof(value);
+      config.mechanismParams.maxTravelUnit = getUnitFromString(String(comma + 1));
+    }
+  }
+}
+
+static void replayJournal(SystemConfig &config) {
+  journalEntries = 0;
+
+  if (!SD.exists(CONFIG_JOURNAL_PATH)) {
+    return;
+  }
+
+  File journal = SD.open(CONFIG_JOURNAL_PATH, FILE_READ);
+  if (!journal) {
+    return;
+  }
+
+  char line[64];
+  int length = 0;
+  int skipped = 0;
+  int c;
+  while ((c = journal.read()) >= 0) {
+    if (c == '\r') {
+      continue;
+    }
+    if (c != '\n') {
+      if (length < (int)sizeof(line) - 1) {
+        line[length++] = (char)c;
+      }
+      continue;
+    }
+
+    line[length] = '\0';
+    char *star = strrchr(line, '*');
+    char *equals = strchr(line, '=');
+    if (star != nullptr && equals != nullptr && equals < star
+        && strtol(star + 1, nullptr, 16) == journalChecksum(line, star - line)) {
+      *star = '\0';
+      *equals = '\0';
+      applyJournalEntry(config, line, equals + 1);
+      journalEntries++;
+    } else {
+      skipped++;
+    }
+    length = 0;
+  }
+  journal.close();
+
+  // A trailing line without its newline is a torn write, it is dropped like any other bad line
+  if (length > 0) {
+    skipped++;
+  }
+
+  Serial.println("Replayed " + String(journalEntries) + " journaled settings changes (" + String(skipped) + " skipped)");
+}
+
+void markSettingsDirty(uint16_t fields) {
+  dirtyFields |= fields;
+  lastDirtyMs = millis();
+}
+
+void settingsPeriodic(const SystemConfig &currentConfig) {
+  // Only write once the operator has stopped changing things, a burst of toggles becomes a single write
+  if (dirtyFields != 0 && millis() - lastDirtyMs >= CONFIG_WRITE_DEBOUNCE_MS) {
+    flushSettings(currentConfig);
+  }
+}
+
+void flushSettings(const SystemConfig &currentConfig) {
+  if (dirtyFields == 0) {
+    return;
+  }
+  TraceScope scope(TRACE_SD_WRITE);
+
+  if (!sdInit) {
+    Serial.println("SD card not initialized!");
+    return;
+  }
+
+  if (journalEntries >= CONFIG_JOURNAL_COMPACT_ENTRIES) {
+    writeSettings(currentConfig);  // clears dirtyFields and the journal
+    return;
+  }
+
+  if (dirtyFields & CONFIG_FIELD_DEFAULT_UNIT) {
+    appendJournal("defaultUnit=" + getUnitWordStringFromUnit(currentConfig.defaultUnit));
+  }
+  if (dirtyFields & CONFIG_FIELD_MAX_TRAVEL) {
+    appendJournal("maxTravel=" + String(currentConfig.mechanismParams.maxTravel) + "," + getUnitWordStringFromUnit(currentConfig.mechanismParams.maxTravelUnit));
+  }
+  dirtyFields = 0;
+}
+
+static void printSettings(const SystemConfig &config) {
+  // Printed piece by piece, building each line as a String put a few hundred bytes of heap churn into every boot
+  Serial.println();
+  Serial.println("=== CONFIG LOADED ===");
+  Serial.print("Config version: ");
+  Serial.print(config.configVersion);
+  Serial.print(" + ");
+  Serial.print(journalEntries);
+  Serial.println(" journal entries");
+  Serial.print("Serial Baud: ");
+  Serial.println(config.serialMonitorBaud);
+  Serial.print("Screen Baud: ");
+  Serial.print(config.screenBaud);
+  Serial.print(", up to ");
+  Serial.println(config.screenMaxBaud);
+  Serial.print("Motor Pulses/Rev: ");
+  Serial.println(config.motorPulsesPerRevolution);
+  Serial.print("Unit:");
+  Serial.println(getUnitString(config.defaultUnit));
+  Serial.print("Screen Type: ");
+  Serial.println(config.screenType);
+  Serial.print("Mechanism: ");
+  Serial.println(config.mechanismType);
+  Serial.print("Motor Shaft Velocity: ");
+  Serial.println(config.motorShaftVel);
+  Serial.print("Motor Shaft Acceleration: ");
+  Serial.println(config.motorShaftAccel);
+  Serial.print("Motor Shaft Jerk: ");
+  Serial.println(config.motorShaftJerk);
+  Serial.print("Position Stream Rate: ");
+  Serial.print(config.positionStreamRate);
+  Serial.println(" Hz");
+
+  if (config.mechanismType == "belt") {
+    Serial.print("Pulley diameter: ");
+    Serial.println(config.mechanismParams.pulleyDiameter);
+  } else if (config.mechanismType == "lead_screw") {
+    Serial.print("Leadscrew pitch: ");
+    Serial.println(config.mechanismParams.screwPitch);
+  } else if (config.mechanismType == "rack_pinion") {
+    Serial.print("Pinion diameter: ");
+    Serial.println(config.mechanismParams.pinionDiameter);
+  }
+  Serial.print("Gearbox reduction: ");
+  Serial.println(config.mechanismParams.gearboxReduction);
+
+  Serial.print("Max Travel: ");
+  Serial.println(config.mechanismParams.maxTravel);
+
+  Serial.print("Homing: fast ");
+  Serial.print(config.homingParams.fastVelocity);
+  Serial.print(" RPM, slow ");
+  Serial.print(config.homingParams.slowVelocity);
+  Serial.print(" RPM, torque limit ");
+  Serial.print(config.homingParams.torqueLimit);
+  Serial.print("%, back off ");
+  Serial.print(config.homingParams.backoff);
+  Serial.print(getUnitString(config.homingParams.backoffUnit));
+  Serial.print(", timeout ");
+  Serial.print(config.homingParams.timeoutMs);
+  Serial.println(" ms");
+
+  Serial.println();
 }
 
 SystemConfig readSettings() {
@@ -90,7 +569,16 @@ SystemConfig readSettings() {
     return config;
   }
 
-  myFile = SD.open("/config.txt", FILE_READ);
+  // The snapshot is only trusted while config.txt is byte for byte what it was built from
+  uint32_t sourceCrc = configSourceCrc();
+  if (readConfigSnapshot(config, sourceCrc)) {
+    Serial.println("Config loaded from config.bin snapshot");
+    replayJournal(config);
+    printSettings(config);
+    return config;
+  }
+
+  myFile = SD.open(CONFIG_PATH, FILE_READ);
   if (!myFile) {
     Serial.println("Failed to open config.txt");
     return config;
@@ -111,12 +599,17 @@ SystemConfig readSettings() {
   // Assign values directly from JSON
   config.serialMonitorBaud = String(doc["serialMonitorBaud"] | "115200").toInt();
   config.screenBaud = String(doc["screenBaud"] | "9600").toInt();
+  config.screenMaxBaud = String(doc["screenMaxBaud"] | "115200").toInt();
   config.motorPulsesPerRevolution = String(doc["motorPulsesPerRevolution"] | "1000").toInt();
   config.defaultUnit = getUnitFromString(String(doc["defaultUnit"] | "Undefined"));
   config.screenType = String(doc["screenType"] | "giga_shield");
   config.mechanismType = String(doc["mechanism"] | "belt");
   config.motorShaftVel = String(doc["motorShaftVelocity"] | "1000").toInt();
   config.motorShaftAccel = String(doc["motorShaftAcceleration"] | "10000").toInt();
+  config.motorShaftJerk = String(doc["motorShaftJerk"] | "0").toInt();
+  config.positionStreamRate = String(doc["positionStreamRate"] | "10").toInt();
+  config.configVersion = String(doc["configVersion"] | "0").toInt();
+  loadedConfigVersion = config.configVersion;
 
   if (!params.isNull()) {
     config.mechanismParams.unit1 = getUnitFromString(String(params["unit"] | "Undefined"));  // Pulley/pitch/diameter unit
@@ -139,33 +632,184 @@ SystemConfig readSettings() {
     }
   }
 
-  // Print out what's stored
-  Serial.println();
-  Serial.println("=== CONFIG LOADED ===");
-  Serial.println("Serial Baud: " + String(config.serialMonitorBaud));
-  Serial.println("Screen Baud: " + String(config.screenBaud));
-  Serial.println("Motor Pulses/Rev: " + String(config.motorPulsesPerRevolution));
-  Serial.println("Unit: " + String(getUnitString(config.defaultUnit)));
-  Serial.println("Screen Type: " + config.screenType);
-  Serial.println("Mechanism: " + config.mechanismType);
-  Serial.println("Motor Shaft Velocity: " + String(config.motorShaftVel));
-  Serial.println("Motor Shaft Acceleration: " + String(config.motorShaftAccel));
+  // Optional, older config files don't have it and get the homingConfig defaults
+  JsonObject homing = doc["homingParameters"].as<JsonObject>();
+  if (!homing.isNull()) {
+    config.homingParams.fastVelocity = String(homing["fastVelocity"] | "60").toInt();
+    config.homingParams.slowVelocity = String(homing["slowVelocity"] | "10").toInt();
+    config.homingParams.torqueLimit = String(homing["torqueLimit"] | "40").toFloat();
+    config.homingParams.backoff = String(homing["backoff"] | "0.25").toFloat();
+    config.homingParams.backoffUnit = getUnitFromString(homing["backoffUnit"] | "inches");
+    config.homingParams.timeoutMs = String(homing["timeout"] | "20000").toInt();
+  }
 
-  if (config.mechanismType == "belt") {
-    Serial.println("Pulley diameter: " + String(config.mechanismParams.pulleyDiameter));
-    Serial.println("Gearbox reduction: " + String(config.mechanismParams.gearboxReduction));
+  writeConfigSnapshot(config, sourceCrc);
 
-  } else if (config.mechanismType == "lead_screw") {
-    Serial.println("Leadscrew pitch: " + String(config.mechanismParams.screwPitch));
-    Serial.println("Gearbox reduction: " + String(config.mechanismParams.gearboxReduction));
-  } else if (config.mechanismType == "rack_pinion") {
-    Serial.println("Pinion diameter: " + String(config.mechanismParams.pinionDiameter));
-    Serial.println("Gearbox reduction: " + String(config.mechanismParams.gearboxReduction));
+  replayJournal(config);
+
+  printSettings(config);
+  return config;
+}
+
+
+bool readCutList(CutList &cutList) {
+  cutList.Clear();
+
+  if (!sdInit) {
+    Serial.println("SD card not initialized!");
+    return false;
   }
 
-  Serial.println("Max Travel: " + String(config.mechanismParams.maxTravel));
+  if (!SD.exists(CUTLIST_PATH)) {
+    return false;
+  }
 
-  Serial.println();
+  myFile = SD.open(CUTLIST_PATH, FILE_READ);
+  if (!myFile) {
+    Serial.println("Failed to open cutlist.txt");
+    return false;
+  }
 
-  return config;
+  StaticJsonDocument<2048> doc;
+  DeserializationError error = deserializeJson(doc, myFile);
+  myFile.close();
+
+  if (error) {
+    Serial.print("Failed to parse cut list JSON: ");
+    Serial.println(error.c_str());
+    return false;
+  }
+
+  JsonArray jobs = doc["jobs"].as<JsonArray>();
+  for (JsonObject job : jobs) {
+    float length = String(job["length"] | "0").toFloat();
+    UnitType unit = getUnitFromString(String(job["unit"] | "Undefined"));
+    int quantity = String(job["quantity"] | "1").toInt();
+    String remainingStr = String(job["remaining"] | "");
+    int remaining = remainingStr.length() > 0 ? remainingStr.toInt() : quantity;
+
+    if (!cutList.AddJob(length, unit, quantity, remaining)) {
+      Serial.println("Skipping invalid or overflowing cut list entry");
+    }
+  }
+
+  Serial.println("Cut list loaded: " + String(cutList.GetJobCount()) + " jobs, " + String(cutList.GetRemainingCuts()) + " cuts remaining");
+  return cutList.GetJobCount() > 0;
+}
+
+void writeCutList(const CutList &cutList) {
+  TraceScope scope(TRACE_SD_WRITE);
+
+  if (!sdInit) {
+    Serial.println("SD card not initialized!");
+    return;
+  }
+
+  // Same as config.txt, the new list goes to cutlist.tmp and only replaces cutlist.txt once it reads back
+  SD.remove(CUTLIST_TEMP_PATH);
+
+  myFile = SD.open(CUTLIST_TEMP_PATH, FILE_WRITE);
+  if (!myFile) {
+    Serial.println("Failed to open cutlist.tmp for writing");
+    return;
+  }
+
+  StaticJsonDocument<2048> doc;
+  JsonArray jobs = doc.createNestedArray("jobs");
+
+  for (int i = 0; i < cutList.GetJobCount(); i++) {
+    const CutJob &cutJob = cutList.GetJob(i);
+    JsonObject job = jobs.createNestedObject();
+    job["length"] = String(cutJob.length);
+    job["unit"] = getUnitWordStringFromUnit(cutJob.unit);
+    job["quantity"] = String(cutJob.quantity);
+    job["remaining"] = String(cutJob.remaining);
+  }
+
+  if (serializeJson(doc, myFile) == 0) {
+    Serial.println("Failed to write cut list to file");
+    myFile.close();
+    SD.remove(CUTLIST_TEMP_PATH);
+    return;
+  }
+  myFile.close();
+
+  replaceFile(CUTLIST_PATH, CUTLIST_TEMP_PATH, CUTLIST_BACKUP_PATH);
+}
+
+
+static bool applyCalibrationLine(CalibrationTable &table, const MechanismKinematics &kinematics, char *line, UnitType &unit) {
+  if (line[0] == '\0' || line[0] == '#') {
+    return true;
+  }
+
+  char *equals = strchr(line, '=');
+  if (equals != nullptr) {
+    *equals = '\0';
+    if (strcmp(line, "unit") == 0) {
+      unit = getUnitFromString(String(equals + 1));
+      return unit != UNIT_UNKNOWN;
+    }
+    if (strcmp(line, "approach") == 0) {
+      table.SetApproachSteps(kinematics.TargetToSteps(strtof(equals + 1, nullptr), unit));
+      return true;
+    }
+    return false;
+  }
+
+  char *end;
+  float commanded = strtof(line, &end);
+  if (end == line || *end != ',') {
+    return false;
+  }
+  char *measuredStart = end + 1;
+  float measured = strtof(measuredStart, &end);
+  if (end == measuredStart) {
+    return false;
+  }
+  return table.AddPoint(kinematics.TargetToSteps(commanded, unit), kinematics.TargetToSteps(measured, unit));
+}
+
+bool readCalibration(CalibrationTable &table, const MechanismKinematics &kinematics) {
+  table.Clear();
+
+  if (!sdInit || !SD.exists("/calibration.txt")) {
+    return false;
+  }
+
+  File file = SD.open("/calibration.txt", FILE_READ);
+  if (!file) {
+    Serial.println("Failed to open calibration.txt");
+    return false;
+  }
+
+  UnitType unit = UNIT_INCHES;
+  char line[64];
+  int length = 0;
+  int skipped = 0;
+  int c;
+  // One extra pass with c = -1 handles a last line without a newline
+  do {
+    c = file.read();
+    if (c == '\r') {
+      continue;
+    }
+    if (c >= 0 && c != '\n') {
+      if (length < (int)sizeof(line) - 1) {
+        line[length++] = (char)c;
+      }
+      continue;
+    }
+
+    line[length] = '\0';
+    if (!applyCalibrationLine(table, kinematics, line, unit)) {
+      skipped++;
+    }
+    length = 0;
+  } while (c >= 0);
+  file.close();
+
+  Serial.println("Calibration loaded: " + String(table.GetPointCount()) + " points, approach " + String(table.GetApproachSteps())
+                 + " steps (" + String(skipped) + " lines skipped)");
+  return table.GetPointCount() > 0 || table.GetApproachSteps() > 0;
 }
@@ -2,6 +2,8 @@
 
 #include <SD.h>
 #include "Utils.h"
+#include "CutListClasses.h"
+#include "MechanismClasses.h"
 
 struct mechanismConfig {
   // These fields vary based on the mechanism type
@@ -14,6 +16,14 @@ struct mechanismConfig {
   UnitType maxTravelUnit = UnitType::UNIT_UNKNOWN;
   float gearboxReduction = 1; // Example: 1 for 1:1
 };
+struct homingConfig {
+  int fastVelocity = 60;       // RPM, approach until the hardstop is found
+  int slowVelocity = 10;       // RPM, the touch that sets 0
+  float torqueLimit = 40.0f;   // % of peak torque on HLFB that counts as hitting the hardstop
+  float backoff = 0.25f;       // pulled back this far between the two approaches
+  UnitType backoffUnit = UnitType::UNIT_INCHES;
+  int timeoutMs = 20000;
+};
 #define ARDUINOJSON_ENABLE_PROGMEM 0
 #include "SDHelper.h"
 #include <ArduinoJson.h>
@@ -25,6 +35,7 @@ struct mechanismConfig {
 struct SystemConfig {
   int serialMonitorBaud = 115200; //default placeholders
   int screenBaud = 9600;
+  int screenMaxBaud = 115200; // the link is stepped up to this after the handshake, 0 = stay at screenBaud
   int motorPulsesPerRevolution = 1000;
   UnitType defaultUnit = UnitType::UNIT_UNKNOWN;
   String screenType = "giga_shield"; // "4d_systems" or "giga_shield"
@@ -32,9 +43,22 @@ struct SystemConfig {
   int motorShaftVel = 1000;
 
   int motorShaftAccel = 20000;
+
+  int motorShaftJerk = 0; // RPM/s^2, 0 = plain trapezoid moves
+
+  int positionStreamRate = 10; // Hz, live position frames to the screen during moves, 0 = off
   
   String mechanismType = "belt"; // "belt", "lead_screw", or "rack_pinion"
   mechanismConfig mechanismParams = mechanismConfig();
+  homingConfig homingParams = homingConfig();
+
+  int configVersion = 0; // bumped every time config.txt is rewritten, the previous version is kept in config.bak
+};
+
+// Settings the operator can change from the screen. These are journaled instead of rewriting config.txt on every press.
+enum ConfigField : uint16_t {
+  CONFIG_FIELD_DEFAULT_UNIT = 1 << 0,
+  CONFIG_FIELD_MAX_TRAVEL = 1 << 1  // maxTravel and maxTravelUnit
 };
 
 
@@ -44,5 +68,21 @@ extern bool sdInit;
 void initSDCard();
 
 
+// Full rewrite of config.txt through config.tmp, keeping the previous version in config.bak. Also compacts the journal.
 void writeSettings(SystemConfig writeConfig);
-SystemConfig readSettings();
\ No newline at end of file
+// Parses config.txt and replays config.jnl on top of it
+SystemConfig readSettings();
+
+// Deferred write-back: mark what changed, settingsPeriodic appends it to the journal once the changes settle
+void markSettingsDirty(uint16_t fields);
+void settingsPeriodic(const SystemConfig &currentConfig);
+void flushSettings(const SystemConfig &currentConfig);
+
+// Cut list lives in /cutlist.txt next to config.txt, rewritten through cutlist.tmp/cutlist.bak the same way
+bool readCutList(CutList &cutList);
+void writeCutList(const CutList &cutList);
+
+// Optional /calibration.txt, measured positions from a laser or tape run. Lines are "commanded,measured" in the
+// file's unit (unit=inches or unit=millimeters, before the points), plus approach=<distance> for backlash.
+// Returns false if there is no file or nothing usable in it, the table is left empty then.
+bool readCalibration(CalibrationTable &table, const MechanismKinematics &kinematics);
\ No newline at end of file
@@ -2,168 +2,591 @@
 #include <genieArduinoDEV.h>
 #include "ScreenClasses.h"
 #include "Utils.h"
+
+// Screen base class (shadow state):
+
+void Screen::SetStringLabel(SCREEN_OBJECT label, String str) {
+  if (label <= NONE || label >= SCREEN_OBJECT_COUNT) {
+    return;
+  }
+
+  LabelShadow &shadow = labelShadow[label];
+  str.toCharArray(shadow.pending, LABEL_SHADOW_SIZE);
+  shadow.dirty = !shadow.sentValid || strcmp(shadow.pending, shadow.sent) != 0;
+}
+
+void Screen::SetScreen(SCREEN screen) {
+  pendingScreen = screen;
+  screenDirty = true;
+}
+
+void Screen::FlushPending() {
+  // Labels first: on some displays a label write also changes the active screen, and the requested screen should win
+  for (int i = 0; i < SCREEN_OBJECT_COUNT; i++) {
+    LabelShadow &shadow = labelShadow[i];
+    if (!shadow.dirty) {
+      continue;
+    }
+    WriteStringLabel((SCREEN_OBJECT)i, shadow.pending);
+    strcpy(shadow.sent, shadow.pending);
+    shadow.sentValid = true;
+    shadow.dirty = false;
+  }
+
+  if (screenDirty) {
+    if (!sentScreenValid || pendingScreen != sentScreen) {
+      WriteScreen(pendingScreen);
+      NoteScreenShown(pendingScreen);
+    }
+    screenDirty = false;
+  }
+}
+
+// --- Input events ---
+
+// A repeat of the last dispatched object inside this window is dropped: double taps and bounce on the touch panel
+static uint32_t EventDebounceMs(SCREEN_OBJECT object) {
+  switch (object) {
+    case MEASURE_BUTTON:
+    case NEXT_CUT_BUTTON:
+      return 400;
+    case HOME_BUTTON:
+    case RESET_SERVO_BUTTON:
+      return 1000;
+    case KEYBOARD_VALUE_ENTER:     // every entry carries its own value
+    case INCHES_UNIT_BUTTON:       // the unit toggles are coalesced instead
+    case MILLIMETERS_UNIT_BUTTON:
+      return 0;
+    default:
+      return 150;
+  }
+}
+
+// Events that end up in a move (or homing) and so get spaced out by MOTION_MIN_INTERVAL_MS
+static bool IsMotionEvent(SCREEN_OBJECT object) {
+  return object == MEASURE_BUTTON || object == NEXT_CUT_BUTTON || object == HOME_BUTTON;
+}
+
+static bool IsUnitEvent(SCREEN_OBJECT object) {
+  return object == INCHES_UNIT_BUTTON || object == MILLIMETERS_UNIT_BUTTON;
+}
+
+void Screen::QueueEvent(SCREEN_OBJECT object, const char *text, uint8_t length) {
+  if (object <= NONE || object >= SCREEN_OBJECT_COUNT) {
+    return;
+  }
+
+  ScreenEvent event;
+  event.object = object;
+  event.timeMs = millis();
+  if (length >= ENTERED_TEXT_SIZE) {
+    length = ENTERED_TEXT_SIZE - 1;
+  }
+  if (text != nullptr) {
+    memcpy(event.text, text, length);
+  }
+  event.text[text != nullptr ? length : 0] = '\0';
+
+  if (!eventQueue.Push(event)) {
+    eventsOverflowed++;
+  }
+}
+
+bool Screen::IsSuperseded(const ScreenEvent &event) const {
+  // Only the last of a run of unit toggles matters, wherever it is in the queue
+  if (IsUnitEvent(event.object)) {
+    for (uint8_t i = 1; i < eventQueue.Count(); i++) {
+      if (IsUnitEvent(eventQueue.Peek(i).object)) {
+        return true;
+      }
+    }
+  }
+  // Two entries in a row, the first was never looked at
+  if (event.object == KEYBOARD_VALUE_ENTER && eventQueue.Count() > 1) {
+    return eventQueue.Peek(1).object == KEYBOARD_VALUE_ENTER;
+  }
+  return false;
+}
+
+void Screen::DispatchEvents() {
+  while (!eventQueue.IsEmpty()) {
+    const ScreenEvent &next = eventQueue.Peek();
+
+    if (IsSuperseded(next)) {
+      eventsCoalesced++;
+      eventQueue.Pop();
+      continue;
+    }
+
+    // Only a straight repeat is a bounce, MEASURE after a new target was entered is a real press
+    if (hasAccepted && next.object == lastAcceptedObject && next.timeMs - lastAcceptedMs < EventDebounceMs(next.object)) {
+      eventsDebounced++;
+      eventQueue.Pop();
+      continue;
+    }
+
+    // Too soon after the last move command: leave it at the front, everything behind waits so the order holds
+    if (IsMotionEvent(next.object) && hasMotion && millis() - lastMotionMs < MOTION_MIN_INTERVAL_MS) {
+      if (!motionWaiting) {
+        motionDeferrals++;
+        motionWaiting = true;
+      }
+      break;
+    }
+    motionWaiting = false;
+
+    ScreenEvent event = next;
+    eventQueue.Pop();
+
+    hasAccepted = true;
+    lastAcceptedObject = event.object;
+    lastAcceptedMs = event.timeMs;
+    if (IsMotionEvent(event.object)) {
+      lastMotionMs = millis();
+      hasMotion = true;
+    }
+    if (event.object == KEYBOARD_VALUE_ENTER) {
+      strcpy(enteredText, event.text);
+    }
+
+    eventsDispatched++;
+    if (eventCallback) {
+      eventCallback(event.object);
+    }
+  }
+}
+
+void Screen::PrintEventStats() const {
+  Serial.print("Screen events: ");
+  Serial.print(eventsDispatched);
+  Serial.print(" dispatched, ");
+  Serial.print(eventsDebounced);
+  Serial.print(" debounced, ");
+  Serial.print(eventsCoalesced);
+  Serial.print(" coalesced, ");
+  Serial.print(motionDeferrals);
+  Serial.print(" moves held back, ");
+  Serial.print(eventsOverflowed);
+  Serial.println(" lost to a full queue");
+}
+
+void Screen::InitAndConnect(UnitType defaultBootUnit) {
+  BeginConnect(defaultBootUnit);
+  while (PollConnect() == CONNECT_PENDING) {
+    delay(10);
+  }
+}
+
+void Screen::ResetShadowState() {
+  for (int i = 0; i < SCREEN_OBJECT_COUNT; i++) {
+    labelShadow[i].sentValid = false;
+    labelShadow[i].dirty = false;
+  }
+  sentScreenValid = false;
+  screenDirty = false;
+}
+
+void Screen::NoteScreenShown(SCREEN screen) {
+  sentScreen = screen;
+  sentScreenValid = true;
+}
+
 // GIGA screen class:
 
 //constructer
-ScreenGiga::ScreenGiga(float baud)
-  : baudRate(baud) {
+ScreenGiga::ScreenGiga(float baud, float maxBaud)
+  : baudRate(baud), maxBaudRate(maxBaud) {
   //We don not do any setup here since the constructor is not called in setup(). call InitAndConnect before any other screen method calls.
 }
 
-void ScreenGiga::InitAndConnect(UnitType defaultBootUnit) {
+void ScreenGiga::BeginConnect(UnitType defaultBootUnit) {
   enterPressed = false;
+  isConnected = false;
+  binaryMode = false;
+  ResetShadowState();
+  bootUnit = defaultBootUnit;
 
   Serial1.begin(baudRate);  // Serial 1 is the giga thin client interface that we send commands over
   Serial1.ttl(true);
-  delay(5000);  // wait for Giga to boot up
 
-  Serial.println("ClearCore ready, sending HELLO");
+  // No fixed wait for the Giga to boot, PollConnect keeps saying HELLO until it answers
+  lineLength = 0;
+  lineOverflowed = false;
+  helloSent = false;
+  connectStartMs = millis();
+  connectState = CONNECT_PENDING;
 
-  //Handshake to the giga. 10 sec timeout, and the giga will have no timeout and will wait for the clearcore to connect and start the handshake
-  String inputBuffer = "";
-  unsigned long startTime = millis();
-  bool handshakeDone = false;
+  UpdateLinkTiming();
+  positionStreaming = false;
 
-  Serial.println("Waiting for Giga handshake response...");
-  while (millis() - startTime < 10000) {  // 10 second timeout
-    Serial1.println("HELLO");             // send HELLO to Giga
-    while (Serial1.available()) {
-      char c = Serial1.read();
+  Serial.println("ClearCore ready, waiting for Giga handshake response...");
+}
 
-      //Debugging, show what was received character by character
-      // Serial.print("RX char: ");
-      // Serial.println(c);
+void ScreenGiga::UpdateLinkTiming() {
+  // 10 bits on the wire per byte, a key frame is the largest position frame
+  uint32_t keyFrameBits = (POSITION_KEY_LENGTH + FRAME_OVERHEAD) * 10;
+  positionMinIntervalMs = (keyFrameBits * 1000UL * 100 / POSITION_LINK_SHARE_PERCENT + (uint32_t)baudRate - 1) / (uint32_t)baudRate;
+}
 
-      if (c == '\n' || c == '\r') {
-        // end of line
-        inputBuffer.trim();  // remove spaces
+Screen::ConnectState ScreenGiga::PollConnect() {
+  if (connectState != CONNECT_PENDING) {
+    return connectState;
+  }
 
+  // Handshake done, stepping the link speed up before anything else goes out
+  if (linkNegotiator.IsRunning()) {
+    ReadFrames();
+    if (linkNegotiator.Poll()) {
+      return connectState;
+    }
+    baudRate = linkNegotiator.GetBaud();
+    UpdateLinkTiming();
+    linkNegotiator.PrintResults();
+    return FinishConnect(CONNECT_DONE);
+  }
 
-        //debugging, show full recieved line buffer
-        // Serial.print("RX line: ");
-        // Serial.println(inputBuffer);
+  uint32_t elapsed = millis() - connectStartMs;
 
-        if (inputBuffer == "ACK") {
-          Serial.println("Received ACK from Giga!");
-          handshakeDone = true;
-          break;
-        }
-        // clear buffer for next line
-        inputBuffer = "";
-      } else {
-        inputBuffer += c;
+  if (!helloSent || millis() - lastHelloMs >= HANDSHAKE_RETRY_MS) {
+    if (elapsed < HANDSHAKE_BINARY_OFFER_MS) {
+      Serial1.println(FRAME_HELLO_TEXT);
+    } else {
+      Serial1.println("HELLO");  // send HELLO to Giga
+    }
+    lastHelloMs = millis();
+    helloSent = true;
+  }
+
+  bool handshakeDone = false;
+  while (Serial1.available() && !handshakeDone) {
+    char c = Serial1.read();
+
+    if (c == '\n' || c == '\r') {
+      lineBuffer[lineLength] = '\0';  // room is always left for this below
+
+      if (strcmp(lineBuffer, FRAME_ACK_TEXT) == 0) {
+        Serial.println("Received ACK from Giga, using binary frames!");
+        binaryMode = true;
+        handshakeDone = true;
+      } else if (strcmp(lineBuffer, "ACK") == 0) {
+        Serial.println("Received ACK from Giga!");
+        handshakeDone = true;
       }
+      // clear buffer for next line
+      lineLength = 0;
+    } else if (isPrintable(c) && !isspace(c) && lineLength < LINE_BUFFER_SIZE - 1) {
+      lineBuffer[lineLength++] = c;
     }
+  }
 
-    if (handshakeDone) break;
-    delay(100);
+  if (handshakeDone) {
+    Serial.print("Handshake complete after ");
+    Serial.print(millis() - connectStartMs);
+    Serial.println(" ms.");
+    if (binaryMode && maxBaudRate > baudRate) {
+      linkNegotiator.Start(frameWriter, frameParser, (uint32_t)baudRate, (uint32_t)maxBaudRate, false);
+      if (linkNegotiator.IsRunning()) {
+        return connectState;
+      }
+    }
+    return FinishConnect(CONNECT_DONE);
+  } else if (elapsed >= HANDSHAKE_TIMEOUT_MS) {
+    Serial.println("Handshake timed out, no ACK received.");
+    return FinishConnect(CONNECT_TIMED_OUT);
   }
+  return connectState;
+}
+
+Screen::ConnectState ScreenGiga::FinishConnect(ConnectState state) {
+  isConnected = state == CONNECT_DONE;
+  connectState = state;
 
-  if (defaultBootUnit == UNIT_MILLIMETERS) {
-    Serial1.println("SETSWITCHTOSTATE:12");
+  if (bootUnit == UNIT_MILLIMETERS) {
+    SetSwitchState(MILLIMETERS_UNIT_BUTTON);
     Serial.println("Switching to millimeters");
-  } else if (defaultBootUnit == UNIT_INCHES) {
-    Serial1.println("SETSWITCHTOSTATE:11");
+  } else if (bootUnit == UNIT_INCHES) {
+    SetSwitchState(INCHES_UNIT_BUTTON);
     Serial.println("Switching to inches");
   }
 
-  if (!handshakeDone) {
-    Serial.println("Handshake timed out, no ACK received.");
-  } else {
-    Serial.println("Handshake complete.");
-  }
+  return connectState;
 }
 
 
 
 String ScreenGiga::GetParameterInputValue() {
-  return lastEntered;
+  return enteredText;
 }
 
 float ScreenGiga::GetParameterEnteredAsFloat() {
-  String raw = GetParameterInputValue();
-  float val = raw.toFloat();
-  if (val == 0.0 && !raw.startsWith("0")) {
-    Serial.println("Invalid float input: " + raw);
+  float val = atof(enteredText);
+  if (val == 0.0 && enteredText[0] != '0') {
+    Serial.print("Invalid float input: ");
+    Serial.println(enteredText);
     return 0.0;
   }
   return val;
 }
 
-void ScreenGiga::SetStringLabel(SCREEN_OBJECT label, String str) {
+void ScreenGiga::WriteStringLabel(SCREEN_OBJECT label, const char *str) {
   //Send the object index defined in the enum in h file, The giga code determines if it is a valid label object
-  Serial1.print("SETLABEL:");
-  Serial1.print((int)label);
-  Serial1.print(":");
-  Serial1.println(str);
+  if (binaryMode) {
+    frameWriter.SendIndexedText(Serial1, FRAME_SET_LABEL, (uint8_t)label, str);
+  } else {
+    Serial1.print("SETLABEL:");
+    Serial1.print((int)label);
+    Serial1.print(":");
+    Serial1.println(str);
+  }
 }
 
-void ScreenGiga::SetScreen(SCREEN screen) {
+void ScreenGiga::WriteScreen(SCREEN screen) {
+  if (binaryMode) {
+    frameWriter.SendIndex(Serial1, FRAME_SET_SCREEN, (uint8_t)screen);
+    return;
+  }
   Serial1.print("SETSCREEN:");
   Serial1.println((int)screen);  // add newline to mark message end!
 }
 
+void ScreenGiga::StreamPosition(int32_t position, int32_t start, int32_t target, UnitType unit, bool moving) {
+  // The text protocol Gigas only ever get the target label
+  if (!binaryMode || linkNegotiator.IsRunning()) {
+    return;
+  }
+
+  uint8_t payload[POSITION_KEY_LENGTH];
+  uint8_t length;
+  bool key = false;
+
+  if (!moving) {
+    if (!positionStreaming) {
+      return;
+    }
+    payload[0] = POSITION_END;
+    FramePutI32(payload + 1, position);
+    length = POSITION_END_LENGTH;
+  } else {
+    if (positionStreaming && millis() - lastPositionFrameMs < positionMinIntervalMs) {
+      return;
+    }
+
+    int32_t delta = position - sentPosition;
+    key = !positionStreaming || start != sentStart || target != sentTarget || unit != sentUnit
+          || deltasSinceKey >= POSITION_KEY_INTERVAL || delta < INT16_MIN || delta > INT16_MAX;
+    if (key) {
+      payload[0] = POSITION_KEY;
+      FramePutI32(payload + 1, position);
+      FramePutI32(payload + 5, start);
+      FramePutI32(payload + 9, target);
+      payload[13] = (uint8_t)unit;
+      length = POSITION_KEY_LENGTH;
+    } else if (delta == 0) {
+      return;
+    } else {
+      payload[0] = POSITION_DELTA;
+      FramePutI16(payload + 1, (int16_t)delta);
+      length = POSITION_DELTA_LENGTH;
+    }
+  }
+
+  // Never block the loop on a full transmit buffer, the next sample goes out instead. A skipped END is retried on
+  // the next call since positionStreaming stays set.
+  if (Serial1.availableForWrite() < length + FRAME_OVERHEAD) {
+    return;
+  }
+  frameWriter.Send(Serial1, FRAME_POSITION, payload, length);
+
+  lastPositionFrameMs = millis();
+  sentPosition = position;
+  positionStreaming = moving;
+  if (key) {
+    sentStart = start;
+    sentTarget = target;
+    sentUnit = unit;
+    deltasSinceKey = 0;
+  } else {
+    deltasSinceKey++;
+  }
+}
+
+void ScreenGiga::SetSwitchState(SCREEN_OBJECT obj) {
+  // it takes in the button index (11 is inches, 12 is millimeters) and the giga maps it to the on/off switch
+  if (binaryMode) {
+    frameWriter.SendIndex(Serial1, FRAME_SET_SWITCH, (uint8_t)obj);
+    return;
+  }
+  Serial1.print("SETSWITCHTOSTATE:");
+  Serial1.println((int)obj);
+}
+
+void ScreenGiga::DispatchButton(int btnIndex) {
+  SCREEN_OBJECT btnEvent = NONE;
+  switch (btnIndex) {
+    case 2: btnEvent = MEASURE_BUTTON; break;
+    case 3: btnEvent = EDIT_TARGET_BUTTON; break;
+    case 4: btnEvent = HOME_BUTTON; break;
+    case 5: btnEvent = RESET_SERVO_BUTTON; break;
+    case 6: btnEvent = SETTINGS_BUTTON; break;
+    case 7: btnEvent = EDIT_MAX_TRAVEL_BUTTON; break;
+    case 10: btnEvent = EXIT_SETTINGS_BUTTON; break;
+    case 11: btnEvent = INCHES_UNIT_BUTTON; break;
+    case 12: btnEvent = MILLIMETERS_UNIT_BUTTON; break;
+    case 13: btnEvent = NEXT_CUT_BUTTON; break;
+    default: btnEvent = NONE; break;
+  }
+
+  if (btnEvent != NONE) {
+    QueueEvent(btnEvent);
+  }
+}
+
+void ScreenGiga::DispatchEnter(const char *value, uint8_t length) {
+  QueueEvent(KEYBOARD_VALUE_ENTER, value, length);
+}
+
+void ScreenGiga::HandleFrame(const Frame &frame) {
+  if (linkNegotiator.HandleFrame(frame)) {
+    return;
+  }
+
+  switch (frame.type) {
+    case FRAME_BUTTON:
+      if (frame.length >= 1) {
+        DispatchButton(frame.payload[0]);
+      }
+      break;
+    case FRAME_ENTER:
+      DispatchEnter((const char *)frame.payload, frame.length);
+      break;
+    default:
+      Serial.print("Unknown frame type from Giga: ");
+      Serial.println(frame.type);
+      break;
+  }
+}
+
+void ScreenGiga::ReadFrames() {
+  while (Serial1.available()) {
+    if (frameParser.Feed((uint8_t)Serial1.read())) {
+      do {
+        HandleFrame(frameParser.GetFrame());
+      } while (frameParser.Next());
+    }
+  }
+}
+
+void ScreenGiga::StartLinkBenchmark() {
+  if (!binaryMode) {
+    Serial.println("Link benchmark needs the binary protocol.");
+    return;
+  }
+  if (linkNegotiator.IsRunning()) {
+    return;
+  }
+  uint32_t maxBaud = (uint32_t)max(maxBaudRate, baudRate);
+  linkNegotiator.Start(frameWriter, frameParser, (uint32_t)baudRate, maxBaud, true);
+}
+
 void ScreenGiga::ScreenPeriodic() {
-  static String inputBuffer = "";
+  bool negotiating = linkNegotiator.IsRunning();  // before reading, the last reply can finish it
+  if (binaryMode) {
+    ReadFrames();
+  } else {
+    ReadTextLines();
+  }
+
+  if (negotiating) {
+    // Labels, screens and button events wait, a frame sent mid trial could go out at the wrong rate
+    if (linkNegotiator.Poll()) {
+      return;
+    }
+    baudRate = linkNegotiator.GetBaud();
+    UpdateLinkTiming();
+    linkNegotiator.PrintResults();
+  }
 
+  DispatchEvents();
+  // Everything the event callbacks changed this tick goes out in one flush
+  FlushPending();
+}
+
+void ScreenGiga::ReadTextLines() {
   while (Serial1.available()) {
     char c = Serial1.read();
 
     if (c == '\n' || c == '\r') {
-      inputBuffer.trim();
-
-      if (inputBuffer.length() > 0) {
-        // ----- Process message -----
-        if (inputBuffer.startsWith("BUTTON:")) {
-          String btnStr = inputBuffer.substring(7);
-          btnStr.trim();
-
-          bool validNumber = true;
-          for (int i = 0; i < btnStr.length(); i++) {
-            if (!isdigit(btnStr.charAt(i))) {
-              validNumber = false;
-              break;
-            }
-          }
-
-          if (validNumber && btnStr.length() > 0) {
-            int btnIndex = btnStr.toInt();
-
-            SCREEN_OBJECT btnEvent = NONE;
-            switch (btnIndex) {
-              case 2: btnEvent = MEASURE_BUTTON; break;
-              case 3: btnEvent = EDIT_TARGET_BUTTON; break;
-              case 4: btnEvent = HOME_BUTTON; break;
-              case 5: btnEvent = RESET_SERVO_BUTTON; break;
-              case 6: btnEvent = SETTINGS_BUTTON; break;
-              case 7: btnEvent = EDIT_MAX_TRAVEL_BUTTON; break;
-              case 10: btnEvent = EXIT_SETTINGS_BUTTON; break;
-              case 11: btnEvent = INCHES_UNIT_BUTTON; break;
-              case 12: btnEvent = MILLIMETERS_UNIT_BUTTON; break;
-              default: btnEvent = NONE; break;
-            }
-
-            if (btnEvent != NONE && eventCallback) {
-              eventCallback(btnEvent);
-            }
-          }
-        } else if (inputBuffer.startsWith("ENTER:")) {
-          inputBuffer = inputBuffer.substring(6);
-          lastEntered = inputBuffer;
-          if (eventCallback) {
-            eventCallback(KEYBOARD_VALUE_ENTER);
-          }
-        }
+      // A line longer than the buffer can't be a valid command, drop it whole instead of parsing a truncated copy
+      if (!lineOverflowed) {
+        HandleLine(lineBuffer, lineLength);
       }
 
       // Always clear buffer after newline
-      inputBuffer = "";
+      lineLength = 0;
+      lineOverflowed = false;
     } else if (isPrintable(c)) {
-      inputBuffer += c;
+      if (lineLength < LINE_BUFFER_SIZE) {
+        lineBuffer[lineLength++] = c;
+      } else {
+        lineOverflowed = true;
+      }
     }
   }
 }
 
+const ScreenGiga::TextCommand ScreenGiga::textCommands[] = {
+  { "BUTTON:", 7, &ScreenGiga::HandleButtonCommand },
+  { "ENTER:", 6, &ScreenGiga::HandleEnterCommand }
+};
+
+void ScreenGiga::HandleLine(const char *line, uint8_t length) {
+  // trim, without copying
+  while (length > 0 && isspace(line[0])) {
+    line++;
+    length--;
+  }
+  while (length > 0 && isspace(line[length - 1])) {
+    length--;
+  }
+  if (length == 0) {
+    return;
+  }
+
+  for (const TextCommand &command : textCommands) {
+    if (length >= command.prefixLength && memcmp(line, command.prefix, command.prefixLength) == 0) {
+      (this->*command.handler)(line + command.prefixLength, length - command.prefixLength);
+      return;
+    }
+  }
+}
+
+void ScreenGiga::HandleButtonCommand(const char *arg, uint8_t length) {
+  while (length > 0 && isspace(arg[0])) {
+    arg++;
+    length--;
+  }
+  if (length == 0) {
+    return;
+  }
+
+  int btnIndex = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    if (!isdigit(arg[i])) {
+      return;
+    }
+    btnIndex = btnIndex * 10 + (arg[i] - '0');
+    if (btnIndex > 255) {
+      return;
+    }
+  }
+
+  DispatchButton(btnIndex);
+}
+
+void ScreenGiga::HandleEnterCommand(const char *arg, uint8_t length) {
+  DispatchEnter(arg, length);
+}
+
 
 
 void ScreenGiga::RegisterEventCallback(ScreenEventCallback callback) {
@@ -3,6 +3,9 @@
 #include <genieArduinoDEV.h>
 #include "ScreenClasses.h"
 #include "Utils.h"
+#include "FrameProtocol.h"
+#include "EventQueue.h"
+#include "LinkNegotiator.h"
 
 //Way for the main ino code to at a high level tell whatever implementation a screen object and vise versa to get values.
 //ONLY objects that need to be set/get accessed, not static labels for example.
@@ -20,7 +23,9 @@ enum SCREEN_OBJECT {
   KEYBOARD_VALUE_ENTER, //9 //flag to detect when the user has entered a value and to store the buffer that has been saved until the value is safely retrieved
   EXIT_SETTINGS_BUTTON, //10
   INCHES_UNIT_BUTTON, //11 We treat 11 and 12 as seperate objects so it is easy to implement in the high level code that a event was fired from this (regardless that it is a toggle switch)
-  MILLIMETERS_UNIT_BUTTON //12
+  MILLIMETERS_UNIT_BUTTON, //12
+  NEXT_CUT_BUTTON, //13 Advances the cut list to the next queued length
+  SCREEN_OBJECT_COUNT //Not an object, keep last. Sizes the per object shadow state in Screen
 };
 
 enum SCREEN {
@@ -35,19 +40,40 @@ enum SCREEN {
 
 class Screen {
 public:
-  virtual void SetStringLabel(SCREEN_OBJECT label, String str);
-  virtual void SetScreen(SCREEN screen);
-
-  virtual void ScreenPeriodic() {}
+  // These only record the new value. Anything that differs from what the display already shows is written
+  // out by FlushPending (called from ScreenPeriodic), so a burst of UI changes in one tick costs one transfer.
+  void SetStringLabel(SCREEN_OBJECT label, String str);
+  void SetScreen(SCREEN screen);
+  SCREEN GetScreen() const { return pendingScreen; }  // Last screen asked for, shown or not
+  void FlushPending();
+
+  virtual void ScreenPeriodic() {
+    DispatchEvents();
+    FlushPending();
+  }
 
   typedef void (*ScreenEventCallback)(SCREEN_OBJECT object);
-  virtual void RegisterEventCallback(ScreenEventCallback callback);
+  virtual void RegisterEventCallback(ScreenEventCallback callback) = 0;
 
   // Input handling interface
-  virtual String GetParameterInputValue();     // Gets current input and clears buffer
-  virtual float GetParameterEnteredAsFloat();  // Converts buffer to float
+  virtual String GetParameterInputValue() = 0;     // Gets current input and clears buffer
+  virtual float GetParameterEnteredAsFloat() = 0;  // Converts buffer to float
+
+  enum ConnectState {
+    CONNECT_PENDING,
+    CONNECT_DONE,
+    CONNECT_TIMED_OUT
+  };
 
-  virtual void InitAndConnect(UnitType defaultBootUnit);
+  // Non-blocking handshake: BeginConnect once, then PollConnect until it stops returning CONNECT_PENDING
+  virtual void BeginConnect(UnitType defaultBootUnit) = 0;
+  virtual ConnectState PollConnect() = 0;
+  // Blocking wrapper around BeginConnect/PollConnect
+  void InitAndConnect(UnitType defaultBootUnit);
+
+  // Live fence position while it moves, positions in hundredths of unit. Called at the configured stream rate, and
+  // once more with moving false when the move is over. Screens without a live readout just ignore it.
+  virtual void StreamPosition(int32_t position, int32_t start, int32_t target, UnitType unit, bool moving) {}
 
   bool GetIsConnected(){
     return isConnected;
@@ -56,22 +82,141 @@ public:
   bool GetKeyboardEnterPressed(){
     return enterPressed;
   }
+
+  void PrintEventStats() const;
 protected:
   ScreenEventCallback eventCallback = nullptr;
   bool enterPressed = false;
   bool isConnected = false;
+
+  // Input goes through a queue instead of straight to eventCallback. The parser queues what the display sent and
+  // DispatchEvents hands it on after debouncing repeats, coalescing superseded events and spacing out the ones
+  // that move the motor, so a double tap can't turn into back to back stop/start sequences.
+  static const uint8_t ENTERED_TEXT_SIZE = 24;
+  void QueueEvent(SCREEN_OBJECT object, const char *text = nullptr, uint8_t length = 0);
+  void DispatchEvents();
+  char enteredText[ENTERED_TEXT_SIZE] = "0.00";  // value of the last KEYBOARD_VALUE_ENTER handed to the callback
+
+  // Implementation specific writes, only called by FlushPending
+  virtual void WriteStringLabel(SCREEN_OBJECT label, const char *str) = 0;
+  virtual void WriteScreen(SCREEN screen) = 0;
+
+  // Forget what the display shows (after a (re)connect) so the next flush rewrites everything
+  void ResetShadowState();
+  // For implementations where a write has side effects on the active screen
+  void NoteScreenShown(SCREEN screen);
+
+private:
+  static const uint8_t LABEL_SHADOW_SIZE = 32;
+
+  struct ScreenEvent {
+    SCREEN_OBJECT object;
+    uint32_t timeMs;  // when it came in, debouncing goes by this rather than when it is dispatched
+    char text[ENTERED_TEXT_SIZE];
+  };
+
+  static const uint8_t EVENT_QUEUE_SIZE = 16;
+  static const uint32_t MOTION_MIN_INTERVAL_MS = 400;  // between events that start the motor moving
+  SpscQueue<ScreenEvent, EVENT_QUEUE_SIZE> eventQueue;
+  SCREEN_OBJECT lastAcceptedObject = NONE;
+  uint32_t lastAcceptedMs = 0;
+  bool hasAccepted = false;
+  uint32_t lastMotionMs = 0;
+  bool hasMotion = false;
+  bool motionWaiting = false;
+
+  uint32_t eventsDispatched = 0;
+  uint32_t eventsDebounced = 0;
+  uint32_t eventsCoalesced = 0;
+  uint32_t eventsOverflowed = 0;
+  uint32_t motionDeferrals = 0;
+
+  bool IsSuperseded(const ScreenEvent &event) const;
+
+  struct LabelShadow {
+    char sent[LABEL_SHADOW_SIZE] = "";
+    char pending[LABEL_SHADOW_SIZE] = "";
+    bool sentValid = false;
+    bool dirty = false;
+  };
+
+  LabelShadow labelShadow[SCREEN_OBJECT_COUNT];
+
+  SCREEN sentScreen = SPLASH_SCREEN;
+  SCREEN pendingScreen = SPLASH_SCREEN;
+  bool sentScreenValid = false;
+  bool screenDirty = false;
 };
 
 
 class ScreenGiga : public Screen {
 private:
   float baudRate;
+  float maxBaudRate;  // highest rate to negotiate up to after a binary handshake, 0 stays on baudRate
+  LinkNegotiator linkNegotiator;
+
+  // Set when the Giga answers the handshake with FRAME_ACK_TEXT, otherwise the text protocol is used
+  bool binaryMode = false;
+  FrameWriter frameWriter;
+  FrameParser frameParser;
+
+  // Handshake. The Giga has no timeout and waits for us to start it, so we keep sending HELLO until it answers.
+  static const uint32_t HANDSHAKE_TIMEOUT_MS = 15000;
+  static const uint32_t HANDSHAKE_BINARY_OFFER_MS = 10000;  // then fall back to a plain HELLO for text-only Gigas
+  static const uint32_t HANDSHAKE_RETRY_MS = 100;
+  ConnectState connectState = CONNECT_PENDING;
+  UnitType bootUnit = UNIT_UNKNOWN;
+  uint32_t connectStartMs = 0;
+  uint32_t lastHelloMs = 0;
+  bool helloSent = false;
+
+  // Position stream. Frames are spaced so they never take more than POSITION_LINK_SHARE_PERCENT of the link (at
+  // 9600 baud that is ~12 frames a second) and a full key frame goes out every POSITION_KEY_INTERVAL deltas.
+  static const uint8_t POSITION_LINK_SHARE_PERCENT = 25;
+  static const uint8_t POSITION_KEY_INTERVAL = 8;
+  uint32_t positionMinIntervalMs = 0;
+  uint32_t lastPositionFrameMs = 0;
+  bool positionStreaming = false;  // a move is being streamed, it still needs its END frame
+  int32_t sentPosition = 0;
+  int32_t sentStart = 0;
+  int32_t sentTarget = 0;
+  UnitType sentUnit = UNIT_UNKNOWN;
+  uint8_t deltasSinceKey = 0;
+  void UpdateLinkTiming();
+
+  // Text protocol line assembly. Fixed size and parsed in place so the periodic path never touches the heap.
+  static const uint8_t LINE_BUFFER_SIZE = 64;
+  char lineBuffer[LINE_BUFFER_SIZE];
+  uint8_t lineLength = 0;
+  bool lineOverflowed = false;
+
+  typedef void (ScreenGiga::*TextCommandHandler)(const char *arg, uint8_t length);
+  struct TextCommand {
+    const char *prefix;
+    uint8_t prefixLength;
+    TextCommandHandler handler;
+  };
+  static const TextCommand textCommands[];
+
+  void SetSwitchState(SCREEN_OBJECT obj);
+  void DispatchButton(int btnIndex);
+  void DispatchEnter(const char *value, uint8_t length);
+  void HandleFrame(const Frame &frame);
+  void ReadFrames();
+  ConnectState FinishConnect(ConnectState state);
+  void ReadTextLines();
+  void HandleLine(const char *line, uint8_t length);
+  void HandleButtonCommand(const char *arg, uint8_t length);
+  void HandleEnterCommand(const char *arg, uint8_t length);
+
+protected:
+  void WriteStringLabel(SCREEN_OBJECT label, const char *str) override;
+  void WriteScreen(SCREEN screen) override;
+
 public:
-  ScreenGiga(float baud);
+  ScreenGiga(float baud, float maxBaud = 0);
 
   // Screen interface overrides
-  void SetStringLabel(SCREEN_OBJECT label, String str) override;
-  void SetScreen(SCREEN screen) override;
   void ScreenPeriodic() override;
 
   // Input handling interface
@@ -80,7 +225,17 @@ public:
 
   void RegisterEventCallback(ScreenEventCallback callback) override;
 
-  void InitAndConnect(UnitType defaultBootUnit) override;
+  void BeginConnect(UnitType defaultBootUnit) override;
+  ConnectState PollConnect() override;
+
+  void StreamPosition(int32_t position, int32_t start, int32_t target, UnitType unit, bool moving) override;
+
+  // Walks the link through every rate from the bottom up to maxBaud and prints round trip times and throughput.
+  // Screen traffic waits until it is done, the link is left on the fastest clean rate.
+  void StartLinkBenchmark();
+
+  bool GetIsBinaryMode() const {
+    return binaryMode;
+  }
 
-  String lastEntered = "0.00";
 };
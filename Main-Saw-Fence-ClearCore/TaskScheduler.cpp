@@ -0,0 +1,188 @@
+#include <Arduino.h>
+#include "TaskScheduler.h"
+
+int TaskScheduler::AddPeriodic(const char *name, TaskFn fn, uint32_t periodUs, uint32_t deadlineUs) {
+  if (taskCount >= MAX_TASKS) {
+    Serial.println("TaskScheduler: too many tasks");
+    return -1;
+  }
+
+  Task &task = tasks[taskCount];
+  memset(&task, 0, sizeof(task));
+  task.name = name;
+  task.fn = fn;
+  task.periodUs = periodUs;
+  task.deadlineUs = (deadlineUs == 0 || deadlineUs > periodUs) ? periodUs : deadlineUs;
+  task.releaseUs = micros();
+  if (taskCount == 0) {
+    statsStartUs = task.releaseUs;
+  }
+  return taskCount++;
+}
+
+bool TaskScheduler::StartTimer(TaskFn fn, uint32_t delayMs) {
+  Timer *slot = nullptr;
+  for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+    if (timers[i].fn == fn) {
+      slot = &timers[i];
+      break;
+    }
+    if (slot == nullptr && timers[i].fn == nullptr) {
+      slot = &timers[i];
+    }
+  }
+  if (slot == nullptr) {
+    Serial.println("TaskScheduler: no free timer");
+    return false;
+  }
+
+  slot->fn = fn;
+  slot->startMs = millis();
+  slot->delayMs = delayMs;
+  return true;
+}
+
+void TaskScheduler::CancelTimer(TaskFn fn) {
+  for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+    if (timers[i].fn == fn) {
+      timers[i].fn = nullptr;
+    }
+  }
+}
+
+bool TaskScheduler::IsTimerPending(TaskFn fn) const {
+  for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+    if (timers[i].fn == fn) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskScheduler::RunTask(Task &task, uint32_t now) {
+  uint32_t lateness = now - task.releaseUs;
+  task.fn();
+  uint32_t end = micros();
+  uint32_t runUs = end - now;
+
+  task.runs++;
+  task.totalRunUs += runUs;
+  task.maxRunUs = max(task.maxRunUs, runUs);
+  task.maxLatenessUs = max(task.maxLatenessUs, lateness);
+  if (end - task.releaseUs > task.deadlineUs) {
+    task.deadlineMisses++;
+  }
+
+  // Next period, unless the task is so late that releases were missed entirely. Those are dropped instead of
+  // run back to back to catch up.
+  task.releaseUs += task.periodUs;
+  if ((int32_t)(end - task.releaseUs) >= (int32_t)task.periodUs) {
+    uint32_t behind = (end - task.releaseUs) / task.periodUs;
+    task.skippedReleases += behind;
+    task.releaseUs += behind * task.periodUs;
+  }
+}
+
+void TaskScheduler::RunDue() {
+  // Timers first, they are what puts the UI back together after a popup
+  for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+    Timer &timer = timers[i];
+    if (timer.fn != nullptr && millis() - timer.startMs >= timer.delayMs) {
+      TaskFn fn = timer.fn;
+      timer.fn = nullptr;  // free before running, so the callback can start it again
+      fn();
+    }
+  }
+
+  uint8_t ranMask = 0;
+  while (true) {
+    uint32_t now = micros();
+    Task *next = nullptr;
+    int32_t nextSlack = 0;
+    for (uint8_t i = 0; i < taskCount; i++) {
+      Task &task = tasks[i];
+      if ((ranMask & (1 << i)) || (int32_t)(now - task.releaseUs) < 0) {
+        continue;
+      }
+      int32_t slack = (int32_t)(task.releaseUs + task.deadlineUs - now);
+      if (next == nullptr || slack < nextSlack) {
+        next = &task;
+        nextSlack = slack;
+      }
+    }
+    if (next == nullptr) {
+      break;
+    }
+    ranMask |= 1 << (next - tasks);
+    RunTask(*next, now);
+  }
+}
+
+void TaskScheduler::Idle() {
+  uint32_t now = micros();
+  uint32_t sleepUs = MAX_IDLE_US;
+
+  for (uint8_t i = 0; i < taskCount; i++) {
+    int32_t untilRelease = (int32_t)(tasks[i].releaseUs - now);
+    if (untilRelease <= 0) {
+      return;
+    }
+    sleepUs = min(sleepUs, (uint32_t)untilRelease);
+  }
+  for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+    if (timers[i].fn != nullptr) {
+      int32_t untilFire = (int32_t)(timers[i].delayMs - (millis() - timers[i].startMs)) * 1000;
+      if (untilFire <= 0) {
+        return;
+      }
+      sleepUs = min(sleepUs, (uint32_t)untilFire);
+    }
+  }
+
+  delayMicroseconds(sleepUs);
+  idleUs += micros() - now;
+}
+
+void TaskScheduler::ClearStats() {
+  for (uint8_t i = 0; i < taskCount; i++) {
+    Task &task = tasks[i];
+    task.runs = 0;
+    task.deadlineMisses = 0;
+    task.skippedReleases = 0;
+    task.maxLatenessUs = 0;
+    task.maxRunUs = 0;
+    task.totalRunUs = 0;
+  }
+  idleUs = 0;
+  statsStartUs = micros();
+}
+
+void TaskScheduler::PrintStats() const {
+  uint32_t elapsedUs = micros() - statsStartUs;
+
+  Serial.println();
+  Serial.println("=== SCHEDULER (us) ===");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    const Task &task = tasks[i];
+    Serial.print(task.name);
+    Serial.print(": period ");
+    Serial.print(task.periodUs);
+    Serial.print(", runs ");
+    Serial.print(task.runs);
+    Serial.print(", avg run ");
+    Serial.print(task.runs > 0 ? (uint32_t)(task.totalRunUs / task.runs) : 0);
+    Serial.print(", max run ");
+    Serial.print(task.maxRunUs);
+    Serial.print(", max late ");
+    Serial.print(task.maxLatenessUs);
+    Serial.print(", missed ");
+    Serial.print(task.deadlineMisses);
+    Serial.print(", skipped ");
+    Serial.println(task.skippedReleases);
+  }
+  Serial.print("Idle: ");
+  Serial.print(elapsedUs > 0 ? (float)(idleUs * 100.0 / elapsedUs) : 0.0f);
+  Serial.print("% of ");
+  Serial.print(elapsedUs / 1000);
+  Serial.println(" ms");
+}
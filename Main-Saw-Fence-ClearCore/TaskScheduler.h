@@ -0,0 +1,64 @@
+#pragma once
+#include <Arduino.h>
+
+// Cooperative scheduler for loop(). Periodic tasks are released every period and, when several are due at once, run
+// earliest deadline first. One-shot timers cover the "do this in N ms" cases that used to be a delay(), like
+// putting the main screen back after an error popup. Between releases the loop sleeps until the next one is due and
+// that time is counted as idle, so PrintStats shows how much headroom the loop has left.
+// Nothing is preempted: a task that runs long only makes the others late, which shows up as lateness and misses.
+class TaskScheduler {
+public:
+  typedef void (*TaskFn)();
+
+  static const uint8_t MAX_TASKS = 8;
+  static const uint8_t MAX_TIMERS = 4;
+  // Longest single sleep, keeps the loop turning over even with nothing due
+  static const uint32_t MAX_IDLE_US = 2000;
+
+  // deadlineUs is relative to the release, 0 means the end of the period. Returns the task id, -1 if full.
+  int AddPeriodic(const char *name, TaskFn fn, uint32_t periodUs, uint32_t deadlineUs = 0);
+
+  // Runs fn once, delayMs from now. Starting a timer that is already pending restarts it.
+  bool StartTimer(TaskFn fn, uint32_t delayMs);
+  void CancelTimer(TaskFn fn);
+  bool IsTimerPending(TaskFn fn) const;
+
+  // Runs everything that is due: expired timers, then released tasks in deadline order. Each task runs at most once.
+  void RunDue();
+  // Sleeps until the next release or timer, whichever comes first
+  void Idle();
+
+  void ClearStats();
+  void PrintStats() const;
+
+private:
+  struct Task {
+    const char *name;
+    TaskFn fn;
+    uint32_t periodUs;
+    uint32_t deadlineUs;
+    uint32_t releaseUs;  // when the current period started
+
+    uint32_t runs;
+    uint32_t deadlineMisses;
+    uint32_t skippedReleases;  // whole periods lost to an overrun
+    uint32_t maxLatenessUs;    // release to start
+    uint32_t maxRunUs;
+    uint64_t totalRunUs;
+  };
+
+  struct Timer {
+    TaskFn fn;
+    uint32_t startMs;
+    uint32_t delayMs;
+  };
+
+  Task tasks[MAX_TASKS];
+  uint8_t taskCount = 0;
+  Timer timers[MAX_TIMERS] = {};
+
+  uint32_t statsStartUs = 0;
+  uint64_t idleUs = 0;
+
+  void RunTask(Task &task, uint32_t now);
+};
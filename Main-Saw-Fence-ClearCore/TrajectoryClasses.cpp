@@ -0,0 +1,94 @@
+#include <math.h>
+#include "TrajectoryClasses.h"
+
+bool SCurveProfile::Plan(int32_t startSteps, int32_t targetSteps, float maxVel, float maxAccel, float maxJerk) {
+  start = startSteps;
+  target = targetSteps;
+  direction = target >= start ? 1.0f : -1.0f;
+  duration = 0;
+
+  if (maxVel <= 0 || maxAccel <= 0 || maxJerk <= 0) {
+    return false;
+  }
+
+  float distance = fabsf((float)(target - start));
+  float velocity = maxVel;
+  float jerkTime;   // time spent ramping accel up (or down)
+  float accelTime;  // whole accel phase, ramps included
+
+  // Full speed move: does accel reach maxAccel before velocity reaches maxVel?
+  if (maxVel * maxJerk >= maxAccel * maxAccel) {
+    jerkTime = maxAccel / maxJerk;
+    accelTime = jerkTime + maxVel / maxAccel;
+  } else {
+    jerkTime = sqrtf(maxVel / maxJerk);
+    accelTime = 2 * jerkTime;
+  }
+
+  float cruiseTime = 0;
+  if (velocity * accelTime <= distance) {
+    cruiseTime = (distance - velocity * accelTime) / velocity;
+  } else {
+    // Too short to reach maxVel, find the peak velocity that covers the distance with no cruise
+    velocity = powf(distance * sqrtf(maxJerk) / 2, 2.0f / 3.0f);
+    if (velocity * maxJerk < maxAccel * maxAccel) {
+      jerkTime = sqrtf(velocity / maxJerk);
+      accelTime = 2 * jerkTime;
+    } else {
+      velocity = maxAccel / 2 * (-maxAccel / maxJerk + sqrtf(maxAccel * maxAccel / (maxJerk * maxJerk) + 4 * distance / maxAccel));
+      jerkTime = maxAccel / maxJerk;
+      accelTime = jerkTime + velocity / maxAccel;
+    }
+  }
+
+  float constAccelTime = accelTime - 2 * jerkTime;
+  if (constAccelTime < 0) {
+    constAccelTime = 0;
+  }
+
+  const float durations[SEGMENT_COUNT] = { jerkTime, constAccelTime, jerkTime, cruiseTime, jerkTime, constAccelTime, jerkTime };
+  const float jerks[SEGMENT_COUNT] = { maxJerk, 0, -maxJerk, 0, -maxJerk, 0, maxJerk };
+
+  float position = 0;
+  float vel = 0;
+  float accel = 0;
+  for (int i = 0; i < SEGMENT_COUNT; i++) {
+    Segment &segment = segments[i];
+    segment.duration = durations[i];
+    segment.jerk = jerks[i];
+    segment.position = position;
+    segment.velocity = vel;
+    segment.accel = accel;
+
+    float t = durations[i];
+    position += vel * t + accel * t * t / 2 + jerks[i] * t * t * t / 6;
+    vel += accel * t + jerks[i] * t * t / 2;
+    accel += jerks[i] * t;
+    duration += t;
+  }
+  return true;
+}
+
+void SCurveProfile::Evaluate(float t, float &position, float &velocity) const {
+  if (t >= duration) {
+    position = (float)target;
+    velocity = 0;
+    return;
+  }
+  if (t < 0) {
+    t = 0;
+  }
+
+  int i = 0;
+  while (i < SEGMENT_COUNT - 1 && t >= segments[i].duration) {
+    t -= segments[i].duration;
+    i++;
+  }
+
+  const Segment &segment = segments[i];
+  float travelled = segment.position + segment.velocity * t + segment.accel * t * t / 2 + segment.jerk * t * t * t / 6;
+  float speed = segment.velocity + segment.accel * t + segment.jerk * t * t / 2;
+
+  position = (float)start + direction * travelled;
+  velocity = direction * speed;
+}
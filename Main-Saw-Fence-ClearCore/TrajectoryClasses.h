@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+
+// Jerk limited (S-curve) point to point profile in motor steps. Seven segments: jerk up, constant accel, jerk down,
+// cruise, and the same mirrored for the stop. Short moves drop the cruise and, if needed, never reach full accel.
+// The ClearCore step generator only does trapezoids, so SDMotor plays this back as a string of short velocity moves.
+class SCurveProfile {
+public:
+    // Velocities in steps/s, accel in steps/s^2, jerk in steps/s^3. Returns false if the limits can't make a profile.
+    bool Plan(int32_t start, int32_t target, float maxVel, float maxAccel, float maxJerk);
+
+    // Position and velocity t seconds after the start. Past the end it holds at the target.
+    void Evaluate(float t, float &position, float &velocity) const;
+
+    float GetDuration() const { return duration; }
+    int32_t GetStart() const { return start; }
+    int32_t GetTarget() const { return target; }
+
+private:
+    static const int SEGMENT_COUNT = 7;
+
+    struct Segment {
+        float duration;
+        float jerk;
+        // State at the start of the segment, relative to start and along the direction of travel
+        float position;
+        float velocity;
+        float accel;
+    };
+
+    Segment segments[SEGMENT_COUNT];
+    float duration = 0;
+    float direction = 1;
+    int32_t start = 0;
+    int32_t target = 0;
+};
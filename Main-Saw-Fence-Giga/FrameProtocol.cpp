@@ -0,0 +1,201 @@
+#include <Arduino.h>
+#include "FrameProtocol.h"
+
+uint16_t FrameCrc16(uint16_t crc, uint8_t b) {
+  crc ^= static_cast<uint16_t>(b) << 8;
+  for (int i = 0; i < 8; i++) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
+
+// --- FrameWriter ---
+
+void FrameWriter::Send(Stream &port, uint8_t type, const uint8_t *payload, uint8_t length) {
+  if (length > FRAME_MAX_PAYLOAD) {
+    length = FRAME_MAX_PAYLOAD;
+  }
+
+  uint8_t header[4] = { FRAME_SOF, length, nextSeq++, type };
+
+  uint16_t crc = 0xFFFF;
+  for (int i = 1; i < 4; i++) {
+    crc = FrameCrc16(crc, header[i]);
+  }
+  for (int i = 0; i < length; i++) {
+    crc = FrameCrc16(crc, payload[i]);
+  }
+
+  uint8_t trailer[2] = { static_cast<uint8_t>(crc & 0xFF), static_cast<uint8_t>(crc >> 8) };
+
+  port.write(header, sizeof(header));
+  if (length > 0) {
+    port.write(payload, length);
+  }
+  port.write(trailer, sizeof(trailer));
+}
+
+void FrameWriter::SendIndex(Stream &port, uint8_t type, uint8_t index) {
+  Send(port, type, &index, 1);
+}
+
+void FrameWriter::SendText(Stream &port, uint8_t type, const char *text) {
+  size_t length = strlen(text);
+  if (length > FRAME_MAX_PAYLOAD) {
+    length = FRAME_MAX_PAYLOAD;
+  }
+  Send(port, type, reinterpret_cast<const uint8_t *>(text), static_cast<uint8_t>(length));
+}
+
+void FrameWriter::SendIndexedText(Stream &port, uint8_t type, uint8_t index, const char *text) {
+  uint8_t payload[FRAME_MAX_PAYLOAD];
+  payload[0] = index;
+
+  size_t length = strlen(text);
+  if (length > FRAME_MAX_PAYLOAD - 1) {
+    length = FRAME_MAX_PAYLOAD - 1;
+  }
+  memcpy(payload + 1, text, length);
+  Send(port, type, payload, static_cast<uint8_t>(length + 1));
+}
+
+// --- FrameParser ---
+
+bool FrameParser::Feed(uint8_t b) {
+  if (replayStart == replayEnd) {
+    replayStart = replayEnd = 0;
+    if (Step(b)) {
+      return true;
+    }
+  } else {
+    // Behind what a failed frame swallowed
+    memmove(replay, replay + replayStart, replayEnd - replayStart);
+    replayEnd -= replayStart;
+    replayStart = 0;
+    replay[replayEnd++] = b;
+  }
+  return Next();
+}
+
+bool FrameParser::Next() {
+  while (replayStart < replayEnd) {
+    if (Step(replay[replayStart++])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FrameParser::Step(uint8_t b) {
+  switch (state) {
+    case WAIT_SOF:
+      if (b == FRAME_SOF) {
+        crc = 0xFFFF;
+        state = READ_LENGTH;
+      }
+      break;
+
+    case READ_LENGTH:
+      if (b > FRAME_MAX_PAYLOAD) {
+        // Can't be a real frame, resync on the next SOF. That may be this byte, a false SOF right before the real one.
+        crcErrors++;
+        if (b == FRAME_SOF) {
+          crc = 0xFFFF;
+        } else {
+          state = WAIT_SOF;
+        }
+        break;
+      }
+      frame.length = b;
+      crc = FrameCrc16(crc, b);
+      state = READ_SEQ;
+      break;
+
+    case READ_SEQ:
+      frame.seq = b;
+      crc = FrameCrc16(crc, b);
+      state = READ_TYPE;
+      break;
+
+    case READ_TYPE:
+      frame.type = b;
+      crc = FrameCrc16(crc, b);
+      payloadIndex = 0;
+      state = frame.length > 0 ? READ_PAYLOAD : READ_CRC_LO;
+      break;
+
+    case READ_PAYLOAD:
+      frame.payload[payloadIndex++] = b;
+      crc = FrameCrc16(crc, b);
+      if (payloadIndex >= frame.length) {
+        state = READ_CRC_LO;
+      }
+      break;
+
+    case READ_CRC_LO:
+      receivedCrc = b;
+      state = READ_CRC_HI;
+      break;
+
+    case READ_CRC_HI:
+      receivedCrc |= static_cast<uint16_t>(b) << 8;
+      state = WAIT_SOF;
+
+      if (receivedCrc != crc) {
+        crcErrors++;
+        Rescan();
+        return false;
+      }
+
+      if (hasLastSeq && frame.seq != static_cast<uint8_t>(lastSeq + 1)) {
+        droppedFrames += static_cast<uint8_t>(frame.seq - lastSeq - 1);
+      }
+      hasLastSeq = true;
+      lastSeq = frame.seq;
+
+      frame.payload[frame.length] = '\0';
+      return true;
+  }
+  return false;
+}
+
+void FrameParser::Rescan() {
+  // The SOF was a payload byte of a frame we came in part way through, the real SOF can be anywhere in what followed
+  uint8_t bytes[FRAME_MAX_PAYLOAD + 5];
+  uint8_t count = 0;
+  bytes[count++] = frame.length;
+  bytes[count++] = frame.seq;
+  bytes[count++] = frame.type;
+  memcpy(bytes + count, frame.payload, frame.length);
+  count += frame.length;
+  bytes[count++] = receivedCrc & 0xFF;
+  bytes[count++] = receivedCrc >> 8;
+
+  uint8_t first = 0;
+  while (first < count && bytes[first] != FRAME_SOF) {
+    first++;
+  }
+  if (first == count) {
+    return;
+  }
+
+  // In front of whatever is still waiting from an earlier rescan, the two together never exceed one whole frame
+  uint8_t rescanned = count - first;
+  uint8_t waiting = replayEnd - replayStart;
+  memmove(replay + rescanned, replay + replayStart, waiting);
+  memcpy(replay, bytes + first, rescanned);
+  replayStart = 0;
+  replayEnd = rescanned + waiting;
+}
+
+const Frame &FrameParser::GetFrame() const {
+  return frame;
+}
+
+uint32_t FrameParser::GetCrcErrors() const {
+  return crcErrors;
+}
+
+uint32_t FrameParser::GetDroppedFrames() const {
+  return droppedFrames;
+}
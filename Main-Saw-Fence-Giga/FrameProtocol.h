@@ -0,0 +1,131 @@
+#pragma once
+#include <Arduino.h>
+
+// Binary framing for the ClearCore <-> Giga serial link. It is negotiated during the HELLO/ACK handshake and the
+// line based text protocol stays as the fallback.
+// Both sketches carry an identical copy of this file (Arduino sketches can't share a source folder), keep them in sync.
+//
+// Frame layout: SOF | length | seq | type | payload[length] | crc16 lo | crc16 hi
+// The CRC is CRC-16/CCITT-FALSE over length, seq, type and payload. seq increments per frame so the receiver can count dropped frames.
+
+#define FRAME_HELLO_TEXT "HELLO:BIN1"
+#define FRAME_ACK_TEXT "ACK:BIN1"
+
+const uint8_t FRAME_SOF = 0xA5;
+const uint8_t FRAME_MAX_PAYLOAD = 64;
+
+enum FRAME_TYPE : uint8_t {
+  FRAME_SET_LABEL = 0x01,        // payload: object index, label text
+  FRAME_SET_SCREEN = 0x02,       // payload: screen index
+  FRAME_SET_SWITCH = 0x03,       // payload: object index
+  FRAME_POSITION = 0x04,         // payload: POSITION_* kind, then as below
+  FRAME_LINK_PROPOSE = 0x05,     // payload: baud u32, sent at the current rate
+  FRAME_LINK_ECHO = 0x06,        // payload: test pattern, sent back unchanged
+  FRAME_LINK_COMMIT = 0x07,      // payload: baud u32, sent at the new rate once the echoes came back clean
+  FRAME_BUTTON = 0x10,           // payload: object index
+  FRAME_ENTER = 0x11,            // payload: entered text
+  FRAME_LINK_ACCEPT = 0x12,      // payload: baud u32, the Giga switches right after sending it
+  FRAME_LINK_ECHO_REPLY = 0x13,  // payload: the FRAME_LINK_ECHO payload
+  FRAME_LINK_COMMITTED = 0x14    // payload: baud u32
+};
+
+// Link speed negotiation, binary mode only. Both ends start at the base rate (screenBaud on the ClearCore,
+// LINK_BASE_BAUD on the Giga) and the ClearCore walks up this list. A Giga that gets no FRAME_LINK_COMMIT within
+// LINK_TRIAL_TIMEOUT_MS of switching goes back to the rate it came from.
+const uint32_t LINK_BAUD_RATES[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800 };
+const uint8_t LINK_BAUD_RATE_COUNT = sizeof(LINK_BAUD_RATES) / sizeof(LINK_BAUD_RATES[0]);
+const uint32_t LINK_TRIAL_TIMEOUT_MS = 1000;
+
+// Live fence position while it moves. Positions are hundredths of the display unit, little endian. Deltas keep the
+// frames small on a 9600 baud link, a key frame every few deltas lets the Giga recover from a dropped frame.
+enum POSITION_KIND : uint8_t {
+  POSITION_KEY = 0,    // position i32 | move start i32 | move target i32 | unit u8 (UnitType)
+  POSITION_DELTA = 1,  // change since the previous frame i16
+  POSITION_END = 2     // final position i32, the move is over
+};
+const uint8_t POSITION_KEY_LENGTH = 14;
+const uint8_t POSITION_DELTA_LENGTH = 3;
+const uint8_t POSITION_END_LENGTH = 5;
+const uint8_t FRAME_OVERHEAD = 6;  // SOF, length, seq, type and the two CRC bytes
+
+// Little endian fields for the position payloads
+inline void FramePutI32(uint8_t *dst, int32_t value) {
+  uint32_t bits = (uint32_t)value;
+  dst[0] = bits & 0xFF;
+  dst[1] = (bits >> 8) & 0xFF;
+  dst[2] = (bits >> 16) & 0xFF;
+  dst[3] = bits >> 24;
+}
+inline int32_t FrameGetI32(const uint8_t *src) {
+  return (int32_t)((uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24));
+}
+inline void FramePutI16(uint8_t *dst, int16_t value) {
+  uint16_t bits = (uint16_t)value;
+  dst[0] = bits & 0xFF;
+  dst[1] = bits >> 8;
+}
+inline int16_t FrameGetI16(const uint8_t *src) {
+  return (int16_t)((uint16_t)src[0] | ((uint16_t)src[1] << 8));
+}
+
+struct Frame {
+  uint8_t type = 0;
+  uint8_t seq = 0;
+  uint8_t length = 0;
+  uint8_t payload[FRAME_MAX_PAYLOAD + 1];  // +1 so text payloads can be null terminated in place
+};
+
+uint16_t FrameCrc16(uint16_t crc, uint8_t b);
+
+class FrameWriter {
+public:
+  void Send(Stream &port, uint8_t type, const uint8_t *payload, uint8_t length);
+  void SendIndex(Stream &port, uint8_t type, uint8_t index);
+  void SendText(Stream &port, uint8_t type, const char *text);
+  void SendIndexedText(Stream &port, uint8_t type, uint8_t index, const char *text);
+
+private:
+  uint8_t nextSeq = 0;
+};
+
+class FrameParser {
+public:
+  // Feed one received byte. Returns true once a complete frame with a valid CRC is available from GetFrame().
+  bool Feed(uint8_t b);
+  // A frame that failed its CRC is searched for the real SOF, and one false frame can hold several real ones. After
+  // Feed() returns true, call this until it returns false so none of them waits for the next byte.
+  bool Next();
+  const Frame &GetFrame() const;
+
+  uint32_t GetCrcErrors() const;
+  uint32_t GetDroppedFrames() const;
+
+private:
+  enum ParseState {
+    WAIT_SOF,
+    READ_LENGTH,
+    READ_SEQ,
+    READ_TYPE,
+    READ_PAYLOAD,
+    READ_CRC_LO,
+    READ_CRC_HI
+  };
+
+  ParseState state = WAIT_SOF;
+  Frame frame;
+  // Bytes after a false SOF that failed its CRC, parsed again before anything new
+  uint8_t replay[FRAME_MAX_PAYLOAD + 5];
+  uint8_t replayStart = 0;
+  uint8_t replayEnd = 0;
+  uint8_t payloadIndex = 0;
+  uint16_t crc = 0;
+  uint16_t receivedCrc = 0;
+
+  bool hasLastSeq = false;
+  uint8_t lastSeq = 0;
+  uint32_t crcErrors = 0;
+  uint32_t droppedFrames = 0;
+
+  bool Step(uint8_t b);
+  void Rescan();
+};
@@ -2,28 +2,163 @@
 #include <Arduino_H7_Video.h>
 #include <lvgl.h>
 #include <ui.h>
+#include "FrameProtocol.h"
 
 /* Initialize the GIGA Display Shield at 800×480 */
 Arduino_H7_Video Display(800, 480, GigaDisplayShield);
 Arduino_GigaDisplayTouch Touch;
 
+// The link always comes up at this rate (screenBaud in the ClearCore's config has to match), then the ClearCore
+// may step it up, see LINK_BAUD_RATES
+const uint32_t LINK_BASE_BAUD = 9600;
+// Above the base rate, this many bytes without a good frame means the ClearCore restarted and is saying HELLO at
+// the base rate again
+const uint16_t LINK_GARBAGE_LIMIT = 96;
+
 bool isConnected = false;
+bool binaryMode = false;  // ClearCore offered FRAME_HELLO_TEXT and we accepted, otherwise text lines
+uint32_t linkBaud = LINK_BASE_BAUD;
+uint32_t linkTrialPrevBaud = LINK_BASE_BAUD;  // rate before the last trial, where the ClearCore goes back to
+uint32_t linkTrialStartMs = 0;
+bool linkTrialPending = false;  // switched to a proposed rate, going back unless FRAME_LINK_COMMIT arrives
+uint16_t bytesSinceGoodFrame = 0;
+FrameWriter frameWriter;
+FrameParser frameParser;
 lv_obj_t* active_text_area = nullptr;
 static String currentText = "";
 
+/* --- Object registry. The ClearCore refers to objects and screens by index (SCREEN_OBJECT and SCREEN in its
+   ScreenClasses.h), these tables turn the index into the SquareLine object. Filled in setup() once ui_init() ran. --- */
+enum {
+  MAIN_MEASUREMENT_LABEL = 1,
+  EDIT_TARGET_BUTTON = 3,
+  LIVE_PARAMETER_INPUT_LABEL = 8,
+  INCHES_UNIT_BUTTON = 11,
+  MILLIMETERS_UNIT_BUTTON = 12,
+  SCREEN_OBJECT_COUNT = 14
+};
+enum {
+  PARAMETER_EDIT_SCREEN = 2,
+  SCREEN_COUNT = 7
+};
+lv_obj_t* screenObjects[SCREEN_OBJECT_COUNT] = {};
+lv_obj_t* screens[SCREEN_COUNT] = {};
+
+static void RegisterScreenObjects() {
+  screenObjects[MAIN_MEASUREMENT_LABEL] = ui_CURRENT_MEASUREMENT_LABEL;
+  screenObjects[2] = ui_MEASURE_BUTTON;
+  screenObjects[EDIT_TARGET_BUTTON] = ui_EDIT_TARGET_BUTTON;
+  screenObjects[4] = ui_HOME_AXIS_BUTTON;
+  screenObjects[5] = ui_RESET_SERVO_BUTTON;
+  screenObjects[6] = ui_SETTINGS_BUTTON;
+  screenObjects[7] = ui_EDIT_MAX_TRAVEL_BUTTON;
+  screenObjects[LIVE_PARAMETER_INPUT_LABEL] = ui_PARAMETER_INPUT_TEXT_AREA;
+  screenObjects[10] = ui_EXIT_SETTINGS_BUTTON;
+  screenObjects[INCHES_UNIT_BUTTON] = ui_UNIT_SWITCH;  // one switch, the index says which way
+  screenObjects[MILLIMETERS_UNIT_BUTTON] = ui_UNIT_SWITCH;
+
+  screens[0] = ui_SPLASH_SCREEN;
+  screens[1] = ui_MAIN_CONTROL_SCREEN;
+  screens[PARAMETER_EDIT_SCREEN] = ui_PARAMETER_EDIT_SCREEN;
+  screens[3] = ui_SETTINGS_SCREEN;
+  screens[4] = ui_OUTSIDE_RANGE_ERROR_SCREEN;
+  screens[5] = ui_HOMING_ALERT_SCREEN;
+  screens[6] = ui_PLEASE_HOME_ERROR_SCREEN;
+}
+
+static lv_obj_t* ScreenObject(int index) {
+  return (index > 0 && index < SCREEN_OBJECT_COUNT) ? screenObjects[index] : nullptr;
+}
+
+// Reverse lookup for button events, the first index wins (so the unit switch reports as inches, it has its own handler)
+static int ScreenObjectIndex(lv_obj_t* obj) {
+  for (int i = 1; i < SCREEN_OBJECT_COUNT; i++) {
+    if (screenObjects[i] == obj) return i;
+  }
+  return 0;
+}
+
+/* --- Live position readout, a label and progress bar under the target that are only shown while the fence moves --- */
+static const uint32_t POSITION_REDRAW_MS = 100;  // LVGL redraw cap, on a fast link the ClearCore may send more often
+lv_obj_t* livePositionLabel = nullptr;
+lv_obj_t* livePositionBar = nullptr;
+
+struct LivePosition {
+  int32_t position = 0;  // hundredths of unit
+  int32_t start = 0;
+  int32_t target = 0;
+  uint8_t unit = 0;          // ClearCore UnitType, 1 is millimeters
+  bool valid = false;        // deltas only apply on top of a key frame with nothing dropped since
+  bool moving = false;
+  bool dirty = false;
+  uint32_t droppedFrames = 0;  // frameParser count when the chain was last good
+};
+LivePosition livePosition;
+uint32_t lastPositionRedrawMs = 0;
+
+/* --- Handshake. Also answered from loop() so a ClearCore that rebooted after a power blip reconnects without restarting the Giga --- */
+static bool HandleHello(const String& m) {
+  if (m == FRAME_HELLO_TEXT) {
+    Serial2.println(FRAME_ACK_TEXT);
+    Serial2.flush();
+    Serial.println("Sent binary ACK to clearcore");
+    binaryMode = true;
+  } else if (m == "HELLO") {
+    Serial2.println("ACK");
+    Serial2.flush();
+    Serial.println("Sent ACK to clearcore");
+    binaryMode = false;
+  } else {
+    return false;
+  }
+  isConnected = true;
+  return true;
+}
+
+// In binary mode a HELLO arrives as a plain text line between frames, pick it out of the byte stream
+static void ScanForHello(uint8_t b) {
+  static char helloLine[16];
+  static uint8_t helloLength = 0;
+
+  if (b == '\n' || b == '\r') {
+    helloLine[helloLength] = '\0';
+    if (helloLength > 0) {
+      HandleHello(String(helloLine));
+    }
+    helloLength = 0;
+  } else if (isPrintable(b) && helloLength < sizeof(helloLine) - 1) {
+    helloLine[helloLength++] = b;
+  } else {
+    helloLength = 0;
+  }
+}
+
+/* --- Outgoing messages, framed or text depending on what the handshake agreed --- */
+static void SendButton(int index) {
+  if (binaryMode) {
+    frameWriter.SendIndex(Serial2, FRAME_BUTTON, (uint8_t)index);
+  } else {
+    Serial2.print("BUTTON:");
+    Serial2.println(index);
+  }
+}
+
+static void SendEnter(const String& value) {
+  if (binaryMode) {
+    frameWriter.SendText(Serial2, FRAME_ENTER, value.c_str());
+  } else {
+    Serial2.println("ENTER:" + value);
+  }
+}
+
 /* --- Main button handler --- */
 static void ButtonEventHandler(lv_event_t* e) {
   if (lv_event_get_code(e) == LV_EVENT_CLICKED) {
     lv_obj_t* btn = lv_event_get_target(e);
     Serial.println("btn pressed");
 
-    if (btn == ui_MEASURE_BUTTON) Serial2.println("BUTTON:2");
-    else if ((btn == ui_EDIT_TARGET_BUTTON) || (btn == ui_TEXT_PRESS_EDIT_TARGET)) Serial2.println("BUTTON:3");
-    else if (btn == ui_HOME_AXIS_BUTTON) Serial2.println("BUTTON:4");
-    else if (btn == ui_RESET_SERVO_BUTTON) Serial2.println("BUTTON:5");
-    else if (btn == ui_SETTINGS_BUTTON) Serial2.println("BUTTON:6");
-    else if (btn == ui_EDIT_MAX_TRAVEL_BUTTON) Serial2.println("BUTTON:7");
-    else if (btn == ui_EXIT_SETTINGS_BUTTON) Serial2.println("BUTTON:10");
+    int index = (btn == ui_TEXT_PRESS_EDIT_TARGET) ? EDIT_TARGET_BUTTON : ScreenObjectIndex(btn);
+    if (index > 0) SendButton(index);
     else Serial.println("Unknown button clicked");
   }
 
@@ -35,8 +170,7 @@ static void ButtonEventHandler(lv_event_t* e) {
       Serial.print("UNIT_SWITCH state: ");
       Serial.println(isChecked ? "ON" : "OFF");
 
-      Serial2.print("BUTTON:");
-      Serial2.println(isChecked ? "12" : "11");
+      SendButton(isChecked ? 12 : 11);
     }
   }
 }
@@ -54,7 +188,7 @@ static void TextAreaEventHandler(lv_event_t* e) {
       currentText.remove(currentText.length() - 5); //length of 'enter'
       Serial.println("Enter has been pressed...");
       //Serial.println(txtString);
-      Serial2.println("ENTER:" + currentText);
+      SendEnter(currentText);
       Serial.println("ENTER:" + currentText);
       return;
     }
@@ -110,33 +244,40 @@ void setupNumericKeyboard(lv_obj_t* keyboard, lv_obj_t* ta = nullptr) {
   lv_keyboard_set_map(keyboard, LV_KEYBOARD_MODE_USER_4, kb_map, kb_ctrl);
 
   // --- Style for big numbers ---
+  // Only the first time, this runs on every visit to the edit screen and initialising the style again leaks its
+  // properties, adding it again grows the keyboard's style list
   static lv_style_t kb_style;
-  lv_style_init(&kb_style);
+  static bool kb_styled = false;
+  if (!kb_styled) {
+    lv_style_init(&kb_style);
 
-  // Use a large built-in font (or your custom one)
-  lv_style_set_text_font(&kb_style, &lv_font_montserrat_48);
+    // Use a large built-in font (or your custom one)
+    lv_style_set_text_font(&kb_style, &lv_font_montserrat_48);
 
-  // Center the text in the keys
-  lv_style_set_text_align(&kb_style, LV_TEXT_ALIGN_CENTER);
+    // Center the text in the keys
+    lv_style_set_text_align(&kb_style, LV_TEXT_ALIGN_CENTER);
 
-  lv_style_set_pad_all(&kb_style, 10);
+    lv_style_set_pad_all(&kb_style, 10);
 
-  lv_obj_add_style(keyboard, &kb_style, LV_PART_ITEMS);
+    lv_obj_add_style(keyboard, &kb_style, LV_PART_ITEMS);
+    kb_styled = true;
+  }
 
   lv_obj_set_size(keyboard, 700, 450);
 }
 
 
 void setup() {
-  Display.begin();
+  Display.begin(H7_VIDEO_RENDER_PARTIAL_DOUBLE);  // DMA2D copies one strip while LVGL draws the next
   Touch.begin();
   ui_init();
+  RegisterScreenObjects();
 
   lv_scr_load(ui_SPLASH_SCREEN);
   lv_timer_handler();
 
   Serial.begin(115200);
-  Serial2.begin(9600);
+  Serial2.begin(LINK_BASE_BAUD);
 
   Serial.println("Init done.");
 
@@ -147,12 +288,7 @@ void setup() {
       String m = Serial2.readStringUntil('\n');
       Serial.println("Received: " + m);
       m.trim();
-      if (m == "HELLO") {
-        Serial2.println("ACK");
-        Serial2.flush();
-        Serial.println("Sent ACK to clearcore");
-        isConnected = true;
-      }
+      HandleHello(m);
     }
   }
 
@@ -172,72 +308,436 @@ void setup() {
   lv_obj_add_event_cb(ui_PARAMETER_INPUT_TEXT_AREA, TextAreaEventHandler, LV_EVENT_INSERT, nullptr);
   lv_obj_add_event_cb(ui_PARAMETER_INPUT_TEXT_AREA, TextAreaEventHandler, LV_EVENT_VALUE_CHANGED, nullptr);
   lv_obj_add_event_cb(ui_PARAMETER_INPUT_TEXT_AREA, TextAreaEventHandler, LV_EVENT_READY, nullptr);
+
+  CreateLivePositionWidgets();
+}
+
+static void CreateLivePositionWidgets() {
+  livePositionLabel = lv_label_create(ui_MAIN_CONTROL_SCREEN);
+  lv_obj_set_width(livePositionLabel, 400);
+  lv_obj_set_style_text_align(livePositionLabel, LV_TEXT_ALIGN_CENTER, 0);
+  lv_obj_align_to(livePositionLabel, ui_CURRENT_MEASUREMENT_LABEL, LV_ALIGN_OUT_BOTTOM_MID, 0, 10);
+  lv_obj_add_flag(livePositionLabel, LV_OBJ_FLAG_HIDDEN);
+
+  livePositionBar = lv_bar_create(ui_MAIN_CONTROL_SCREEN);
+  lv_obj_set_size(livePositionBar, 400, 16);
+  lv_bar_set_range(livePositionBar, 0, 1000);
+  lv_obj_align_to(livePositionBar, livePositionLabel, LV_ALIGN_OUT_BOTTOM_MID, 0, 10);
+  lv_obj_add_flag(livePositionBar, LV_OBJ_FLAG_HIDDEN);
+}
+
+/* --- Incoming message handlers, shared by the text and binary protocols --- */
+// What the ClearCore last asked for. It only resends on a change, so anything else drawn over these (the heap soak)
+// has to put them back.
+static int receivedScreen = 0;  // setup() starts on the splash screen
+static String receivedMeasurement;
+static bool measurementReceived = false;
+
+static void ShowScreen(int idx) {
+  lv_obj_t* screen = (idx >= 0 && idx < SCREEN_COUNT) ? screens[idx] : ui_SPLASH_SCREEN;
+  // Loading a screen redraws all 800x480 of it, only do that when it actually changes
+  if (screen == lv_scr_act()) return;
+
+  lv_scr_load(screen);
+  if (idx == PARAMETER_EDIT_SCREEN) {
+    lv_textarea_set_text(ui_PARAMETER_INPUT_TEXT_AREA, "");
+    setupNumericKeyboard(ui_PARAMETER_INPUT_KEYBOARD, ui_PARAMETER_INPUT_TEXT_AREA);
+    lv_keyboard_set_textarea(ui_PARAMETER_INPUT_KEYBOARD, ui_PARAMETER_INPUT_TEXT_AREA);
+    lv_obj_add_state(ui_PARAMETER_INPUT_TEXT_AREA, LV_STATE_FOCUSED);
+    lv_textarea_set_cursor_pos(ui_PARAMETER_INPUT_TEXT_AREA, LV_TEXTAREA_CURSOR_LAST);
+  }
+}
+
+// Only the label's own area gets invalidated, and nothing at all when the text is unchanged. The active screen is
+// left alone, a label on a screen that isn't shown is simply up to date once it is.
+static bool ShowLabel(int li, const char* labelText) {
+  lv_obj_t* obj = ScreenObject(li);
+  if (obj == nullptr) return false;
+
+  if (lv_obj_check_type(obj, &lv_label_class)) {
+    if (strcmp(lv_label_get_text(obj), labelText) == 0) return false;
+    lv_label_set_text(obj, labelText);
+  } else if (lv_obj_check_type(obj, &lv_textarea_class)) {
+    if (strcmp(lv_textarea_get_text(obj), labelText) == 0) return false;
+    lv_textarea_set_text(obj, labelText);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static void HandleSetScreen(int idx) {
+  receivedScreen = idx;
+  ShowScreen(idx);
+}
+
+static void HandleSetLabel(int li, const char* labelText) {
+  if (li == MAIN_MEASUREMENT_LABEL) {
+    receivedMeasurement = labelText;
+    measurementReceived = true;
+  }
+  if (ShowLabel(li, labelText)) {
+    Serial.println(labelText);
+  }
+}
+
+// it takes in and uses the button index (for example, 11 is inches enabled and 12 is inches but it corresponds to on/off switch)
+static void HandleSetSwitch(int index) {
+  lv_obj_t* obj = ScreenObject(index);
+  if (obj == nullptr) return;
+
+  if (index == MILLIMETERS_UNIT_BUTTON) {
+    lv_obj_add_state(obj, LV_STATE_CHECKED);  //on, millimeters
+  } else if (index == INCHES_UNIT_BUTTON) {
+    lv_obj_clear_state(obj, LV_STATE_CHECKED);
+  }
+}
+
+static void HandlePosition(const Frame& frame) {
+  if (frame.length < 1) return;
+
+  switch (frame.payload[0]) {
+    case POSITION_KEY:
+      if (frame.length < POSITION_KEY_LENGTH) return;
+      livePosition.position = FrameGetI32(frame.payload + 1);
+      livePosition.start = FrameGetI32(frame.payload + 5);
+      livePosition.target = FrameGetI32(frame.payload + 9);
+      livePosition.unit = frame.payload[13];
+      livePosition.valid = true;
+      livePosition.moving = true;
+      break;
+    case POSITION_DELTA:
+      if (frame.length < POSITION_DELTA_LENGTH) return;
+      // A frame went missing since the last good one, the delta chain is broken until the next key frame
+      if (frameParser.GetDroppedFrames() != livePosition.droppedFrames) {
+        livePosition.valid = false;
+      }
+      if (!livePosition.valid) break;
+      livePosition.position += FrameGetI16(frame.payload + 1);
+      break;
+    case POSITION_END:
+      if (frame.length < POSITION_END_LENGTH) return;
+      livePosition.position = FrameGetI32(frame.payload + 1);
+      livePosition.valid = false;
+      livePosition.moving = false;
+      break;
+    default:
+      return;
+  }
+  livePosition.droppedFrames = frameParser.GetDroppedFrames();
+  livePosition.dirty = true;
+}
+
+// Called every loop, touches LVGL at most every POSITION_REDRAW_MS and never reloads the screen
+static void UpdateLivePosition() {
+  if (!livePosition.dirty || millis() - lastPositionRedrawMs < POSITION_REDRAW_MS) return;
+  livePosition.dirty = false;
+  lastPositionRedrawMs = millis();
+
+  if (!livePosition.moving) {
+    lv_obj_add_flag(livePositionLabel, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(livePositionBar, LV_OBJ_FLAG_HIDDEN);
+    return;
+  }
+  if (!livePosition.valid) return;  // keep showing the last good value until a key frame comes in
+
+  // Integer hundredths, no float printf needed
+  int32_t p = livePosition.position;
+  int32_t whole = abs(p) / 100;
+  int32_t fraction = abs(p) % 100;
+  lv_label_set_text_fmt(livePositionLabel, "%s%ld.%02ld %s", p < 0 ? "-" : "", (long)whole, (long)fraction,
+                        livePosition.unit == 1 ? "mm" : "in");
+
+  int32_t span = livePosition.target - livePosition.start;
+  int32_t permille = 1000;
+  if (span != 0) {
+    permille = (int32_t)((int64_t)(p - livePosition.start) * 1000 / span);
+    permille = constrain(permille, 0, 1000);
+  }
+  lv_bar_set_value(livePositionBar, permille, LV_ANIM_OFF);
+
+  lv_obj_clear_flag(livePositionLabel, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_clear_flag(livePositionBar, LV_OBJ_FLAG_HIDDEN);
+}
+
+/* --- Link speed negotiation, the ClearCore drives it (LinkNegotiator there) --- */
+static void SetLinkBaud(uint32_t baud) {
+  Serial2.flush();
+  Serial2.begin(baud);
+  linkBaud = baud;
+  bytesSinceGoodFrame = 0;
+}
+
+static void HandleLinkPropose(const Frame& frame) {
+  if (frame.length < 4) return;
+  uint32_t baud = (uint32_t)FrameGetI32(frame.payload);
+  bool supported = false;
+  for (uint8_t i = 0; i < LINK_BAUD_RATE_COUNT; i++) {
+    if (LINK_BAUD_RATES[i] == baud) supported = true;
+  }
+  if (!supported) return;  // the ClearCore times out and stays where it is
+
+  // Answer at the old rate, then switch. The ClearCore switches once it has the answer.
+  frameWriter.Send(Serial2, FRAME_LINK_ACCEPT, frame.payload, 4);
+  linkTrialPrevBaud = linkBaud;
+  SetLinkBaud(baud);
+  linkTrialPending = true;
+  linkTrialStartMs = millis();
+  Serial.print("Link trial at ");
+  Serial.println(baud);
+}
+
+static void HandleLinkCommit(const Frame& frame) {
+  // Also answered outside a trial, the ClearCore sends COMMIT again if our COMMITTED got lost
+  if (frame.length < 4 || (uint32_t)FrameGetI32(frame.payload) != linkBaud) return;
+  linkTrialPending = false;
+  frameWriter.Send(Serial2, FRAME_LINK_COMMITTED, frame.payload, 4);
+  Serial.print("Link now at ");
+  Serial.println(linkBaud);
+}
+
+static void LinkPeriodic() {
+  if (linkTrialPending && millis() - linkTrialStartMs >= LINK_TRIAL_TIMEOUT_MS) {
+    linkTrialPending = false;
+    SetLinkBaud(linkTrialPrevBaud);
+    Serial.print("Link trial timed out, back to ");
+    Serial.println(linkBaud);
+  } else if (linkBaud != LINK_BASE_BAUD && !linkTrialPending && bytesSinceGoodFrame >= LINK_GARBAGE_LIMIT) {
+    // First the rate the last trial came from: the ClearCore went back there if every COMMITTED we sent got lost and
+    // so did its proposal to take us along. Garbage there too means it restarted and says HELLO at the base rate.
+    SetLinkBaud(linkTrialPrevBaud < linkBaud ? linkTrialPrevBaud : LINK_BASE_BAUD);
+    linkTrialPrevBaud = LINK_BASE_BAUD;
+    Serial.print("Nothing but garbage on the link, back to ");
+    Serial.println(linkBaud);
+  }
+}
+
+static void HandleFrame(const Frame& frame) {
+  switch (frame.type) {
+    case FRAME_LINK_PROPOSE:
+      HandleLinkPropose(frame);
+      break;
+    case FRAME_LINK_ECHO:
+      frameWriter.Send(Serial2, FRAME_LINK_ECHO_REPLY, frame.payload, frame.length);
+      break;
+    case FRAME_LINK_COMMIT:
+      HandleLinkCommit(frame);
+      break;
+    case FRAME_SET_SCREEN:
+      if (frame.length >= 1) HandleSetScreen(frame.payload[0]);
+      break;
+    case FRAME_SET_LABEL:
+      if (frame.length >= 1) HandleSetLabel(frame.payload[0], (const char*)frame.payload + 1);
+      break;
+    case FRAME_SET_SWITCH:
+      if (frame.length >= 1) HandleSetSwitch(frame.payload[0]);
+      break;
+    case FRAME_POSITION:
+      HandlePosition(frame);
+      break;
+    default:
+      Serial.print("Unknown frame type: ");
+      Serial.println(frame.type);
+      break;
+  }
+}
+
+/* --- USB serial debug commands, one character each --- */
+static void PrintCacheCounters(const String& name, const lv_draw_cache_counters_t& counters) {
+  uint32_t lookups = counters.hits + counters.misses;
+  Serial.print(name);
+  Serial.print(counters.hits);
+  Serial.print(" hits, ");
+  Serial.print(counters.misses);
+  Serial.print(" misses, ");
+  Serial.print(counters.evictions);
+  Serial.print(" evictions");
+  if (lookups > 0) {
+    Serial.print(", ");
+    Serial.print((uint32_t)((uint64_t)counters.hits * 100 / lookups));
+    Serial.print("% hit rate");
+  }
+  Serial.println();
+}
+
+// Hit rates to size LV_IMG_CACHE_DEF_SIZE, LV_GRAD_CACHE_DEF_SIZE and LV_SHADOW_CACHE_SIZE in lv_conf.h by. Reset,
+// go through the screens, then print.
+static void PrintCacheStats() {
+  lv_draw_cache_stats_t stats;
+  lv_draw_cache_stats_get(&stats);
+  Serial.println();
+  Serial.println("=== LVGL DRAW CACHES ===");
+  PrintCacheCounters("image (" + String(LV_IMG_CACHE_DEF_SIZE) + " entries): ", stats.img);
+  PrintCacheCounters("gradient (" + String(LV_GRAD_CACHE_DEF_SIZE) + " bytes): ", stats.grad);
+  Serial.print("  ");
+  Serial.print(stats.grad_used_max);
+  Serial.print(" bytes used at most, ");
+  Serial.print(stats.grad_uncached);
+  Serial.println(" maps too big to cache");
+  PrintCacheCounters("shadow (" + String(LV_SHADOW_CACHE_SIZE) + " px): ", stats.shadow);
+  Serial.print("  ");
+  Serial.print(stats.shadow_size_max);
+  Serial.print(" px largest corner, ");
+  Serial.print(stats.shadow_uncached);
+  Serial.println(" corners too big to cache");
+}
+
+// LVGL's TLSF heap in the SDRAM (LV_MEM_SIZE in lv_conf.h). Fragmentation is how much of the free space is not in
+// the largest free block.
+static void PrintMemStats() {
+  lv_mem_monitor_t mon;
+  lv_mem_monitor(&mon);
+  Serial.print(mon.total_size - mon.free_size);
+  Serial.print(" of ");
+  Serial.print(mon.total_size);
+  Serial.print(" bytes used (");
+  Serial.print(mon.used_pct);
+  Serial.print("%), max ");
+  Serial.print(mon.max_used);
+  Serial.print(", ");
+  Serial.print(mon.used_cnt);
+  Serial.print(" blocks, ");
+  Serial.print(mon.free_cnt);
+  Serial.print(" free blocks, largest free ");
+  Serial.print(mon.free_biggest_size);
+  Serial.print(", ");
+  Serial.print(mon.frag_pct);
+  Serial.println("% fragmented");
+}
+
+/* --- Heap soak. Loads and draws every screen in turn SOAK_CYCLES times, the same way the ClearCore switches them,
+   and reports how LVGL's heap holds up. One screen per loop(), a full redraw takes long enough that seven in a row
+   would leave Serial2 unread. Screens and measurements the ClearCore sends meanwhile are put up once it finishes. --- */
+static const uint32_t SOAK_CYCLES = 2000;
+static const uint32_t SOAK_REPORT_CYCLES = 250;
+static uint32_t soakCycle = 0;
+static int soakScreen = 0;  // next screen to draw in this cycle
+static bool soakRunning = false;
+static uint32_t soakStartMs = 0;
+static uint32_t soakStartUsed = 0;
+
+static uint32_t HeapUsed() {
+  lv_mem_monitor_t mon;
+  lv_mem_monitor(&mon);
+  return mon.total_size - mon.free_size;
+}
+
+static void StartSoak() {
+  if (!measurementReceived) {
+    receivedMeasurement = lv_label_get_text(ui_CURRENT_MEASUREMENT_LABEL);
+  }
+  soakCycle = 0;
+  soakScreen = 0;
+  soakStartMs = millis();
+  soakStartUsed = HeapUsed();
+  soakRunning = true;
+
+  Serial.print("Soak: ");
+  Serial.print(SOAK_CYCLES);
+  Serial.print(" cycles of ");
+  Serial.print(SCREEN_COUNT);
+  Serial.println(" screens");
+  Serial.print("start: ");
+  PrintMemStats();
+}
+
+static void SoakStep() {
+  ShowScreen(soakScreen);
+  // A changing label on top, like a measurement coming in, so text buffers get reallocated too
+  ShowLabel(MAIN_MEASUREMENT_LABEL, String(soakCycle * SCREEN_COUNT + soakScreen).c_str());
+  lv_refr_now(NULL);
+  if (++soakScreen < SCREEN_COUNT) return;
+  soakScreen = 0;
+  soakCycle++;
+
+  if (soakCycle % SOAK_REPORT_CYCLES == 0 || soakCycle == SOAK_CYCLES) {
+    Serial.print("cycle ");
+    Serial.print(soakCycle);
+    Serial.print(": ");
+    PrintMemStats();
+  }
+  if (soakCycle < SOAK_CYCLES) return;
+
+  // Back to what the ClearCore last sent, including anything that came in during the soak
+  soakRunning = false;
+  ShowLabel(MAIN_MEASUREMENT_LABEL, receivedMeasurement.c_str());
+  ShowScreen(receivedScreen);
+  int32_t leaked = (int32_t)(HeapUsed() - soakStartUsed);
+  Serial.print("Soak done, ");
+  Serial.print(soakCycle * SCREEN_COUNT);
+  Serial.print(" screen loads in ");
+  Serial.print((millis() - soakStartMs) / 1000);
+  Serial.print(" s, heap use ");
+  Serial.print(leaked >= 0 ? "+" : "");
+  Serial.print(leaked);
+  Serial.println(" bytes since the start");
+}
+
+static void HandleDebugCommand(char c) {
+  switch (c) {
+    case 'c':
+      PrintCacheStats();
+      break;
+    case 'r':
+      lv_draw_cache_stats_reset();
+      Serial.println("Cache counters reset");
+      break;
+    case 'm':
+      PrintMemStats();
+      break;
+    case 's':
+      if (!soakRunning) StartSoak();
+      break;
+  }
 }
 
 void loop() {
   lv_timer_handler();
 
-  if (Serial2.available()) {
+  if (binaryMode) {
+    while (Serial2.available()) {
+      uint8_t b = Serial2.read();
+      ScanForHello(b);
+      if (bytesSinceGoodFrame < LINK_GARBAGE_LIMIT) bytesSinceGoodFrame++;
+      if (frameParser.Feed(b)) {
+        bytesSinceGoodFrame = 0;
+        do {
+          HandleFrame(frameParser.GetFrame());
+        } while (frameParser.Next());
+      }
+    }
+    LinkPeriodic();
+  } else if (Serial2.available()) {
     String msg = Serial2.readStringUntil('\n');
     Serial.println(msg);
     msg.trim();
 
-    if (msg.startsWith("SETSCREEN:")) {
-      int idx = msg.substring(10).toInt();
-      switch (idx) {
-        case 0:
-          lv_scr_load(ui_SPLASH_SCREEN);
-          break;
-        case 1:
-          lv_scr_load(ui_MAIN_CONTROL_SCREEN);
-          break;
-        case 2:
-          lv_scr_load(ui_PARAMETER_EDIT_SCREEN);
-          lv_textarea_set_text(ui_PARAMETER_INPUT_TEXT_AREA, "");
-          setupNumericKeyboard(ui_PARAMETER_INPUT_KEYBOARD, ui_PARAMETER_INPUT_TEXT_AREA);
-          lv_keyboard_set_textarea(ui_PARAMETER_INPUT_KEYBOARD, ui_PARAMETER_INPUT_TEXT_AREA);
-          lv_obj_add_state(ui_PARAMETER_INPUT_TEXT_AREA, LV_STATE_FOCUSED);
-          lv_textarea_set_cursor_pos(ui_PARAMETER_INPUT_TEXT_AREA, LV_TEXTAREA_CURSOR_LAST);
-          break;
-        case 3:
-          lv_scr_load(ui_SETTINGS_SCREEN);
-          break;
-        case 4:
-          lv_scr_load(ui_OUTSIDE_RANGE_ERROR_SCREEN);
-          break;
-        case 5:
-          lv_scr_load(ui_HOMING_ALERT_SCREEN);
-          break;
-        case 6:
-          lv_scr_load(ui_PLEASE_HOME_ERROR_SCREEN);
-          break;
-        default:
-          lv_scr_load(ui_SPLASH_SCREEN);
-          break;
-      }
+    if (HandleHello(msg)) {
+      // ClearCore restarted and handshook again
+    } else if (msg.startsWith("SETSCREEN:")) {
+      HandleSetScreen(msg.substring(10).toInt());
     } else if (msg.startsWith("SETLABEL:")) {
       Serial.print("Incoming setlabel: ");
       Serial.println(msg);
       int a = msg.indexOf(':'), b = msg.indexOf(':', a + 1);
       if (a >= 0 && b >= 0) {
-        int li = msg.substring(a + 1, b).toInt();
         String labelText = msg.substring(b + 1);
-        if (li == 1) {
-          lv_scr_load(ui_MAIN_CONTROL_SCREEN);
-          lv_label_set_text(ui_CURRENT_MEASUREMENT_LABEL, labelText.c_str());
-          Serial.println(lv_label_get_text(ui_CURRENT_MEASUREMENT_LABEL));
-        }
+        HandleSetLabel(msg.substring(a + 1, b).toInt(), labelText.c_str());
       }
-    } else if (msg.startsWith("SETSWITCHTOSTATE:")) {  // it takes in and uses the button index (for example, 11 is inches enabled and 12 is inches but it corresponds to on/off switch)
+    } else if (msg.startsWith("SETSWITCHTOSTATE:")) {
       int a = msg.indexOf(':');
-      int index = msg.substring(a + 1, msg.length()).toInt();
-      if (index == 12) {
-        lv_obj_add_state(ui_UNIT_SWITCH, LV_STATE_CHECKED);  //on, millimeters
-      } else if (index == 11) {
-        lv_obj_clear_state(ui_UNIT_SWITCH, LV_STATE_CHECKED);
-      }
+      HandleSetSwitch(msg.substring(a + 1, msg.length()).toInt());
     }
   }
 
+  UpdateLivePosition();
+
+  if (Serial.available()) {
+    HandleDebugCommand(Serial.read());
+  }
+  if (soakRunning) {
+    SoakStep();
+  }
+
   delay(10);
-}
\ No newline at end of file
+}
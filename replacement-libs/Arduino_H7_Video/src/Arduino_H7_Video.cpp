@@ -26,6 +26,7 @@
 #include "Arduino_H7_Video.h"
 
 #include "dsi.h"
+#include "rotate.h"
 #include "SDRAM.h"
 extern "C" {
 #include "video_modes.h"
@@ -49,7 +50,29 @@ static void inc_thd() {
 static rtos::Thread lvgl_inc_thd;
 #else
 void lvgl_displayFlushing(lv_disp_drv_t * disp, const lv_area_t * area, lv_color_t * color_p);
+void lvgl_framebufferFlushing(lv_disp_drv_t * disp, const lv_area_t * area, lv_color_t * color_p);
+void lvgl_framebufferCopy(lv_draw_ctx_t * draw_ctx, void * dest_buf, lv_coord_t dest_stride, const lv_area_t * dest_area,
+                          void * src_buf, lv_coord_t src_stride, const lv_area_t * src_area);
 #endif
+/* Set by begin(), flushes finish from the DMA2D interrupt instead of waiting for it */
+static bool lvgl_asyncFlush = false;
+/* Rotated displays, allocated once by begin() at the draw buffer's size instead of on every flush */
+static void * lvgl_rotateBuf = NULL;
+/* LV_DRAW_CACHE_CUSTOM_ALLOC/FREE in lv_conf.h, the image, gradient and shadow caches */
+extern "C" void * lvgl_sdramAlloc(size_t size);
+extern "C" void lvgl_sdramFree(void * ptr);
+/* LV_MEM_POOL_ALLOC in lv_conf.h, LVGL's own TLSF heap */
+extern "C" void * lvgl_sdramPool(size_t size);
+#endif
+
+/* SDRAM kept back for LVGL's heap between the framebuffers and what SDRAM.malloc() manages */
+#if __has_include("lvgl.h") && defined(LV_MEM_CUSTOM) && defined(LV_MEM_POOL_ALLOC)
+#if (LV_MEM_CUSTOM == 0)
+#define LVGL_MEM_POOL_SIZE  ((LV_MEM_SIZE + 31) & ~31)
+#endif
+#endif
+#ifndef LVGL_MEM_POOL_SIZE
+#define LVGL_MEM_POOL_SIZE  0
 #endif
 
 /* Functions -----------------------------------------------------------------*/
@@ -80,7 +103,7 @@ Arduino_H7_Video::Arduino_H7_Video(int width, int height, H7DisplayShield &shiel
 Arduino_H7_Video::~Arduino_H7_Video() {
 }
 
-int Arduino_H7_Video::begin() {
+int Arduino_H7_Video::begin(H7VideoRenderMode renderMode) {
 #ifdef HAS_ARDUINOGRAPHICS
   if (!ArduinoGraphics::begin()) {
     return 1; /* Unknown err */
@@ -92,20 +115,45 @@ int Arduino_H7_Video::begin() {
   /* Video controller/bridge init */
   _shield->init(_edidMode);
 
+  /* Configure SDRAM, before LVGL so its heap and caches can be allocated there */
+  SDRAM.begin(dsi_getFramebufferEnd() + LVGL_MEM_POOL_SIZE); //FIXME: SDRAM init after video controller init can cause display glitch at start-up
+
   #if __has_include("lvgl.h")
     /* Initiliaze LVGL library */
     lv_init();
 
+    /* LVGL can only draw straight into the framebuffers when they share its coordinates, the LTDC doesn't rotate */
+    if ((renderMode == H7_VIDEO_RENDER_DIRECT || renderMode == H7_VIDEO_RENDER_FULL) &&
+        (_rotated || (uint32_t)width() != dsi_getDisplayXSize() || (uint32_t)height() != dsi_getDisplayYSize())) {
+      renderMode = H7_VIDEO_RENDER_PARTIAL_DOUBLE;
+    }
+    lvgl_asyncFlush = (renderMode == H7_VIDEO_RENDER_PARTIAL_DOUBLE);
 
   #if (LVGL_VERSION_MAJOR == 9)
+    /* The framebuffer modes are LVGL 8 only for now */
+    if (renderMode == H7_VIDEO_RENDER_DIRECT || renderMode == H7_VIDEO_RENDER_FULL) {
+      renderMode = H7_VIDEO_RENDER_PARTIAL_DOUBLE;
+      lvgl_asyncFlush = true;
+    }
+
     /* Create a draw buffer */
     static lv_color_t * buf1 = (lv_color_t*)malloc((width() * height() / 10)); /* Declare a buffer for 1/10 screen size */
     if (buf1 == NULL) {
       return 2; /* Insuff memory err */
     }
-    static lv_color_t * buf2 = (lv_color_t*)malloc((width() * height() / 10)); /* Declare a buffer for 1/10 screen size */
-    if (buf2 == NULL) {
-      return 2; /* Insuff memory err */
+    static lv_color_t * buf2 = NULL;
+    if (lvgl_asyncFlush) {
+      buf2 = (lv_color_t*)malloc((width() * height() / 10)); /* Second buffer, rendered into while the first is copied */
+      if (buf2 == NULL) {
+        return 2; /* Insuff memory err */
+      }
+    }
+
+    if (_rotated) {
+      lvgl_rotateBuf = malloc((width() * height() / 10)); /* Strips rotate into this, same size as a draw buffer */
+      if (lvgl_rotateBuf == NULL) {
+        return 2; /* Insuff memory err */
+      }
     }
 
     lv_display_t *display;
@@ -116,7 +164,7 @@ int Arduino_H7_Video::begin() {
     } else {
       display = lv_display_create(width(), height());
     }
-    lv_display_set_buffers(display, buf1, NULL, width() * height() / 10, LV_DISPLAY_RENDER_MODE_PARTIAL);  /*Initialize the display buffer.*/
+    lv_display_set_buffers(display, buf1, buf2, width() * height() / 10, LV_DISPLAY_RENDER_MODE_PARTIAL);  /*Initialize the display buffer.*/
     lv_display_set_flush_cb(display, lvgl_displayFlushing);
 
     lvgl_inc_thd.start(inc_thd);
@@ -126,11 +174,25 @@ int Arduino_H7_Video::begin() {
       /* Create a draw buffer */
     static lv_disp_draw_buf_t draw_buf;
     static lv_color_t * buf1;
-    buf1 = (lv_color_t*)malloc((width() * height() / 10) * sizeof(lv_color_t)); /* Declare a buffer for 1/10 screen size */
-    if (buf1 == NULL) {
-      return 2; /* Insuff memory err */
+    static lv_color_t * buf2 = NULL;
+    if (renderMode == H7_VIDEO_RENDER_DIRECT || renderMode == H7_VIDEO_RENDER_FULL) {
+      /* The two SDRAM framebuffers are the draw buffers, LVGL starts on the one that isn't shown */
+      buf1 = (lv_color_t*)dsi_getCurrentFrameBuffer();
+      buf2 = (lv_color_t*)dsi_getActiveFrameBuffer();
+      lv_disp_draw_buf_init(&draw_buf, buf1, buf2, width() * height());
+    } else {
+      buf1 = (lv_color_t*)malloc((width() * height() / 10) * sizeof(lv_color_t)); /* Declare a buffer for 1/10 screen size */
+      if (buf1 == NULL) {
+        return 2; /* Insuff memory err */
+      }
+      if (lvgl_asyncFlush) {
+        buf2 = (lv_color_t*)malloc((width() * height() / 10) * sizeof(lv_color_t)); /* Second buffer, rendered into while the first is copied */
+        if (buf2 == NULL) {
+          return 2; /* Insuff memory err */
+        }
+      }
+      lv_disp_draw_buf_init(&draw_buf, buf1, buf2, width() * height() / 10);      /* Initialize the display buffer. */
     }
-    lv_disp_draw_buf_init(&draw_buf, buf1, NULL, width() * height() / 10);      /* Initialize the display buffer. */
 
     /* Initialize display features for LVGL library */
     static lv_disp_drv_t disp_drv;              /* Descriptor of a display driver */
@@ -146,15 +208,28 @@ int Arduino_H7_Video::begin() {
       disp_drv.ver_res = height();        /* Set the vertical resolution of the display */
       disp_drv.rotated  = LV_DISP_ROT_NONE;
     }
-    disp_drv.sw_rotate = 1;
-    lv_disp_drv_register(&disp_drv);        /* Finally register the driver */
+    if (_rotated) {
+      /* The flush rotates whole strips itself, LVGL's sw_rotate would flush them in 10 KB pieces and serially */
+      lvgl_rotateBuf = malloc((width() * height() / 10) * sizeof(lv_color_t));
+      if (lvgl_rotateBuf == NULL) {
+        return 2; /* Insuff memory err */
+      }
+    }
+    disp_drv.sw_rotate = 0;
+    if (renderMode == H7_VIDEO_RENDER_DIRECT || renderMode == H7_VIDEO_RENDER_FULL) {
+      disp_drv.flush_cb     = lvgl_framebufferFlushing;
+      disp_drv.direct_mode  = (renderMode == H7_VIDEO_RENDER_DIRECT);
+      disp_drv.full_refresh = (renderMode == H7_VIDEO_RENDER_FULL);
+    }
+    lv_disp_t * disp = lv_disp_drv_register(&disp_drv);        /* Finally register the driver */
+    if (disp_drv.direct_mode) {
+      /* LVGL brings the off screen framebuffer up to date with what changed on the other one, let the DMA2D do that copy */
+      disp->driver->draw_ctx->buffer_copy = lvgl_framebufferCopy;
+    }
 
   #endif
   #endif
 
-  /* Configure SDRAM */
-  SDRAM.begin(dsi_getFramebufferEnd()); //FIXME: SDRAM init after video controller init can cause display glitch at start-up
-
   return 0;
 }
 
@@ -231,19 +306,22 @@ void Arduino_H7_Video::set(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
 
 #if __has_include("lvgl.h")
 #if (LVGL_VERSION_MAJOR == 9)
-static uint8_t* rotated_buf = nullptr;
+static void lvgl_flushDone(void * disp) {
+    lv_display_flush_ready((lv_display_t *)disp);
+}
+
 void lvgl_displayFlushing(lv_display_t * disp, const lv_area_t * area, unsigned char * px_map) {
     uint32_t w     = lv_area_get_width(area);
     uint32_t h     = lv_area_get_height(area);
     lv_area_t* area_in_use = (lv_area_t *)area;
 
-    // TODO: find a smart way to tackle sw rotation
     lv_display_rotation_t rotation = lv_display_get_rotation(disp);
     lv_area_t rotated_area;
     if (rotation != LV_DISPLAY_ROTATION_0) {
-        rotated_buf = (uint8_t*)realloc(rotated_buf, w * h * 4);
+        /* The previous strip's DMA2D copy may still be reading the rotate buffer */
+        dsi_waitTransfer();
         lv_color_format_t cf = lv_display_get_color_format(disp);
-        lv_draw_sw_rotate(px_map, rotated_buf,
+        lv_draw_sw_rotate(px_map, lvgl_rotateBuf,
                           w, h, lv_draw_buf_width_to_stride(w, cf),
                           lv_draw_buf_width_to_stride(h, cf),
                           LV_DISPLAY_ROTATION_90, cf);
@@ -254,7 +332,7 @@ void lvgl_displayFlushing(lv_display_t * disp, const lv_area_t * area, unsigned
         rotated_area.y2 = rotated_area.y1 + w + 1;
 
         area_in_use = &rotated_area;
-        px_map = rotated_buf;
+        px_map = (unsigned char *)lvgl_rotateBuf;
         auto temp = w;
         w = h;
         h = temp;
@@ -262,19 +340,137 @@ void lvgl_displayFlushing(lv_display_t * disp, const lv_area_t * area, unsigned
 
     uint32_t offsetPos  = (area_in_use->x1 + (dsi_getDisplayXSize() * area_in_use->y1)) * sizeof(uint16_t);
 
+    if (lvgl_asyncFlush) {
+        /* The DMA2D interrupt reports the flush as ready, px_map (or lvgl_rotateBuf) stays untouched until then */
+        dsi_lcdDrawImageAsync((void *) px_map, (void *)(dsi_getActiveFrameBuffer() + offsetPos), w, h, DMA2D_INPUT_RGB565, lvgl_flushDone, disp);
+        return;
+    }
     dsi_lcdDrawImage((void *) px_map, (void *)(dsi_getActiveFrameBuffer() + offsetPos), w, h, DMA2D_INPUT_RGB565);
     lv_display_flush_ready(disp);         /* Indicate you are ready with the flushing*/
 }
 #else
+static void lvgl_flushDone(void * disp) {
+    lv_disp_flush_ready((lv_disp_drv_t *)disp);   /* Safe from the interrupt, it only clears the flushing flags */
+}
+
+/* Turns an area LVGL drew in its own orientation into the panel's, hor_res and ver_res are the panel's size */
+static lv_color_t * lvgl_rotate(lv_disp_drv_t * disp, const lv_area_t * area, lv_color_t * color_p, lv_area_t * rotated) {
+    uint32_t w = lv_area_get_width(area);
+    uint32_t h = lv_area_get_height(area);
+    uint16_t * src = (uint16_t *)color_p;
+    uint16_t * dst = (uint16_t *)lvgl_rotateBuf;
+
+    /* The previous strip's DMA2D copy may still be reading the rotate buffer */
+    dsi_waitTransfer();
+
+    switch (disp->rotated) {
+      case LV_DISP_ROT_90:
+        rotate_rgb565(src, w, dst, h, w, h, ROTATE_90_CCW);
+        rotated->x1 = area->y1;
+        rotated->x2 = area->y2;
+        rotated->y1 = disp->ver_res - 1 - area->x2;
+        rotated->y2 = disp->ver_res - 1 - area->x1;
+        break;
+      case LV_DISP_ROT_180:
+        rotate_rgb565(src, w, dst, w, w, h, ROTATE_180);
+        rotated->x1 = disp->hor_res - 1 - area->x2;
+        rotated->x2 = disp->hor_res - 1 - area->x1;
+        rotated->y1 = disp->ver_res - 1 - area->y2;
+        rotated->y2 = disp->ver_res - 1 - area->y1;
+        break;
+      default: /* LV_DISP_ROT_270 */
+        rotate_rgb565(src, w, dst, h, w, h, ROTATE_90_CW);
+        rotated->x1 = disp->hor_res - 1 - area->y2;
+        rotated->x2 = disp->hor_res - 1 - area->y1;
+        rotated->y1 = area->x1;
+        rotated->y2 = area->x2;
+        break;
+    }
+    return (lv_color_t *)lvgl_rotateBuf;
+}
+
 void lvgl_displayFlushing(lv_disp_drv_t * disp, const lv_area_t * area, lv_color_t * color_p) {
+    lv_area_t rotated_area;
+    if (disp->rotated != LV_DISP_ROT_NONE) {
+        color_p = lvgl_rotate(disp, area, color_p, &rotated_area);
+        area = &rotated_area;
+    }
+
     uint32_t width      = lv_area_get_width(area);
     uint32_t height     = lv_area_get_height(area);
     uint32_t offsetPos  = (area->x1 + (dsi_getDisplayXSize() * area->y1)) * sizeof(uint16_t);
 
+    if (lvgl_asyncFlush) {
+        /* LVGL goes on rendering into the other draw buffer, the DMA2D interrupt hands this one back */
+        dsi_lcdDrawImageAsync((void *) color_p, (void *)(dsi_getActiveFrameBuffer() + offsetPos), width, height, DMA2D_INPUT_RGB565, lvgl_flushDone, disp);
+        return;
+    }
     dsi_lcdDrawImage((void *) color_p, (void *)(dsi_getActiveFrameBuffer() + offsetPos), width, height, DMA2D_INPUT_RGB565);
     lv_disp_flush_ready(disp);         /* Indicate you are ready with the flushing*/
 }
+
+/* Direct and full refresh modes, color_p is a whole framebuffer that LVGL drew into in place */
+void lvgl_framebufferFlushing(lv_disp_drv_t * disp, const lv_area_t * area, lv_color_t * color_p) {
+    uint32_t fb = (uint32_t)color_p;
+
+    /* The CPU drew it, so it has to be written back from the cache before the LTDC scans it out */
+    if (disp->direct_mode) {
+        dsi_cleanFrameBufferArea(fb, area->x1, area->y1, lv_area_get_width(area), lv_area_get_height(area));
+    }
+    if (!lv_disp_flush_is_last(disp)) {
+        lv_disp_flush_ready(disp);
+        return;
+    }
+    if (disp->full_refresh) {
+        dsi_cleanFrameBufferArea(fb, 0, 0, dsi_getDisplayXSize(), dsi_getDisplayYSize());
+    }
+
+    /* Shown from the next vertical blank on. The reload interrupt reports the flush as ready, until then the other
+       buffer is still on screen and LVGL must not draw into it. */
+    dsi_drawCurrentFrameBufferAsync(lvgl_flushDone, disp);
+}
+
+/* Syncs the areas that changed on screen into the off screen buffer before LVGL draws the next frame there.
+   Both are whole framebuffers in direct mode, so the strides are the display width and the areas match. */
+void lvgl_framebufferCopy(lv_draw_ctx_t * draw_ctx, void * dest_buf, lv_coord_t dest_stride, const lv_area_t * dest_area,
+                          void * src_buf, lv_coord_t src_stride, const lv_area_t * src_area) {
+    LV_UNUSED(draw_ctx);
+    LV_UNUSED(dest_stride);
+    LV_UNUSED(src_stride);
+    LV_UNUSED(src_area);
+
+    /* LVGL 8.3's refr_sync_areas() copies without waiting for flush_ready. Until the queued flip has happened
+       dest_buf is still the one being scanned out. */
+    dsi_waitFlip();
+    dsi_lcdCopyArea((uint32_t)src_buf, (uint32_t)dest_buf, dest_area->x1, dest_area->y1,
+                    lv_area_get_width(dest_area), lv_area_get_height(dest_area));
+}
 #endif
+
+/* SDRAM past the framebuffers, internal RAM if that is full. Everything in internal RAM sits below the SDRAM. */
+void * lvgl_sdramAlloc(size_t size) {
+    void * ptr = SDRAM.malloc(size);
+    if (ptr == NULL) {
+        ptr = malloc(size);
+    }
+    return ptr;
+}
+
+void lvgl_sdramFree(void * ptr) {
+    if ((uint32_t)ptr >= dsi_getFramebufferEnd()) {
+        SDRAM.free(ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+/* Called once from lv_init(), the pool is the LVGL_MEM_POOL_SIZE bytes begin() left out of SDRAM.begin() */
+void * lvgl_sdramPool(size_t size) {
+    if (size > LVGL_MEM_POOL_SIZE) {
+        return NULL;
+    }
+    return (void *)dsi_getFramebufferEnd();
+}
 #endif
 
 /**** END OF FILE ****/
\ No newline at end of file
@@ -39,6 +39,17 @@
 
 /* Exported enumeration ------------------------------------------------------*/
 
+/**
+ * @enum H7VideoRenderMode
+ * @brief How LVGL renders into the display, passed to begin().
+ */
+typedef enum {
+  H7_VIDEO_RENDER_PARTIAL,        /**< One 1/10 screen draw buffer, every flush waits for its DMA2D copy (default) */
+  H7_VIDEO_RENDER_PARTIAL_DOUBLE, /**< Two 1/10 screen draw buffers, LVGL renders into one while the DMA2D copies the other */
+  H7_VIDEO_RENDER_DIRECT,         /**< LVGL draws the changed areas straight into the back framebuffer, swapped on vsync */
+  H7_VIDEO_RENDER_FULL            /**< LVGL redraws the whole back framebuffer every refresh, swapped on vsync */
+} H7VideoRenderMode;
+
 /* Class ----------------------------------------------------------------------*/
 
 /**
@@ -76,9 +87,15 @@ public:
   /**
    * @brief Initialize the video controller and display.
    * 
+   * @param renderMode How LVGL renders into the display, ignored without LVGL.
+   *                   - H7_VIDEO_RENDER_PARTIAL: single draw buffer, blocking flush
+   *                   - H7_VIDEO_RENDER_PARTIAL_DOUBLE: two draw buffers, flush completes from the DMA2D interrupt
+   *                   - H7_VIDEO_RENDER_DIRECT: draw into the framebuffers, only the changed areas (LVGL 8, unrotated)
+   *                   - H7_VIDEO_RENDER_FULL: draw into the framebuffers, the whole screen (LVGL 8, unrotated)
+   *                   The framebuffer modes fall back to H7_VIDEO_RENDER_PARTIAL_DOUBLE where they can't be used.
    * @return int 0 if initialization is successful, otherwise an error code.
    */
-  int begin();
+  int begin(H7VideoRenderMode renderMode = H7_VIDEO_RENDER_PARTIAL);
 
   /**
    * @brief De-initialize the video controller and display.
@@ -23,6 +23,8 @@
 #define FB_ADDRESS_0 		(FB_BASE_ADDRESS)
 #define FB_ADDRESS_1 		(FB_BASE_ADDRESS + (LCD_MAX_X_SIZE * LCD_MAX_Y_SIZE * BYTES_PER_PIXEL))
 
+#define DCACHE_WHOLE_THRESHOLD	(64 * 1024)
+
 /* Private variables ---------------------------------------------------------*/
 static DMA2D_HandleTypeDef dma2d;
 static LTDC_HandleTypeDef  ltdc;
@@ -37,12 +39,29 @@ static uint32_t pend_buffer = 0;
 
 volatile uint32_t reloadLTDC_status = 0;
 
+/* Page flip queued for the next vertical blank, see dsi_drawCurrentFrameBufferAsync() */
+static volatile uint32_t flip_pending = 0;
+static void (*flip_done)(void *) = NULL;
+static void *flip_done_arg = NULL;
+static uint32_t flip_request_us = 0;
+static uint32_t frame_period_us = 0;
+static dsi_frame_stats_t frame_stats;
+
+/* Interrupt driven DMA2D transfer in flight, see dsi_lcdDrawImageAsync() */
+static volatile uint32_t dma2d_busy = 0;
+static void (*dma2d_done)(void *) = NULL;
+static void *dma2d_done_arg = NULL;
+
 /* Exported variables --------------------------------------------------------*/
 DSI_HandleTypeDef   dsi;
 
 /* Private function prototypes -----------------------------------------------*/
 static void dsi_fillBuffer(uint32_t LayerIndex, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t OffLine, uint32_t ColorIndex);
 static void dsi_layerInit(uint16_t LayerIndex, uint32_t FB_Address);
+static bool dsi_startDrawImage(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode, bool interrupt);
+static void dsi_transferDone(DMA2D_HandleTypeDef *hdma2d);
+static void dsi_cacheMaintenance(void *addr, uint32_t size, bool clean, bool invalidate);
+static void dsi_swapLayers(void);
 
 /* Functions -----------------------------------------------------------------*/
 int dsi_init(uint8_t bus, struct edid *edid, struct display_timing *dt) {
@@ -72,6 +91,10 @@ int dsi_init(uint8_t bus, struct edid *edid, struct display_timing *dt) {
 	static const uint32_t LTDC_PLL3R = 1000 / LTDC_FREQ_STEP; // expected pixel clock
 	dt->pixelclock = (LTDC_PLL3N) *LTDC_FREQ_STEP; 	// real pixel clock
 
+	/* One refresh, for telling a late page flip from one that only waited for its vertical blank */
+	frame_period_us = (uint32_t)((uint64_t)(dt->hactive + dt->hsync_len + dt->hback_porch + dt->hfront_porch) *
+					  (dt->vactive + dt->vsync_len + dt->vback_porch + dt->vfront_porch) * 1000 / dt->pixelclock);
+
 	static const uint32_t LANE_BYTE_CLOCK =	62500;
 
 	// TODO: switch USB to use HSI48
@@ -266,20 +289,123 @@ void dsi_lcdFillArea(void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorM
 }
 
 void dsi_lcdDrawImage(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode) {
-#if defined(__CORTEX_M7) 
-	SCB_CleanInvalidateDCache();
-	SCB_InvalidateICache();
-#endif
-	
-	/* Configure the DMA2D Mode, Color Mode and output offset */
-	dma2d.Init.Mode         = DMA2D_M2M_PFC;
+	dsi_waitTransfer();
+
+	if (dsi_startDrawImage(pSrc, pDst, xSize, ySize, ColorMode, false)) {
+		/* Polling For DMA transfer */
+		HAL_DMA2D_PollForTransfer(&dma2d, 25);
+	}
+}
+
+void dsi_lcdDrawImageAsync(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode, void (*done)(void *), void *arg) {
+	/* Only one transfer at a time, the previous one is normally long done by the time the next strip is rendered */
+	dsi_waitTransfer();
+
+	dma2d_done = done;
+	dma2d_done_arg = arg;
+	dma2d_busy = 1;
+	if (!dsi_startDrawImage(pSrc, pDst, xSize, ySize, ColorMode, true)) {
+		/* Never started, don't leave the caller waiting for an interrupt that won't come */
+		dsi_transferDone(&dma2d);
+	}
+}
+
+void dsi_lcdCopyArea(uint32_t srcFb, uint32_t dstFb, uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize) {
+	uint32_t offsetPos = (x + lcd_x_size * y) * BYTES_PER_PIXEL;
+	uint32_t span = ((ySize - 1) * lcd_x_size + xSize) * BYTES_PER_PIXEL;
+
+	dsi_waitTransfer();
+
+	dsi_cacheMaintenance((void *)(srcFb + offsetPos), span, true, false);
+	dsi_cacheMaintenance((void *)(dstFb + offsetPos), span, true, true);
+
+	/* Plain memory to memory, both sides are RGB565 with the framebuffer stride */
+	dma2d.Init.Mode         = DMA2D_M2M;
 	dma2d.Init.ColorMode    = DMA2D_OUTPUT_RGB565;
 	dma2d.Init.OutputOffset = lcd_x_size - xSize;
 
+	dma2d.LayerCfg[1].AlphaMode = DMA2D_NO_MODIF_ALPHA;
+	dma2d.LayerCfg[1].InputAlpha = 0xFF;
+	dma2d.LayerCfg[1].InputColorMode = DMA2D_INPUT_RGB565;
+	dma2d.LayerCfg[1].InputOffset = lcd_x_size - xSize;
+
+	dma2d.Instance = DMA2D;
+
+	if(HAL_DMA2D_Init(&dma2d) == HAL_OK) {
+		if(HAL_DMA2D_ConfigLayer(&dma2d, 1) == HAL_OK) {
+			if (HAL_DMA2D_Start(&dma2d, srcFb + offsetPos, dstFb + offsetPos, xSize, ySize) == HAL_OK) {
+				HAL_DMA2D_PollForTransfer(&dma2d, 25);
+			}
+		}
+	}
+}
+
+void dsi_cleanFrameBufferArea(uint32_t fb, uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize) {
+	uint32_t offsetPos = (x + lcd_x_size * y) * BYTES_PER_PIXEL;
+
+	dsi_cacheMaintenance((void *)(fb + offsetPos), ((ySize - 1) * lcd_x_size + xSize) * BYTES_PER_PIXEL, true, false);
+}
+
+bool dsi_isTransferBusy(void) {
+	return dma2d_busy != 0;
+}
+
+void dsi_waitTransfer(void) {
+	while (dma2d_busy) {
+		/* Wait for the DMA2D interrupt */
+	}
+}
+
+static uint32_t dsi_inputBytesPerPixel(uint32_t ColorMode) {
+	switch (ColorMode) {
+		case DMA2D_INPUT_ARGB8888:	return 4;
+		case DMA2D_INPUT_RGB888:	return 3;
+		case DMA2D_INPUT_L8:		return 1;
+		default:					return 2;
+	}
+}
+
+/* Clean and/or invalidate just the cache lines covering [addr, addr + size), not the whole D-cache */
+static void dsi_cacheMaintenance(void *addr, uint32_t size, bool clean, bool invalidate) {
+#if defined(__CORTEX_M7)
+	/* Past a few times the cache size walking the range by address costs more than cleaning all of it */
+	if (clean && size >= DCACHE_WHOLE_THRESHOLD) {
+		if (invalidate) {
+			SCB_CleanInvalidateDCache();
+		} else {
+			SCB_CleanDCache();
+		}
+		return;
+	}
+
+	uint32_t start = (uint32_t)addr & ~(__SCB_DCACHE_LINE_SIZE - 1U);
+	int32_t length = (int32_t)(((uint32_t)addr + size) - start);
+
+	if (clean && invalidate) {
+		SCB_CleanInvalidateDCache_by_Addr((uint32_t *)start, length);
+	} else if (clean) {
+		SCB_CleanDCache_by_Addr((uint32_t *)start, length);
+	} else if (invalidate) {
+		SCB_InvalidateDCache_by_Addr((uint32_t *)start, length);
+	}
+#endif
+}
+
+static bool dsi_startDrawImage(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode, bool interrupt) {
 	if (pDst == NULL) {
 		pDst = (uint32_t *)(ltdc.LayerCfg[pend_buffer%2].FBStartAdress);
 	}
 
+	/* The source has to reach memory before the DMA2D reads it. The destination rows are written back and dropped
+	   from the cache, so neither a late eviction nor a stale line can hide what the DMA2D puts there. */
+	dsi_cacheMaintenance(pSrc, xSize * ySize * dsi_inputBytesPerPixel(ColorMode), true, false);
+	dsi_cacheMaintenance(pDst, ((ySize - 1) * lcd_x_size + xSize) * BYTES_PER_PIXEL, true, true);
+
+	/* Configure the DMA2D Mode, Color Mode and output offset */
+	dma2d.Init.Mode         = DMA2D_M2M_PFC;
+	dma2d.Init.ColorMode    = DMA2D_OUTPUT_RGB565;
+	dma2d.Init.OutputOffset = lcd_x_size - xSize;
+
 	/* Foreground Configuration */
 	dma2d.LayerCfg[1].AlphaMode = DMA2D_REPLACE_ALPHA;
 	dma2d.LayerCfg[1].InputAlpha = 0x00;
@@ -289,13 +415,26 @@ void dsi_lcdDrawImage(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, ui
 	dma2d.Instance = DMA2D;
 
 	/* DMA2D Initialization */
-	if(HAL_DMA2D_Init(&dma2d) == HAL_OK) {
-		if(HAL_DMA2D_ConfigLayer(&dma2d, 1) == HAL_OK) {
-			if (HAL_DMA2D_Start(&dma2d, (uint32_t)pSrc, (uint32_t)pDst, xSize, ySize) == HAL_OK) {
-				/* Polling For DMA transfer */
-				HAL_DMA2D_PollForTransfer(&dma2d, 25);
-			}
-		}
+	if (HAL_DMA2D_Init(&dma2d) != HAL_OK || HAL_DMA2D_ConfigLayer(&dma2d, 1) != HAL_OK) {
+		return false;
+	}
+	if (!interrupt) {
+		return HAL_DMA2D_Start(&dma2d, (uint32_t)pSrc, (uint32_t)pDst, xSize, ySize) == HAL_OK;
+	}
+	dma2d.XferCpltCallback  = dsi_transferDone;
+	dma2d.XferErrorCallback = dsi_transferDone;
+	return HAL_DMA2D_Start_IT(&dma2d, (uint32_t)pSrc, (uint32_t)pDst, xSize, ySize) == HAL_OK;
+}
+
+/* DMA2D transfer complete (or error), runs in the interrupt */
+static void dsi_transferDone(DMA2D_HandleTypeDef *hdma2d) {
+	void (*done)(void *) = dma2d_done;
+	void *arg = dma2d_done_arg;
+
+	dma2d_done = NULL;
+	dma2d_busy = 0;
+	if (done != NULL) {
+		done(arg);
 	}
 }
 
@@ -305,6 +444,8 @@ void dsi_configueCLUT(uint32_t *colors) {
 	clut.CLUTColorMode = DMA2D_CCM_ARGB8888;
 	clut.Size = 0xFF;
 
+	dsi_waitTransfer();
+
 #ifdef CORE_CM7
 	SCB_CleanInvalidateDCache();
 	SCB_InvalidateICache();
@@ -324,26 +465,70 @@ uint32_t dsi_getFramebufferEnd(void) {
 }
 
 void dsi_drawCurrentFrameBuffer(bool reload) {
-	int fb = pend_buffer++ % 2;
-
-	/* Enable current LTDC layer */
-	__HAL_LTDC_LAYER_ENABLE(&(ltdc), fb);
-	/* Disable active LTDC layer */
-	__HAL_LTDC_LAYER_DISABLE(&(ltdc), !fb);
-
 	if (!reload) {
+		dsi_waitTransfer();
+		dsi_waitFlip();
+		dsi_swapLayers();
 		return;
 	}
-	/* LTDC reload request within next vertical blanking */
+	dsi_drawCurrentFrameBufferAsync(NULL, NULL);
+	dsi_waitFlip();
+}
+
+void dsi_drawCurrentFrameBufferAsync(void (*done)(void *), void *arg) {
+	/* Don't show a buffer the DMA2D is still writing to */
+	dsi_waitTransfer();
+
+	/* The layer enables of a pending flip are still sitting in the shadow registers, one flip at a time */
+	if (flip_pending) {
+		frame_stats.stalls++;
+		dsi_waitFlip();
+	}
+
+	dsi_swapLayers();
+
+	flip_done = done;
+	flip_done_arg = arg;
+	flip_request_us = micros();
+	flip_pending = 1;
 	reloadLTDC_status = 0;
+	/* LTDC reload request within next vertical blanking, HAL_LTDC_ReloadEventCallback() finishes it */
 	HAL_LTDC_Reload(&ltdc, LTDC_SRCR_VBR);
-	
-	while(reloadLTDC_status == 0) {
-		/* Wait till reload takes effect */
-		delay(1);
+}
+
+bool dsi_isFlipPending(void) {
+	return flip_pending != 0;
+}
+
+void dsi_waitFlip(void) {
+	while (flip_pending) {
+		/* Sleep until the next interrupt, the reload one ends it */
+		__WFI();
 	}
 }
 
+void dsi_getFrameStats(dsi_frame_stats_t *stats) {
+	__disable_irq();
+	*stats = frame_stats;
+	__enable_irq();
+	stats->framePeriodUs = frame_period_us;
+}
+
+void dsi_clearFrameStats(void) {
+	__disable_irq();
+	memset(&frame_stats, 0, sizeof(frame_stats));
+	__enable_irq();
+}
+
+static void dsi_swapLayers(void) {
+	int fb = pend_buffer++ % 2;
+
+	/* Enable current LTDC layer */
+	__HAL_LTDC_LAYER_ENABLE(&(ltdc), fb);
+	/* Disable active LTDC layer */
+	__HAL_LTDC_LAYER_DISABLE(&(ltdc), !fb);
+}
+
 uint32_t dsi_getCurrentFrameBuffer() {
 	return (ltdc.LayerCfg[pend_buffer%2].FBStartAdress);
 }
@@ -384,6 +569,8 @@ void dsi_layerInit(uint16_t LayerIndex, uint32_t FB_Address) {
 }
 
 void dsi_fillBuffer(uint32_t LayerIndex, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t OffLine, uint32_t ColorIndex) {
+	dsi_waitTransfer();
+
 	/* Register to memory mode with ARGB8888 as color Mode */
 	dma2d.Init.Mode         = DMA2D_R2M;
 	dma2d.Init.ColorMode    = DMA2D_OUTPUT_RGB565;	//DMA2D_OUTPUT_ARGB8888
@@ -407,9 +594,34 @@ extern "C" void LTDC_IRQHandler(void) {
 	HAL_LTDC_IRQHandler(&ltdc);
 }
 
-/* Reload LTDC event callback */
+/* Handler for DMA2D global interrupt request */
+extern "C" void DMA2D_IRQHandler(void) {
+	HAL_DMA2D_IRQHandler(&dma2d);
+}
+
+/* Reload LTDC event callback, the queued page flip is on screen now */
 extern "C" void HAL_LTDC_ReloadEventCallback(LTDC_HandleTypeDef *hltdc) {
-  reloadLTDC_status = 1;
+	uint32_t latency = micros() - flip_request_us;
+	void (*done)(void *) = flip_done;
+	void *arg = flip_done_arg;
+
+	frame_stats.flips++;
+	frame_stats.lastLatencyUs = latency;
+	frame_stats.totalLatencyUs += latency;
+	if (latency > frame_stats.maxLatencyUs) {
+		frame_stats.maxLatencyUs = latency;
+	}
+	/* Up to one refresh is just waiting for the blank, every refresh past that showed the old frame again */
+	if (frame_period_us != 0) {
+		frame_stats.missedVblanks += latency / frame_period_us;
+	}
+
+	flip_done = NULL;
+	flip_pending = 0;
+	reloadLTDC_status = 1;
+	if (done != NULL) {
+		done(arg);
+	}
 }
 
 /**** END OF FILE ****/
@@ -27,6 +27,17 @@ struct display_timing {
 	unsigned int vpol : 1;
 };
 
+/* Page flip counters, see dsi_getFrameStats() */
+typedef struct {
+	uint32_t flips;				/* page flips that made it to the screen */
+	uint32_t missedVblanks;		/* refreshes that went by with a flip still pending, each showed the old frame again */
+	uint32_t stalls;			/* flips requested while the previous one was still pending, the caller had to wait */
+	uint32_t lastLatencyUs;		/* flip request to the reload interrupt */
+	uint32_t maxLatencyUs;
+	uint64_t totalLatencyUs;
+	uint32_t framePeriodUs;		/* one refresh of the current video mode */
+} dsi_frame_stats_t;
+
 /* Exported variables --------------------------------------------------------*/
 extern DSI_HandleTypeDef dsi;
 
@@ -34,9 +45,19 @@ extern DSI_HandleTypeDef dsi;
 int			dsi_init(uint8_t bus, struct edid *edid, struct display_timing *dt);
 void		dsi_lcdClear(uint32_t color);
 void		dsi_lcdDrawImage(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode);
+void		dsi_lcdDrawImageAsync(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode, void (*done)(void *), void *arg);
+void		dsi_lcdCopyArea(uint32_t srcFb, uint32_t dstFb, uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize);
+void		dsi_cleanFrameBufferArea(uint32_t fb, uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize);
+bool		dsi_isTransferBusy(void);
+void		dsi_waitTransfer(void);
 void		dsi_lcdFillArea(void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode);
 void		dsi_configueCLUT(uint32_t* clut);
 void		dsi_drawCurrentFrameBuffer(bool reload = true);
+void		dsi_drawCurrentFrameBufferAsync(void (*done)(void *), void *arg);
+bool		dsi_isFlipPending(void);
+void		dsi_waitFlip(void);
+void		dsi_getFrameStats(dsi_frame_stats_t *stats);
+void		dsi_clearFrameStats(void);
 uint32_t	dsi_getCurrentFrameBuffer(void);
 uint32_t 	dsi_getActiveFrameBuffer(void);
 uint32_t	dsi_getFramebufferEnd(void);
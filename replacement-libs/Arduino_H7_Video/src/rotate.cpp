@@ -0,0 +1,111 @@
+/**
+  ******************************************************************************
+  * @file    rotate.cpp
+  * @author
+  * @version
+  * @date
+  * @brief   RGB565 rotation kernels, see rotate.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "rotate.h"
+
+#include <string.h>
+
+/* Private functions ---------------------------------------------------------*/
+
+/* Rotating a strip walks the destination down a column for every source row. Done a whole row at a time every
+   destination line gets evicted before the next row comes back for its neighbouring pixel, so the kernels below
+   work on ROTATE_TILE x ROTATE_TILE tiles instead and each line is filled while it is still cached. */
+
+static void rotate_tileCW(const uint16_t *src, uint32_t srcStride, uint16_t *dst, uint32_t dstStride,
+						  uint32_t h, uint32_t x0, uint32_t y0, uint32_t tw, uint32_t th) {
+	for (uint32_t x = x0; x < x0 + tw; x++) {
+		const uint16_t *s = src + (y0 + th - 1) * srcStride + x;
+		uint16_t *d = dst + x * dstStride + (h - y0 - th);
+		/* dst row x, left to right, is source column x from the bottom of the tile up */
+		for (uint32_t i = 0; i < th; i++) {
+			d[i] = *s;
+			s -= srcStride;
+		}
+	}
+}
+
+static void rotate_tileCCW(const uint16_t *src, uint32_t srcStride, uint16_t *dst, uint32_t dstStride,
+						   uint32_t w, uint32_t x0, uint32_t y0, uint32_t tw, uint32_t th) {
+	for (uint32_t x = x0; x < x0 + tw; x++) {
+		const uint16_t *s = src + y0 * srcStride + x;
+		uint16_t *d = dst + (w - 1 - x) * dstStride + y0;
+		/* dst row w - 1 - x, left to right, is source column x from the top of the tile down */
+		for (uint32_t i = 0; i < th; i++) {
+			d[i] = *s;
+			s += srcStride;
+		}
+	}
+}
+
+/* 180 degrees keeps rows as rows, no tiling needed, just two pixels per 32 bit access where the alignment allows */
+static void rotate_180(const uint16_t *src, uint32_t srcStride, uint16_t *dst, uint32_t dstStride, uint32_t w, uint32_t h) {
+	for (uint32_t y = 0; y < h; y++) {
+		const uint16_t *s = src + y * srcStride;
+		uint16_t *d = dst + (h - 1 - y) * dstStride + (w - 1);
+		uint32_t x = 0;
+
+		if ((((uintptr_t)s | (uintptr_t)(d - 1)) & 3) == 0) {
+			for (; x + 1 < w; x += 2) {
+				uint32_t pair;
+				memcpy(&pair, s + x, sizeof(pair));
+				/* swap the two pixels while storing them mirrored */
+				pair = (pair >> 16) | (pair << 16);
+				memcpy(d - x - 1, &pair, sizeof(pair));
+			}
+		}
+		for (; x < w; x++) {
+			d[-(int32_t)x] = s[x];
+		}
+	}
+}
+
+/* Exported functions --------------------------------------------------------*/
+void rotate_rgb565(const uint16_t *src, uint32_t srcStride, uint16_t *dst, uint32_t dstStride,
+				   uint32_t w, uint32_t h, rotate_angle_t angle) {
+	if (angle == ROTATE_180) {
+		rotate_180(src, srcStride, dst, dstStride, w, h);
+		return;
+	}
+
+	for (uint32_t y0 = 0; y0 < h; y0 += ROTATE_TILE) {
+		uint32_t th = (h - y0 < ROTATE_TILE) ? h - y0 : ROTATE_TILE;
+		for (uint32_t x0 = 0; x0 < w; x0 += ROTATE_TILE) {
+			uint32_t tw = (w - x0 < ROTATE_TILE) ? w - x0 : ROTATE_TILE;
+			if (angle == ROTATE_90_CW) {
+				rotate_tileCW(src, srcStride, dst, dstStride, h, x0, y0, tw, th);
+			} else {
+				rotate_tileCCW(src, srcStride, dst, dstStride, w, x0, y0, tw, th);
+			}
+		}
+	}
+}
+
+void rotate_rgb565_reference(const uint16_t *src, uint32_t srcStride, uint16_t *dst, uint32_t dstStride,
+							 uint32_t w, uint32_t h, rotate_angle_t angle) {
+	for (uint32_t y = 0; y < h; y++) {
+		for (uint32_t x = 0; x < w; x++) {
+			uint16_t pixel = src[y * srcStride + x];
+			switch (angle) {
+				case ROTATE_90_CW:
+					dst[x * dstStride + (h - 1 - y)] = pixel;
+					break;
+				case ROTATE_180:
+					dst[(h - 1 - y) * dstStride + (w - 1 - x)] = pixel;
+					break;
+				case ROTATE_90_CCW:
+					dst[(w - 1 - x) * dstStride + y] = pixel;
+					break;
+			}
+		}
+	}
+}
+
+/**** END OF FILE ****/
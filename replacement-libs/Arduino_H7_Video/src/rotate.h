@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * @file    rotate.h
+  * @author
+  * @version
+  * @date
+  * @brief   RGB565 rotation kernels for flushing LVGL strips onto a panel
+  *          mounted the other way round. No HAL in here, the host benchmark
+  *          in Host-Simulation builds the same file.
+  ******************************************************************************
+  */
+
+#ifndef _ROTATE_H
+#define _ROTATE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported defines ----------------------------------------------------------*/
+/* Square tiles of this many pixels. 16 RGB565 pixels are half a cache line pair on the M7 (32 byte lines), and
+   16 source plus 16 destination rows stay well inside its 16 KB D-cache. */
+#define ROTATE_TILE		16
+
+/* Exported enumeration ------------------------------------------------------*/
+typedef enum {
+	ROTATE_90_CW,		/* dst is h wide and w tall, dst[x][h - 1 - y] = src[y][x] */
+	ROTATE_180,			/* dst is w wide and h tall, dst[h - 1 - y][w - 1 - x] = src[y][x] */
+	ROTATE_90_CCW		/* dst is h wide and w tall, dst[w - 1 - x][y] = src[y][x] */
+} rotate_angle_t;
+
+/* Exported functions --------------------------------------------------------*/
+/* Strides are in pixels. Source and destination must not overlap. */
+void		rotate_rgb565(const uint16_t *src, uint32_t srcStride, uint16_t *dst, uint32_t dstStride,
+					  uint32_t w, uint32_t h, rotate_angle_t angle);
+/* One pixel at a time in source order, what the tiled kernels are checked and measured against */
+void		rotate_rgb565_reference(const uint16_t *src, uint32_t srcStride, uint16_t *dst, uint32_t dstStride,
+								uint32_t w, uint32_t h, rotate_angle_t angle);
+
+#endif /* _ROTATE_H */
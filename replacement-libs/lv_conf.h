@@ -46,17 +46,18 @@
  *=========================*/
 
 /*1: use custom malloc/free, 0: use the built-in `lv_mem_alloc()` and `lv_mem_free()`*/
-#define LV_MEM_CUSTOM 1
+#define LV_MEM_CUSTOM 0
 #if LV_MEM_CUSTOM == 0
     /*Size of the memory available for `lv_mem_alloc()` in bytes (>= 2kB)*/
-    #define LV_MEM_SIZE (256U * 1024U) //#define LV_MEM_SIZE (48U * 1024U)          /*[bytes]*/
+    #define LV_MEM_SIZE (1024U * 1024U) //#define LV_MEM_SIZE (48U * 1024U)          /*[bytes]*/
 
     /*Set an address for the memory pool instead of allocating it as a normal array. Can be in external SRAM too.*/
     #define LV_MEM_ADR 0     /*0: unused*/
     /*Instead of an address give a memory allocator that will be called to get a memory pool for LVGL. E.g. my_malloc*/
     #if LV_MEM_ADR == 0
         #undef LV_MEM_POOL_INCLUDE
-        #undef LV_MEM_POOL_ALLOC
+        /*Arduino_H7_Video, the SDRAM right after the framebuffers, kept out of the mbed heap*/
+        #define LV_MEM_POOL_ALLOC lvgl_sdramPool
     #endif
 
 #else       /*LV_MEM_CUSTOM*/
@@ -114,7 +115,8 @@
     /*Allow buffering some shadow calculation.
     *LV_SHADOW_CACHE_SIZE is the max. shadow size to buffer, where shadow size is `shadow_width + radius`
     *Caching has LV_SHADOW_CACHE_SIZE^2 RAM cost*/
-    #define LV_SHADOW_CACHE_SIZE 0
+    /*The theme's buttons are about a 10 px radius plus a 2 px shadow, one corner is cached*/
+    #define LV_SHADOW_CACHE_SIZE 32
 
     /* Set number of maximally cached circle data.
     * The circumference of 1/4 circle are saved for anti-aliasing
@@ -144,7 +146,8 @@
  *With complex image decoders (e.g. PNG or JPG) caching can save the continuous open/decode of images.
  *However the opened images might consume additional RAM.
  *0: to disable caching*/
-#define LV_IMG_CACHE_DEF_SIZE 0
+/*The logo and the image buttons' states, C arrays so this saves the decoder opens rather than decoded copies*/
+#define LV_IMG_CACHE_DEF_SIZE 4
 
 /*Number of stops allowed per gradient. Increase this to allow more stops.
  *This adds (sizeof(lv_color_t) + 1) bytes per additional stop*/
@@ -155,7 +158,8 @@
  *LV_GRAD_CACHE_DEF_SIZE sets the size of this cache in bytes.
  *If the cache is too small the map will be allocated only while it's required for the drawing.
  *0 mean no caching.*/
-#define LV_GRAD_CACHE_DEF_SIZE 0
+/*A map is about 2 bytes per pixel of the gradient's longer side, room for the settings screen's two and a few more*/
+#define LV_GRAD_CACHE_DEF_SIZE (16 * 1024)
 
 /*Allow dithering the gradients (to achieve visual smooth color gradients on limited color depth display)
  *LV_DITHER_GRADIENT implies allocating one or two more lines of the object's rendering surface
@@ -172,6 +176,18 @@
  *Only used if software rotation is enabled in the display driver.*/
 #define LV_DISP_ROT_MAX_BUF (10*1024)
 
+/*Count hits, misses and evictions of the image, gradient and shadow caches.
+ *Read them with `lv_draw_cache_stats_get()` to size the caches above*/
+#define LV_USE_DRAW_CACHE_STATS 1
+
+/*Memory of the image, gradient and shadow caches. 0: lv_mem_alloc/lv_mem_free*/
+#define LV_DRAW_CACHE_CUSTOM 1
+#if LV_DRAW_CACHE_CUSTOM
+    /*Arduino_H7_Video, the SDRAM after the framebuffers*/
+    #define LV_DRAW_CACHE_CUSTOM_ALLOC  lvgl_sdramAlloc
+    #define LV_DRAW_CACHE_CUSTOM_FREE   lvgl_sdramFree
+#endif
+
 /*-------------
  * GPU
  *-----------*/
@@ -0,0 +1,84 @@
+/**
+ * @file lv_draw_cache.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lv_draw_cache.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+#if LV_DRAW_CACHE_CUSTOM
+void * LV_DRAW_CACHE_CUSTOM_ALLOC(size_t size);
+void LV_DRAW_CACHE_CUSTOM_FREE(void * p);
+#endif
+
+/**********************
+ *  GLOBAL VARIABLES
+ **********************/
+#if LV_USE_DRAW_CACHE_STATS
+lv_draw_cache_stats_t _lv_draw_cache_stats;
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void lv_draw_cache_stats_get(lv_draw_cache_stats_t * stats)
+{
+#if LV_USE_DRAW_CACHE_STATS
+    lv_memcpy(stats, &_lv_draw_cache_stats, sizeof(lv_draw_cache_stats_t));
+#else
+    lv_memset_00(stats, sizeof(lv_draw_cache_stats_t));
+#endif
+}
+
+void lv_draw_cache_stats_reset(void)
+{
+#if LV_USE_DRAW_CACHE_STATS
+    lv_memset_00(&_lv_draw_cache_stats, sizeof(lv_draw_cache_stats_t));
+#endif
+}
+
+void * _lv_draw_cache_alloc(size_t size)
+{
+#if LV_DRAW_CACHE_CUSTOM
+    if(size == 0) return NULL;
+    return LV_DRAW_CACHE_CUSTOM_ALLOC(size);
+#else
+    return lv_mem_alloc(size);
+#endif
+}
+
+void _lv_draw_cache_free(void * p)
+{
+    if(p == NULL) return;
+#if LV_DRAW_CACHE_CUSTOM
+    LV_DRAW_CACHE_CUSTOM_FREE(p);
+#else
+    lv_mem_free(p);
+#endif
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
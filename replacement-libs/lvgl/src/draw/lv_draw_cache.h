@@ -0,0 +1,107 @@
+/**
+ * @file lv_draw_cache.h
+ * Memory and statistics shared by the image, gradient and shadow caches.
+ */
+
+#ifndef LV_DRAW_CACHE_H
+#define LV_DRAW_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../lv_conf_internal.h"
+#include "../misc/lv_mem.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#ifndef LV_USE_DRAW_CACHE_STATS
+    #define LV_USE_DRAW_CACHE_STATS 0
+#endif
+
+#ifndef LV_DRAW_CACHE_CUSTOM
+    #define LV_DRAW_CACHE_CUSTOM 0
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint32_t hits;      /**< Found in the cache*/
+    uint32_t misses;    /**< Had to be opened or computed*/
+    uint32_t evictions; /**< A cached entry was dropped to make room*/
+} lv_draw_cache_counters_t;
+
+typedef struct {
+    lv_draw_cache_counters_t img;
+    lv_draw_cache_counters_t grad;
+    lv_draw_cache_counters_t shadow;
+    uint32_t grad_uncached;     /**< Misses bigger than the whole gradient cache, allocated only for the draw*/
+    uint32_t grad_used_max;     /**< Most bytes of the gradient cache in use at once*/
+    uint32_t shadow_uncached;   /**< Misses with a corner bigger than `LV_SHADOW_CACHE_SIZE`*/
+    uint32_t shadow_size_max;   /**< Largest shadow corner (`shadow_width + radius`) drawn*/
+} lv_draw_cache_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Get the hit, miss and eviction counts of the draw caches since start up or the last reset.
+ * All zero unless `LV_USE_DRAW_CACHE_STATS` is enabled.
+ * @param stats store the counters here
+ */
+void lv_draw_cache_stats_get(lv_draw_cache_stats_t * stats);
+
+/**
+ * Zero the draw cache counters, e.g. before measuring a given screen.
+ */
+void lv_draw_cache_stats_reset(void);
+
+/**
+ * Allocate memory for a draw cache. `LV_DRAW_CACHE_CUSTOM_ALLOC` if `LV_DRAW_CACHE_CUSTOM` is enabled,
+ * so the caches can be placed in other memory than the rest of LVGL, else `lv_mem_alloc`.
+ * @param size size of the memory to allocate in bytes
+ * @return pointer to the allocated memory or NULL
+ */
+void * _lv_draw_cache_alloc(size_t size);
+
+/**
+ * Free memory allocated with `_lv_draw_cache_alloc`.
+ * @param p pointer to the memory, can be NULL
+ */
+void _lv_draw_cache_free(void * p);
+
+#if LV_USE_DRAW_CACHE_STATS
+extern lv_draw_cache_stats_t _lv_draw_cache_stats;
+#endif
+
+/**********************
+ *      MACROS
+ **********************/
+
+#if LV_USE_DRAW_CACHE_STATS
+    #define _LV_DRAW_CACHE_STAT_INC(cache, counter) (_lv_draw_cache_stats.cache.counter++)
+    #define _LV_DRAW_CACHE_STAT_ADD(counter) (_lv_draw_cache_stats.counter++)
+    #define _LV_DRAW_CACHE_STAT_MAX(counter, value) \
+        do { \
+            if((uint32_t)(value) > _lv_draw_cache_stats.counter) _lv_draw_cache_stats.counter = (uint32_t)(value); \
+        } while(0)
+#else
+    #define _LV_DRAW_CACHE_STAT_INC(cache, counter) do {} while(0)
+    #define _LV_DRAW_CACHE_STAT_ADD(counter) do {} while(0)
+    #define _LV_DRAW_CACHE_STAT_MAX(counter, value) do {} while(0)
+#endif
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*LV_DRAW_CACHE_H*/
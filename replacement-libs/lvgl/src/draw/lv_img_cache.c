@@ -8,6 +8,7 @@
  *********************/
 #include "../misc/lv_assert.h"
 #include "lv_img_cache.h"
+#include "lv_draw_cache.h"
 #include "lv_img_decoder.h"
 #include "lv_draw_img.h"
 #include "../hal/lv_hal_tick.h"
@@ -92,12 +93,14 @@ _lv_img_cache_entry_t * _lv_img_cache_open(const void * src, lv_color_t color, i
             cached_src->life += cached_src->dec_dsc.time_to_open * LV_IMG_CACHE_LIFE_GAIN;
             if(cached_src->life > LV_IMG_CACHE_LIFE_LIMIT) cached_src->life = LV_IMG_CACHE_LIFE_LIMIT;
             LV_LOG_TRACE("image source found in the cache");
+            _LV_DRAW_CACHE_STAT_INC(img, hits);
             break;
         }
     }
 
     /*The image is not cached then cache it now*/
     if(cached_src) return cached_src;
+    _LV_DRAW_CACHE_STAT_INC(img, misses);
 
     /*Find an entry to reuse. Select the entry with the least life*/
     cached_src = &cache[0];
@@ -111,12 +114,14 @@ _lv_img_cache_entry_t * _lv_img_cache_open(const void * src, lv_color_t color, i
     if(cached_src->dec_dsc.src) {
         lv_img_decoder_close(&cached_src->dec_dsc);
         LV_LOG_INFO("image draw: cache miss, close and reuse an entry");
+        _LV_DRAW_CACHE_STAT_INC(img, evictions);
     }
     else {
         LV_LOG_INFO("image draw: cache miss, cached to an empty entry");
     }
 #else
     cached_src = &LV_GC_ROOT(_lv_img_cache_single);
+    _LV_DRAW_CACHE_STAT_INC(img, misses);
 #endif
     /*Open the image and measure the time to open*/
     uint32_t t_start  = lv_tick_get();
@@ -155,11 +160,11 @@ void lv_img_cache_set_size(uint16_t new_entry_cnt)
     if(LV_GC_ROOT(_lv_img_cache_array) != NULL) {
         /*Clean the cache before free it*/
         lv_img_cache_invalidate_src(NULL);
-        lv_mem_free(LV_GC_ROOT(_lv_img_cache_array));
+        _lv_draw_cache_free(LV_GC_ROOT(_lv_img_cache_array));
     }
 
     /*Reallocate the cache*/
-    LV_GC_ROOT(_lv_img_cache_array) = lv_mem_alloc(sizeof(_lv_img_cache_entry_t) * new_entry_cnt);
+    LV_GC_ROOT(_lv_img_cache_array) = _lv_draw_cache_alloc(sizeof(_lv_img_cache_entry_t) * new_entry_cnt);
     LV_ASSERT_MALLOC(LV_GC_ROOT(_lv_img_cache_array));
     if(LV_GC_ROOT(_lv_img_cache_array) == NULL) {
         entry_cnt = 0;
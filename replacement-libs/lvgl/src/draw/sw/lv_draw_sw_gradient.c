@@ -9,6 +9,7 @@
 #include "lv_draw_sw_gradient.h"
 #include "../../misc/lv_gc.h"
 #include "../../misc/lv_types.h"
+#include "../lv_draw_cache.h"
 
 /*********************
  *      DEFINES
@@ -143,6 +144,7 @@ static lv_res_t kill_oldest_item(lv_grad_t * c, void * ctx)
     if(c->life == *min_life) {
         /*Found, let's kill it*/
         free_item(c);
+        _LV_DRAW_CACHE_STAT_INC(grad, evictions);
         return LV_RES_OK;
     }
     return LV_RES_INV;
@@ -193,6 +195,7 @@ static lv_grad_t * allocate_item(const lv_grad_dsc_t * g, lv_coord_t w, lv_coord
             LV_ASSERT_MALLOC(item);
             if(item == NULL) return NULL;
             item->not_cached = 1;
+            _LV_DRAW_CACHE_STAT_ADD(grad_uncached);
         }
     }
 
@@ -224,6 +227,7 @@ static lv_grad_t * allocate_item(const lv_grad_dsc_t * g, lv_coord_t w, lv_coord
 #endif
 #endif
         grad_cache_end += req_size;
+        _LV_DRAW_CACHE_STAT_MAX(grad_used_max, grad_cache_end - LV_GC_ROOT(_lv_grad_cache_mem));
     }
     return item;
 }
@@ -234,16 +238,21 @@ static lv_grad_t * allocate_item(const lv_grad_dsc_t * g, lv_coord_t w, lv_coord
  **********************/
 void lv_gradient_free_cache(void)
 {
-    lv_mem_free(LV_GC_ROOT(_lv_grad_cache_mem));
+    _lv_draw_cache_free(LV_GC_ROOT(_lv_grad_cache_mem));
     LV_GC_ROOT(_lv_grad_cache_mem) = grad_cache_end = NULL;
     grad_cache_size = 0;
 }
 
 void lv_gradient_set_cache_size(size_t max_bytes)
 {
-    lv_mem_free(LV_GC_ROOT(_lv_grad_cache_mem));
-    grad_cache_end = LV_GC_ROOT(_lv_grad_cache_mem) = lv_mem_alloc(max_bytes);
-    LV_ASSERT_MALLOC(LV_GC_ROOT(_lv_grad_cache_mem));
+    _lv_draw_cache_free(LV_GC_ROOT(_lv_grad_cache_mem));
+    grad_cache_end = LV_GC_ROOT(_lv_grad_cache_mem) = _lv_draw_cache_alloc(max_bytes);
+    if(max_bytes) LV_ASSERT_MALLOC(LV_GC_ROOT(_lv_grad_cache_mem));
+    if(LV_GC_ROOT(_lv_grad_cache_mem) == NULL) {
+        /*Nothing will be cached, every map is allocated only for its draw*/
+        grad_cache_size = 0;
+        return;
+    }
     lv_memset_00(LV_GC_ROOT(_lv_grad_cache_mem), max_bytes);
     grad_cache_size = max_bytes;
 }
@@ -266,10 +275,12 @@ lv_grad_t * lv_gradient_get(const lv_grad_dsc_t * g, lv_coord_t w, lv_coord_t h)
     lv_grad_t * item = NULL;
     if(iterate_cache(&find_item, &key, &item) == LV_RES_OK) {
         item->life++; /* Don't forget to bump the counter */
+        _LV_DRAW_CACHE_STAT_INC(grad, hits);
         return item;
     }
 
     /* Step 2: Need to allocate an item for it */
+    _LV_DRAW_CACHE_STAT_INC(grad, misses);
     item = allocate_item(g, w, h);
     if(item == NULL) {
         LV_LOG_WARN("Faild to allcoate item for teh gradient");
@@ -12,6 +12,7 @@
 #include "../../core/lv_refr.h"
 #include "../../misc/lv_assert.h"
 #include "lv_draw_sw_dither.h"
+#include "../lv_draw_cache.h"
 
 /*********************
  *      DEFINES
@@ -53,7 +54,7 @@ static void draw_border_simple(lv_draw_ctx_t * draw_ctx, const lv_area_t * outer
  *  STATIC VARIABLES
  **********************/
 #if defined(LV_SHADOW_CACHE_SIZE) && LV_SHADOW_CACHE_SIZE > 0
-    static uint8_t sh_cache[LV_SHADOW_CACHE_SIZE * LV_SHADOW_CACHE_SIZE];
+    static uint8_t * sh_cache = NULL;   /*LV_SHADOW_CACHE_SIZE^2 bytes from the draw cache memory on the first shadow*/
     static int32_t sh_cache_size = -1;
     static int32_t sh_cache_r = -1;
 #endif
@@ -484,24 +485,36 @@ static void LV_ATTRIBUTE_FAST_MEM draw_shadow(lv_draw_ctx_t * draw_ctx, const lv
     int32_t corner_size = dsc->shadow_width  + r_sh;
 
     lv_opa_t * sh_buf;
+    _LV_DRAW_CACHE_STAT_MAX(shadow_size_max, corner_size);
 
 #if LV_SHADOW_CACHE_SIZE
+    if(sh_cache == NULL) {
+        sh_cache = _lv_draw_cache_alloc(LV_SHADOW_CACHE_SIZE * LV_SHADOW_CACHE_SIZE);
+        LV_ASSERT_MALLOC(sh_cache);
+    }
+
     if(sh_cache_size == corner_size && sh_cache_r == r_sh) {
         /*Use the cache if available*/
         sh_buf = lv_mem_buf_get(corner_size * corner_size);
         lv_memcpy(sh_buf, sh_cache, corner_size * corner_size);
+        _LV_DRAW_CACHE_STAT_INC(shadow, hits);
     }
     else {
         /*A larger buffer is required for calculation*/
         sh_buf = lv_mem_buf_get(corner_size * corner_size * sizeof(uint16_t));
         shadow_draw_corner_buf(&core_area, (uint16_t *)sh_buf, dsc->shadow_width, r_sh);
+        _LV_DRAW_CACHE_STAT_INC(shadow, misses);
 
         /*Cache the corner if it fits into the cache size*/
-        if((uint32_t)corner_size * corner_size < sizeof(sh_cache)) {
+        if(sh_cache && (uint32_t)corner_size * corner_size < LV_SHADOW_CACHE_SIZE * LV_SHADOW_CACHE_SIZE) {
+            if(sh_cache_size >= 0) _LV_DRAW_CACHE_STAT_INC(shadow, evictions);
             lv_memcpy(sh_cache, sh_buf, corner_size * corner_size);
             sh_cache_size = corner_size;
             sh_cache_r = r_sh;
         }
+        else {
+            _LV_DRAW_CACHE_STAT_ADD(shadow_uncached);
+        }
     }
 #else
     sh_buf = lv_mem_buf_get(corner_size * corner_size * sizeof(uint16_t));
@@ -19,6 +19,8 @@
 
 #ifdef LV_MEM_POOL_INCLUDE
     #include LV_MEM_POOL_INCLUDE
+#elif LV_MEM_CUSTOM == 0 && LV_MEM_ADR == 0 && defined(LV_MEM_POOL_ALLOC)
+    void * LV_MEM_POOL_ALLOC(size_t size);
 #endif
 
 /*********************